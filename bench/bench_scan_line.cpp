@@ -0,0 +1,165 @@
+// Scanner throughput: bench_scan_line [file] [passes] [max_threads]
+// Without a file (or with "-"), scans a synthetic C++ corpus of ~8 MB. Also
+// times the background pass that confirms every line's state on 1, 2, 4 ...
+// up to max_threads (default: hardware concurrency) threads.
+
+#include <sprawn/document.h>
+#include <sprawn/middleware/controller.h>
+#include <sprawn/middleware/syntax_highlighter.h>
+#include <sprawn/worker_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace sprawn;
+
+namespace {
+
+std::vector<std::string> synthetic_corpus() {
+    static const char* const kBlock[] = {
+        "#include <unordered_map>",
+        "",
+        "/* Block comment that spans",
+        "   a couple of lines. */",
+        "namespace demo {",
+        "",
+        "// Returns the sum of the values whose keys start with prefix.",
+        "static inline uint64_t sum_matching(const std::unordered_map<std::string, int64_t>& values,",
+        "                                    std::string_view prefix) noexcept {",
+        "    uint64_t total = 0;",
+        "    for (const auto& [key, value] : values) {",
+        "        if (key.size() >= prefix.size() && key.compare(0, prefix.size(), prefix) == 0)",
+        "            total += static_cast<uint64_t>(value) * 0x9E3779B1u + 3.25e-2f;",
+        "    }",
+        "    const char* msg = \"escaped \\\"quote\\\" and tab\\t\"; char c = '\\n';",
+        "    return total; /* trailing */ // done",
+        "}",
+        "",
+        "template <typename T> class RingBuffer final : public BufferBase<T> {",
+        "public:",
+        "    explicit RingBuffer(size_t capacity) : data_(capacity), head_(0), tail_(0) {}",
+        "    bool push(const T& item) { if (full()) return false; data_[tail_++ % data_.size()] = item; return true; }",
+        "private:",
+        "    std::vector<T> data_;",
+        "    size_t head_, tail_;",
+        "};",
+        "",
+        "} // namespace demo",
+    };
+    std::vector<std::string> lines;
+    size_t bytes = 0;
+    while (bytes < (8u << 20)) {
+        for (const char* l : kBlock) {
+            lines.emplace_back(l);
+            bytes += lines.back().size() + 1;
+        }
+    }
+    return lines;
+}
+
+std::vector<std::string> read_lines(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::fprintf(stderr, "cannot open %s\n", path);
+        std::exit(1);
+    }
+    std::vector<std::string> lines;
+    std::string l;
+    while (std::getline(in, l)) lines.push_back(std::move(l));
+    return lines;
+}
+
+template <typename Fn>
+void run(const char* label, const std::vector<std::string>& lines, int passes, Fn&& scan) {
+    size_t bytes = 0;
+    for (const auto& l : lines) bytes += l.size() + 1;
+
+    size_t tokens = 0;
+    double best = 1e30;
+    for (int p = 0; p < passes; ++p) {
+        auto t0 = std::chrono::steady_clock::now();
+        LineState state = LineState::Normal;
+        tokens = 0;
+        for (const auto& l : lines) tokens += scan(l, state);
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    std::printf("%-28s %8.1f MB/s  %6.2f Mlines/s  (%zu tokens)\n", label,
+                static_cast<double>(bytes) / best / 1e6,
+                static_cast<double>(lines.size()) / best / 1e6, tokens);
+}
+
+void run_confirm(const std::filesystem::path& path, size_t bytes, int passes, size_t max_threads) {
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(path);
+
+    for (size_t threads = 1; threads <= max_threads;
+         threads = threads < max_threads ? std::min(threads * 2, max_threads) : max_threads + 1)
+    {
+        WorkerPool pool(threads);
+        double best = 1e30;
+        for (int p = 0; p < passes; ++p) {
+            SyntaxHighlighter hl(ctrl);
+            hl.set_language(LanguageDef::cpp());
+            hl.set_worker_pool(&pool);
+            auto t0 = std::chrono::steady_clock::now();
+            while (hl.on_idle(std::chrono::steady_clock::time_point::max())) {}
+            auto t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+        }
+        char label[64];
+        std::snprintf(label, sizeof(label), "confirm (%zu thread%s)", threads, threads > 1 ? "s" : "");
+        std::printf("%-28s %8.1f MB/s\n", label, static_cast<double>(bytes) / best / 1e6);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool synthetic = argc <= 1 || std::string_view(argv[1]) == "-";
+    std::vector<std::string> lines = synthetic ? synthetic_corpus() : read_lines(argv[1]);
+    int passes = argc > 2 ? std::atoi(argv[2]) : 10;
+    size_t max_threads = argc > 3 ? static_cast<size_t>(std::atoi(argv[3]))
+                                  : std::max(1u, std::thread::hardware_concurrency());
+
+    Document doc;
+    Controller ctrl(doc);
+    SyntaxHighlighter hl(ctrl);
+    hl.set_language(LanguageDef::cpp());
+
+    run("scan_line (ScanResult)", lines, passes, [&](const std::string& l, LineState& s) {
+        ScanResult r = hl.scan_line(l, s);
+        s = r.exit_state;
+        return r.tokens.size();
+    });
+
+    std::vector<Token> tokens;
+    run("scan_line (reused tokens)", lines, passes, [&](const std::string& l, LineState& s) {
+        s = hl.scan_line(l, s, tokens);
+        return tokens.size();
+    });
+
+    size_t bytes = 0;
+    for (const auto& l : lines) bytes += l.size() + 1;
+    std::filesystem::path path;
+    if (!synthetic) {
+        path = argv[1];
+    } else {
+        path = std::filesystem::temp_directory_path() / "sprawn_bench_corpus.cpp";
+        std::ofstream out(path, std::ios::binary);
+        for (const auto& l : lines) out << l << '\n';
+    }
+    run_confirm(path, bytes, std::max(1, passes / 3), std::max<size_t>(1, max_threads));
+    if (synthetic) std::filesystem::remove(path);
+    return 0;
+}
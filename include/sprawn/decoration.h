@@ -2,6 +2,9 @@
 
 #include <sprawn/color.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <span>
 #include <vector>
 
 namespace sprawn {
@@ -26,4 +29,61 @@ struct LineDecoration {
     std::vector<StyledSpan> spans;
 };
 
+// Decorations for a range of lines, kept in one caller-owned allocation
+// that is reused across frames: reset() keeps the capacity. Lines are filled
+// in order, so the spans of each line are contiguous.
+class DecorationBuffer {
+public:
+    // Starts a fill for lines [first, last).
+    void reset(size_t first, size_t last) {
+        first_ = first;
+        last_  = std::max(first, last);
+        spans_.clear();
+        ends_.clear();
+    }
+
+    size_t first_line() const { return first_; }
+    size_t last_line() const { return last_; }
+    // Lines closed with end_line() so far.
+    size_t filled_lines() const { return ends_.size(); }
+
+    // Appends to the first line not yet closed.
+    void push(const StyledSpan& span) { spans_.push_back(span); }
+    void end_line() { ends_.push_back(spans_.size()); }
+
+    // Spans of a filled line in [first_line(), last_line()).
+    std::span<const StyledSpan> line(size_t line_number) const {
+        size_t i     = line_number - first_;
+        size_t begin = i == 0 ? 0 : ends_[i - 1];
+        return {spans_.data() + begin, ends_[i] - begin};
+    }
+
+    size_t memory_usage() const {
+        return spans_.capacity() * sizeof(StyledSpan) + ends_.capacity() * sizeof(size_t);
+    }
+
+private:
+    size_t                  first_{0};
+    size_t                  last_{0};
+    std::vector<StyledSpan> spans_;
+    std::vector<size_t>     ends_;  // end of each line's spans in spans_
+};
+
+// Half-open range of lines [first, last) whose decorations changed.
+struct LineRange {
+    size_t first{0};
+    size_t last{0};
+
+    bool empty() const { return first >= last; }
+    bool contains(size_t line) const { return line >= first && line < last; }
+
+    // Smallest range covering both.
+    void merge(LineRange other) {
+        if (other.empty()) return;
+        if (empty()) { *this = other; return; }
+        first = std::min(first, other.first);
+        last  = std::max(last, other.last);
+    }
+};
+
 } // namespace sprawn
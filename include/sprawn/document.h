@@ -1,11 +1,14 @@
 #pragma once
 
 #include <sprawn/encoding.h>
+#include <sprawn/memory_report.h>
 
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <string>
+#include <utility>
 
 namespace sprawn {
 
@@ -23,16 +26,32 @@ public:
     void open_file(const std::filesystem::path& path);
 
     std::string line(size_t line_number) const;
+    /// Copy a line into `out`, reusing its capacity.
+    void line(size_t line_number, std::string& out) const;
     size_t line_count() const;
 
+    /// Absolute byte offset of byte `col` of line `line`.
+    size_t offset_of(size_t line, size_t col) const;
+    /// Line and byte column of absolute byte `offset`.
+    std::pair<size_t, size_t> position_of(size_t offset) const;
+    /// `count` bytes starting at absolute byte `offset`.
+    std::string text(size_t offset, size_t count) const;
+
     /// Insert text at the given line and byte offset within that line.
     void insert(size_t line, size_t col, std::string_view text);
     /// Erase `count` bytes starting at the given line and byte offset.
     void erase(size_t line, size_t col, size_t count);
 
+    /// Incremented by every open_file(), insert() and erase(): results
+    /// computed from an older version may refer to text that has moved.
+    uint64_t version() const;
+
     /// Returns the detected encoding of the currently open file.
     Encoding encoding() const;
 
+    /// Append this document's heap and mapped-file usage to `report`.
+    void memory_report(MemoryReport& report) const;
+
 private:
     struct Impl;
     std::unique_ptr<Impl> impl_;
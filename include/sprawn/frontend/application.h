@@ -10,4 +10,8 @@ namespace sprawn {
 // Returns false if initialisation fails.
 bool run_application(std::string_view filepath);
 
+// Headless: open the file, highlight it to the end, and print the
+// middleware/backend memory report as JSON to stdout. No window is created.
+bool print_memory_report(std::string_view filepath);
+
 } // namespace sprawn
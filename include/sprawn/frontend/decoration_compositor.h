@@ -2,6 +2,7 @@
 
 #include <sprawn/decoration.h>
 
+#include <span>
 #include <vector>
 
 namespace sprawn {
@@ -11,6 +12,11 @@ public:
     static std::vector<StyledSpan> flatten(
         const LineDecoration& deco, int line_byte_len,
         const TextStyle& default_style = TextStyle{});
+
+    // Same, into `out` (cleared first) so its capacity is reused.
+    static void flatten(std::span<const StyledSpan> spans, int line_byte_len,
+                        std::vector<StyledSpan>& out,
+                        const TextStyle& default_style = TextStyle{});
 };
 
 } // namespace sprawn
@@ -3,18 +3,28 @@
 #include "events.h"
 #include "input_handler.h"
 #include "line_cache.h"
+#include "line_tile_cache.h"
 #include "renderer.h"
 #include "text_layout.h"
 #include "viewport.h"
 #include <sprawn/middleware/controller.h>
+#include <sprawn/middleware/line_filter.h>
 
 #include <SDL2/SDL.h>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace sprawn {
 
 class GlyphAtlas;
 class FontChain;
+class ShapingPool;
+class WorkerPool;
 
 struct CursorPos {
     size_t line{0};
@@ -32,21 +42,64 @@ public:
     Editor(Controller& ctrl, Renderer& renderer,
            FontChain& fonts, GlyphAtlas& atlas,
            int width_px, int height_px, float dpi_scale = 1.0f);
+    ~Editor();
 
     void handle_event(const SDL_Event& ev);
+    // True if the next frame would differ from the last one drawn: input
+    // was handled, the document changed, or decorations of a visible line
+    // did. Drains the controller's decoration changes, so call it once per
+    // event-loop iteration; render() relies on it having been called.
+    bool needs_redraw();
+    // Redraws only the rows that changed when the renderer kept the last
+    // frame, everything otherwise.
     void render();
+    // True while the editor waits on background work of its own (glyphs
+    // being rasterized, lines being shaped ahead of the viewport) that
+    // will need a redraw or a cache update when it finishes.
+    bool busy() const;
     void on_resize(int w, int h);
     void on_dpi_change(float new_scale);
 
+    // Controller report plus the frontend's own caches.
+    MemoryReport memory_report() const;
+
+    // Pool for the filtered view's full scans, glyph rasterization and
+    // line shaping; nullptr works inline.
+    void set_worker_pool(WorkerPool* pool);
+
 private:
     void apply_command(const EditorCommand& cmd);
     void render_cursor(int y, const GlyphRun& run, std::string_view utf8);
+    void render_stats_overlay();
     void rebuild_fonts(int logical_size, float scale);
     void recompute_gutter();
+    // Logical width lines are shaped to (lazy shaping); 0 for the
+    // cursor's line, which is always shaped whole.
+    int  shape_limit(size_t doc_line) const;
+    // The cached run of `doc_line` with `version`, unless it was cut
+    // shorter than shape_limit() now asks for (cursor moved onto the line,
+    // horizontal scroll); nullptr then, or if none is cached.
+    const GlyphRun* cached_run(size_t doc_line, uint64_t version);
+    // Queues the page of lines past the viewport, in the direction it
+    // last moved, for shaping in the background.
+    void prefetch_lines(size_t first, size_t rows);
+
+    // Lines as the viewport sees them: every document line, or only the
+    // filter's matches. Cursor and selection stay in document lines.
+    size_t view_line_count() const;
+    size_t to_doc_line(size_t view_line) const;
+    size_t to_view_line(size_t doc_line) const;
+    void   scroll_to_cursor();
 
     // Selection helpers
     bool has_selection() const;
     std::pair<CursorPos, CursorPos> selection_range() const;
+    // Selected bytes [first, second) of line `L` with text `utf8`, or
+    // {-1, -1} if none of it is selected.
+    std::pair<int, int> selection_bytes(size_t L, std::string_view utf8) const;
+    // True if line `L` is within the selection (its text is then needed
+    // for selection_bytes()).
+    bool selects_line(size_t L) const;
     std::string selected_text() const;
     void delete_selection();
 
@@ -57,12 +110,72 @@ private:
     TextLayout    layout_;
     Viewport      viewport_;
     LineCache     line_cache_;
+    LineTileCache tiles_;
+    uint64_t      layout_epoch_{0};
     InputHandler  input_;
     CursorPos     cursor_;
     SelectAnchor  anchor_;
     int           gutter_width_{0};
     float         dpi_scale_{1.0f};
     int           font_size_logical_{16};
+    bool          show_stats_{false};
+    WorkerPool*   pool_{nullptr};
+    // Shaping threads; only with a pool that has workers.
+    std::unique_ptr<ShapingPool> shaping_;
+    size_t        prefetch_first_{SIZE_MAX};  // viewport of the last prefetch
+    // Set while only lines matching a pattern are shown (Ctrl+F, Esc).
+    std::unique_ptr<LineFilter> filter_;
+
+    // Per-frame decoration scratch, reused so rendering does not allocate.
+    DecorationBuffer         deco_buf_;
+    std::vector<StyledSpan>  line_spans_;
+    // Text of each visible row, read from the document only for rows
+    // being recomposited, drawn or shaped.
+    std::vector<std::string> frame_text_;
+    std::vector<uint8_t>     frame_text_read_;
+    std::vector<size_t>      frame_lines_;  // document line of each visible row
+
+    // Flattened spans of a visible line, reused while its text, selected
+    // bytes and decoration generation are unchanged.
+    struct ComposedLine {
+        bool                    valid{false};
+        uint64_t                version{0};  // Controller::line_version()
+        uint64_t                generation{0};
+        std::pair<int, int>     selection{-1, -1};
+        std::vector<StyledSpan> flat;
+    };
+    std::unordered_map<size_t, ComposedLine> composed_;
+
+    // What was last drawn, for damage tracking.
+    struct RowKey {
+        size_t              line;
+        uint64_t            version;
+        uint64_t            generation;
+        std::pair<int, int> selection;
+        size_t              cursor_col;  // SIZE_MAX: not the cursor's line
+        bool operator==(const RowKey&) const = default;
+    };
+    struct FrameKey {
+        size_t first_line{SIZE_MAX};
+        size_t rows{0};
+        int    scroll_x{0};
+        int    gutter_width{0};
+        int    width{0};
+        int    line_height{0};
+        int    digits{0};
+        bool operator==(const FrameKey&) const = default;
+    };
+    std::vector<RowKey> drawn_rows_;
+    std::vector<char>   redraw_rows_;  // this frame's rows to draw
+    FrameKey            drawn_frame_;
+    uint64_t            drawn_version_{0};
+    bool                damaged_{true};
+    bool                full_redraw_{true};
+
+    // The overlay's report is refreshed at most once per second: mincore()
+    // over a multi-GB mapping is too slow to run every frame.
+    MemoryReport                          stats_report_;
+    std::chrono::steady_clock::time_point stats_refreshed_{};
 
     static constexpr int kGutterPad  = 8;
 };
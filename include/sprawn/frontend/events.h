@@ -24,12 +24,17 @@ struct Copy         {};
 struct Paste        {};
 struct Cut          {};
 struct SelectAll    {};
+struct FilterLines  {};                    // show only lines with the selection / word at cursor
+struct ClearFilter  {};
+struct ToggleStatsOverlay {};
+struct DumpMemoryReport   {};              // JSON to stdout
 struct Quit         {};
 
 using EditorCommand = std::variant<
     MoveCursor, MoveHome, MoveEnd, MovePgUp, MovePgDn,
     InsertText, DeleteBackward, DeleteForward, NewLine,
-    ScrollLines, ZoomFont, ClickPosition, Copy, Paste, Cut, SelectAll, Quit
+    ScrollLines, ZoomFont, ClickPosition, Copy, Paste, Cut, SelectAll,
+    FilterLines, ClearFilter, ToggleStatsOverlay, DumpMemoryReport, Quit
 >;
 
 } // namespace sprawn
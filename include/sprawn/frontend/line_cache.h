@@ -4,43 +4,59 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <list>
-#include <optional>
-#include <unordered_map>
+#include <vector>
 
 namespace sprawn {
 
-struct CacheEntry {
-    size_t   line;
-    uint64_t hash;
-    GlyphRun run;
-};
-
+// Shaped runs keyed by Controller::line_version(). A version names a
+// line's text wherever the line moves, so edits never renumber or
+// invalidate entries: runs of edited lines are no longer asked for and
+// age out. Open addressing with linear probing over a flat slot array
+// twice the capacity, and CLOCK eviction: a hit sets the slot's reference
+// bit, and the hand looking for a victim clears set bits and evicts the
+// first slot it finds clear.
 class LineCache {
 public:
     explicit LineCache(size_t capacity = 512);
 
-    // Returns a pointer to the cached GlyphRun if the line is present and
-    // the stored hash matches. Returns nullptr on miss or stale entry.
-    const GlyphRun* get(size_t line, uint64_t hash);
+    // The cached run of the line with this version, or nullptr. Valid
+    // until the next put() or clear().
+    const GlyphRun* get(uint64_t version);
 
-    void put(size_t line, uint64_t hash, GlyphRun run);
+    void put(uint64_t version, GlyphRun run);
 
-    void invalidate(size_t line);
+    void clear();
 
-    // After a multi-line insert/delete:
-    //   - evict entries in [first, first+removed_count)
-    //   - shift remaining entries with key >= first+removed_count by line_delta
-    void invalidate_range(size_t first, size_t removed_count, int line_delta);
+    size_t size()     const { return size_; }
+    size_t capacity() const { return capacity_; }
 
-    void clear();
+    // Approximate heap bytes: the slot array plus each run's glyph vector.
+    size_t memory_usage() const;
 
 private:
-    size_t capacity_;
-    std::list<CacheEntry>                                   lru_;
-    std::unordered_map<size_t, std::list<CacheEntry>::iterator> index_;
+    struct Slot {
+        uint64_t version{0};
+        GlyphRun run{};
+        bool     used{false};
+        bool     referenced{false};
+    };
+
+    size_t home(uint64_t version) const;
+    // Slot holding `version`, or npos.
+    size_t find(uint64_t version) const;
+    // Empties slot i, moving later entries of its probe chain back so
+    // lookups need no tombstones.
+    void   erase_slot(size_t i);
+    void   evict_one();
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
 
-    void evict_if_full();
+    size_t capacity_;
+    size_t size_{0};
+    size_t hand_{0};
+    size_t mask_;
+    int    shift_;
+    std::vector<Slot> slots_;
 };
 
 } // namespace sprawn
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "renderer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace sprawn {
+
+// Everything that goes into a tile's pixels.
+struct TileKey {
+    uint64_t            text_version{0};  // Controller::line_version()
+    uint64_t            generation{0};    // Controller::decoration_generation()
+    std::pair<int, int> selection{-1, -1};
+    int                 width{0};         // logical pixels
+    int                 height{0};
+    int                 scroll_x{0};
+    uint64_t            layout_epoch{0};  // bumped on font size / DPI change
+    bool operator==(const TileKey&) const = default;
+};
+
+// Fully composited text rows (decoration backgrounds, glyphs, underlines)
+// kept as render-target textures, one per document line, so a row that
+// has not changed since it was drawn is a single blit. Least recently used
+// tiles are dropped once their textures exceed the byte budget.
+class LineTileCache {
+public:
+    explicit LineTileCache(Renderer& renderer, size_t max_bytes = kDefaultMaxBytes);
+    ~LineTileCache();
+
+    LineTileCache(const LineTileCache&) = delete;
+    LineTileCache& operator=(const LineTileCache&) = delete;
+
+    // The tile drawn for `line` with `key`, or nullptr.
+    TextureHandle find(size_t line, const TileKey& key);
+
+    // A texture of `phys_w` x `phys_h` pixels to draw `line` with `key`
+    // into: the line's stale tile when the size matches, else a new one.
+    // nullptr if render targets are unavailable.
+    TextureHandle acquire(size_t line, const TileKey& key, int phys_w, int phys_h);
+
+    // Makes the next find() for `line` miss, keeping its texture for reuse.
+    void forget(size_t line);
+
+    // Drops every tile (fonts changed, render targets lost).
+    void clear();
+
+    size_t memory_usage() const { return bytes_; }
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+    static constexpr size_t kDefaultMaxBytes = size_t{64} << 20;
+
+private:
+    struct Tile {
+        size_t        line;
+        TileKey       key;
+        TextureHandle texture;
+        int           w, h;  // physical pixels
+    };
+
+    void release(const Tile& t);
+
+    Renderer& renderer_;
+    size_t    max_bytes_;
+    size_t    bytes_{0};
+    size_t    hits_{0}, misses_{0};
+    std::list<Tile>                                        lru_;
+    std::unordered_map<size_t, std::list<Tile>::iterator> index_;
+};
+
+} // namespace sprawn
@@ -3,22 +3,64 @@
 #include <sprawn/color.h>
 
 #include <SDL2/SDL.h>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <vector>
 
 namespace sprawn {
 
 using TextureHandle = SDL_Texture*;
 
+// Draws are queued as textured quads with per-vertex colours and
+// submitted in order with one SDL_RenderGeometry call per run of quads
+// sharing a texture. Anything that changes render state (clip, clear,
+// texture uploads, end of frame) flushes the queue first.
+//
+// Where render targets are supported, frames are drawn into a retained
+// canvas texture that end_frame() copies to the window, so a frame can
+// redraw only what changed on top of the previous one.
 class Renderer {
 public:
     explicit Renderer(SDL_Renderer* r);
+    ~Renderer();
 
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    // Clears to `bg` and starts a full frame.
     void begin_frame(Color bg);
+    // Starts a frame over the previous frame's pixels. Returns false, and
+    // starts nothing, if they are not available (first frame, resize, lost
+    // render targets, no target support): call begin_frame() instead.
+    bool begin_partial_frame();
+    // Forgets the retained pixels, e.g. on SDL_RENDER_TARGETS_RESET.
+    void invalidate() { canvas_valid_ = false; }
+
+    // Logical-to-physical scale, reapplied whenever the target changes.
+    void  set_scale(float scale);
+    float scale() const { return scale_; }
 
     void fill_rect(Rect rect, Color c);
 
+    // An opaque white texel of `tex` (pixel x, y): fills sample it so they
+    // batch together with glyphs from the same texture.
+    void set_solid_texel(TextureHandle tex, int x, int y);
+
     // Creates an RGBA streaming texture for the glyph atlas.
     TextureHandle create_texture(int w, int h);
 
+    // An opaque texture to draw into with begin_target(); nullptr where
+    // render targets are unsupported. Sizes are physical pixels.
+    TextureHandle create_target(int w, int h);
+    void          destroy_texture(TextureHandle tex);
+
+    // Redirects drawing into `target`, cleared to `bg`, until end_target();
+    // coordinates are logical and relative to the target's origin. The
+    // frame's clip rect is restored afterwards.
+    void begin_target(TextureHandle target, Color bg);
+    void end_target();
+
     // Upload pixel data (row-major RGBA bytes, pitch in bytes).
     void update_texture(TextureHandle tex, const void* pixels, int pitch);
 
@@ -28,12 +70,52 @@ public:
     void set_clip(SDL_Rect r);
     void clear_clip();
 
+    // Submits the queued quads.
+    void flush();
+    // Called before queued quads are submitted, to upload texture data
+    // they sample (the glyph atlas's pending glyphs).
+    void set_pre_flush(std::function<void()> fn) { pre_flush_ = std::move(fn); }
+
     void end_frame();
 
+    struct FrameStats {
+        int    draw_calls{0};  // SDL_RenderGeometry calls
+        int    quads{0};
+        double cpu_ms{0};      // begin_frame() to end_frame()
+    };
+    const FrameStats& last_frame_stats() const { return last_stats_; }
+
     SDL_Renderer* raw() const { return r_; }
 
 private:
+    void push_quad(TextureHandle tex, float x0, float y0, float x1, float y1,
+                   float u0, float v0, float u1, float v1, Color c);
+    void start_frame();
+
     SDL_Renderer* r_;
+    float         scale_{1.0f};
+    std::function<void()> pre_flush_;
+
+    TextureHandle canvas_{nullptr};
+    int           canvas_w_{0}, canvas_h_{0};
+    bool          canvas_valid_{false};  // holds the last finished frame
+    bool          canvas_bound_{false};  // this frame draws into it
+
+    SDL_Rect      clip_{};
+    bool          clipped_{false};
+
+    std::vector<SDL_Vertex> verts_;
+    std::vector<int>        indices_;
+    TextureHandle           batch_tex_{nullptr};
+    TextureHandle           size_tex_{nullptr};    // last texture blitted
+    float                   inv_w_{1}, inv_h_{1};  // of size_tex_
+
+    TextureHandle           solid_tex_{nullptr};
+    float                   solid_u_{0}, solid_v_{0};
+
+    FrameStats                            stats_;
+    FrameStats                            last_stats_;
+    std::chrono::steady_clock::time_point frame_start_{};
 };
 
 } // namespace sprawn
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace sprawn {
+
+// Bottom-left skyline packer: tracks the top edge of the packed area as a
+// list of horizontal segments and places each rectangle as low as it fits.
+// Wastes far less space than shelves when glyph heights vary (CJK next to
+// Latin next to emoji).
+class SkylinePacker {
+public:
+    SkylinePacker(int w, int h);
+
+    // Top-left corner for a w x h rectangle; false if it does not fit.
+    bool insert(int w, int h, int& out_x, int& out_y);
+    void reset();
+
+    // Fraction of the area covered by inserted rectangles.
+    double occupancy() const;
+    // Segments of the skyline; neighbours at the same height are merged.
+    size_t segments() const { return skyline_.size(); }
+
+private:
+    struct Segment { int x, y, w; };
+
+    // y at which a w x h rectangle would sit starting at segment i, or -1.
+    int fit(size_t i, int w, int h) const;
+
+    int width_, height_;
+    size_t used_area_{0};
+    std::vector<Segment> skyline_;
+};
+
+} // namespace sprawn
@@ -4,15 +4,19 @@
 
 #include <sprawn/decoration.h>
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string_view>
 #include <vector>
 
 namespace sprawn {
 
 class GlyphAtlas;
+struct AtlasGlyph;
 class FontChain;
+class Shaper;
 
 struct GlyphEntry {
     uint32_t glyph_id;
@@ -26,25 +30,44 @@ struct GlyphRun {
     std::vector<GlyphEntry> glyphs;
     int total_width;       // total advance width in pixels
     bool truncated{false}; // true if shaping stopped early (lazy shaping)
+    int  max_width_px{0};  // logical limit it was shaped with; 0: none
+    // Physical advance of every glyph when the run came from the fixed-
+    // advance ASCII path (glyph i is byte i at i * cell_width); 0 otherwise.
+    int  cell_width{0};
 };
 
 class TextLayout {
 public:
     TextLayout(GlyphAtlas& atlas, FontChain& fonts, float dpi_scale = 1.0f);
+    ~TextLayout();
 
-    // Shape a UTF-8 line using HarfBuzz + ICU BiDi.
+    // Shape a UTF-8 line using HarfBuzz + ICU BiDi. Pure ASCII lines skip
+    // HarfBuzz when the primary font is fixed-advance without ligatures or
+    // kerning, giving the same glyphs and positions from a lookup table.
     // If max_width_px > 0, stop shaping after exceeding that logical width (lazy shaping).
     GlyphRun shape_line(std::string_view utf8, int max_width_px = 0);
 
     // Blit all glyphs in the run at baseline position (x, y+ascent).
-    void draw_run(Renderer& r, const GlyphRun& run, int x, int y, Color tint);
+    // Returns false if some glyphs were skipped because they are still
+    // being rasterized: draw the run again once they land.
+    bool draw_run(Renderer& r, const GlyphRun& run, int x, int y, Color tint);
 
     // Styled draw: render glyphs with per-span foreground, background, and underline.
     // flat_spans must be sorted, non-overlapping (output of DecorationCompositor::flatten).
-    void draw_run(Renderer& r, const GlyphRun& run, int x, int y,
+    // Returns false as the plain overload does.
+    bool draw_run(Renderer& r, const GlyphRun& run, int x, int y,
                   const std::vector<StyledSpan>& flat_spans,
                   std::string_view utf8);
 
+    // Draws the decimal number n with its right edge at right_x, from
+    // digit glyphs shaped once per font size and DPI, without shaping.
+    // Returns false as draw_run() does.
+    bool draw_number(Renderer& r, size_t n, int right_x, int y, Color tint);
+
+    // Requests rasterization of the run's glyphs that are not in the atlas
+    // yet, without drawing.
+    void prefetch(const GlyphRun& run);
+
     // Pixel x-offset of the left edge of column col within the run.
     // utf8 is the original line text (needed for byte↔codepoint mapping).
     int x_for_column(const GlyphRun& run, std::string_view utf8, size_t col) const;
@@ -59,15 +82,48 @@ public:
     // Reinitialize with a new DPI scale (after font rebuild).
     void reset(float dpi_scale);
 
+    // The ASCII lookup-table path of shape_line(), on by default where the
+    // font allows it. Off, ASCII lines go through HarfBuzz like the rest
+    // (tests compare the two).
+    void set_ascii_path(bool enabled);
+
     int line_height() const { return line_height_; }
     int ascent()      const { return ascent_; }
 
+    // HarfBuzz front end with the word cache, for stats.
+    const Shaper& shaper() const { return *shaper_; }
+
 private:
+    // Fills ascii_glyphs_ from the primary font, or leaves ascii_advance_
+    // at 0 if it is not eligible for the ASCII path.
+    void build_ascii_table();
+    // Shapes '0'..'9' into digits_, or clears it if some digit does not
+    // shape to a single glyph.
+    void build_digit_table();
+    // The ASCII path: false (run untouched) if some byte has no entry.
+    bool shape_ascii(std::string_view utf8, int phys_limit, GlyphRun& run) const;
+
+    // Makes the run's glyphs resident in the atlas, filling resolved_
+    // (nullptr where there is nothing to draw yet). Returns the highest
+    // atlas page among them, -1 if none; `pending` is set if any are still
+    // being rasterized.
+    int  resolve(const GlyphRun& run, bool& pending);
+    void blit_glyph(Renderer& r, const GlyphEntry& ge, const AtlasGlyph& ag,
+                    int x, int baseline_y, Color c);
+
     GlyphAtlas& atlas_;
     FontChain&  fonts_;
+    std::vector<const AtlasGlyph*> resolved_;
+    std::array<uint32_t, 128> ascii_glyphs_{};  // 0: not in the primary font
+    int ascii_advance_{0};                      // physical pixels; 0: path off
+    bool ascii_enabled_{true};
+    // Digit glyphs (x is unused) and physical advances; empty: shape numbers.
+    std::vector<GlyphEntry> digits_;
+    std::array<int, 10>     digit_advance_{};
     float dpi_scale_{1.0f};
     int line_height_;
     int ascent_;
+    std::unique_ptr<Shaper> shaper_;
 };
 
 } // namespace sprawn
@@ -15,6 +15,9 @@ public:
 
     // Poll pending events. Returns false if a quit event was received.
     bool poll_events(const std::function<void(const SDL_Event&)>& handler);
+    // Like poll_events(), but first blocks up to `timeout_ms` for an event
+    // to arrive.
+    bool wait_events(int timeout_ms, const std::function<void(const SDL_Event&)>& handler);
 
     void present();
 
@@ -27,6 +30,9 @@ public:
     float dpi_scale() const { return dpi_scale_; }
 
 private:
+    // Returns false for a quit event.
+    bool dispatch(const SDL_Event& ev, const std::function<void(const SDL_Event&)>& handler);
+
     SDL_Window*   window_{};
     SDL_Renderer* renderer_{};
     int   width_{};
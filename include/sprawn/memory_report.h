@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sprawn {
+
+struct MemoryEntry {
+    std::string name;   // dotted subsystem path, e.g. "backend.line_index"
+    size_t      bytes;  // heap bytes owned by the subsystem
+};
+
+// Heap footprint broken down by subsystem, plus the memory-mapped file.
+// Mapped pages are reported separately: they are backed by the file and
+// only count towards RSS while resident.
+struct MemoryReport {
+    std::vector<MemoryEntry> entries;
+    size_t mapped_bytes{0};           // size of the mapped file
+    size_t mapped_resident_bytes{0};  // portion of it currently in RAM
+
+    void   add(std::string name, size_t bytes);
+    size_t heap_total() const;
+
+    // Single-line JSON object, stable key order (for diffing in CI).
+    std::string to_json() const;
+};
+
+} // namespace sprawn
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <sprawn/middleware/decoration_source.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sprawn {
+
+class Controller;
+class WorkerPool;
+
+// Runs a Producer too slow for a frame — linter, semantic highlighting,
+// spell-check — as a decoration source. decorate() returns whatever is
+// cached for the line (possibly nothing) and queues the line for the
+// producer's compute() on the worker pool; each result is published dirty when it lands, so only its line is
+// recomposited. Edits renumber cached results, queued lines and the line
+// being computed along with their lines (EditRecord::map_line()); those
+// of lines the edit changed are dropped, and everything is dropped when
+// a file is opened.
+//
+// The source owns its producer and destroys it only after the last
+// computation finished, so compute() can never outlive the state it reads.
+class AsyncDecorationSource final : public DecorationSource {
+public:
+    class Producer {
+    public:
+        virtual ~Producer() = default;
+        virtual std::string_view name() const = 0;
+        virtual int base_priority() const { return 0; }
+        // Decorations of one line, called on a pool thread with a copy of
+        // its text. Must not touch the controller or document.
+        virtual LineDecoration compute(size_t line_number, std::string_view text) const = 0;
+    };
+
+    AsyncDecorationSource(Controller& ctrl, WorkerPool& pool, std::unique_ptr<Producer> producer);
+    // Drops queued lines and waits for the one being computed, then
+    // destroys the producer.
+    ~AsyncDecorationSource() override;
+
+    std::string_view name() const override { return producer_->name(); }
+    int base_priority() const override { return producer_->base_priority(); }
+    LineDecoration decorate(size_t line_number) const override;
+    size_t         memory_usage() const override;
+    void           on_edit(const EditRecord& edit) override;
+    // True while lines are queued or being computed, so the event loop
+    // keeps polling until their results are drawn.
+    bool           on_idle(std::chrono::steady_clock::time_point deadline) override;
+
+    static constexpr size_t kCacheCapacity = 4096;
+    // Requests beyond this drop the oldest: they were for lines the
+    // viewport has most likely scrolled past.
+    static constexpr size_t kMaxQueued = 1024;
+
+private:
+    struct Request {
+        size_t      line;
+        std::string text;
+    };
+
+    // Pool task: computes queued lines, most recent request first, until
+    // the queue is empty.
+    void run_queue() const;
+    void evict_far_from(size_t line_number) const;
+
+    Controller& ctrl_;
+    WorkerPool& pool_;
+    const std::unique_ptr<Producer> producer_;
+
+    mutable std::mutex              mutex_;
+    mutable std::condition_variable idle_;
+    mutable std::unordered_map<size_t, LineDecoration> cache_;
+    mutable std::vector<Request>    queue_;
+    mutable std::unordered_set<size_t> queued_;  // lines in queue_ or in flight
+    mutable size_t                  in_flight_{0};
+    mutable bool                    in_flight_valid_{false};
+    mutable bool                    running_{false};
+    mutable uint64_t                version_{0};  // to notice a file being opened
+    mutable size_t                  known_line_count_{0};
+};
+
+} // namespace sprawn
@@ -1,9 +1,16 @@
 #pragma once
 
 #include <sprawn/decoration.h>
+#include <sprawn/memory_report.h>
 #include <sprawn/middleware/decoration_source.h>
+#include <sprawn/middleware/decoration_stats.h>
+#include <sprawn/middleware/edit_journal.h>
+#include <sprawn/middleware/line_generations.h>
+#include <sprawn/middleware/line_versions.h>
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <string>
@@ -13,6 +20,7 @@
 namespace sprawn {
 
 class Document;
+class WorkerPool;
 
 class Controller {
 public:
@@ -26,19 +34,94 @@ public:
 
     virtual void open_file(const std::filesystem::path& path);
     virtual std::string line(size_t line_number) const;
+    virtual void line(size_t line_number, std::string& out) const;
     virtual size_t line_count() const;
     virtual void insert(size_t line, size_t col, std::string_view text);
     virtual void erase(size_t line, size_t col, size_t count);
+    virtual uint64_t document_version() const;
+
+    // Edits until the matching end_batch() share one EditRecord::batch,
+    // e.g. replacing a selection with typed text. Calls nest.
+    void begin_batch();
+    void end_batch();
+    // Every insert() and erase(), also passed to the sources' on_edit().
+    const EditJournal& edit_journal() const { return journal_; }
 
     void add_decoration_source(std::shared_ptr<DecorationSource> source);
     void remove_decoration_source(std::string_view name);
     virtual LineDecoration decorations(size_t line_number) const;
+    // Decorations of lines [first, last) into `out` (reset first), each
+    // source's base priority applied. Reusing `out` across frames avoids
+    // per-line allocations. With a worker pool and at least
+    // kParallelDecorationLines lines, sources are evaluated in parallel.
+    virtual void decorations(size_t first, size_t last, DecorationBuffer& out) const;
+
+    // Pool for decorations(first, last, out); nullptr evaluates sources in turn.
+    void set_worker_pool(WorkerPool* pool) { pool_ = pool; }
+
+    static constexpr size_t kParallelDecorationLines = 64;
+
+    // Time allowed to each source per range query; zero (the default)
+    // disables the check. A source that overruns it is skipped for the next
+    // 1, 2, 4, ... frames (up to kMaxBudgetBackoff), its previous spans
+    // standing in; the lines served that way get a new generation once the
+    // backoff ends, so they are asked for again.
+    void set_decoration_budget(std::chrono::microseconds budget) { budget_ = budget; }
+    static constexpr uint32_t kMaxBudgetBackoff = 64;
+
+    // Timing of every source's range queries, in registration order.
+    const std::vector<DecorationSourceStats>& decoration_stats() const { return stats_; }
+
+    // Moves whenever the decorations of `line` may have changed: its text
+    // was edited, lines shifted under it, or a source published it dirty.
+    // Frontends cache composited spans per line keyed on this.
+    uint64_t decoration_generation(size_t line) const { return generations_.at(line); }
+    // Identifies the text of `line`: moves when the line is edited, stays
+    // when edits elsewhere shift it, never repeats. Frontends key caches
+    // of per-line results (shaped runs) on it instead of hashing the text.
+    uint64_t line_version(size_t line) const { return versions_.at(line); }
+    // Drains the ranges sources published since the last call, plus lines
+    // served stale by sources coming out of a budget backoff, bumps their
+    // generations and returns their union. Call once per frame.
+    LineRange poll_decoration_changes();
+
+    // Give every decoration source a share of `budget` for background work.
+    // Returns true while any source still has work pending or is in a
+    // budget backoff.
+    bool on_idle(std::chrono::microseconds budget);
+
+    // Heap usage of the document and every decoration source, plus the
+    // resident share of the mapped file. Frontends append their own entries.
+    virtual MemoryReport memory_report() const;
 
 protected:
     Document& doc_;
 
 private:
+    // Stamps version and batch, then hands `rec` to generations, sources
+    // and the journal.
+    void publish_edit(EditRecord rec);
+
+    // Budget state of one source, parallel to sources_.
+    struct Backoff {
+        uint32_t  frames{0};   // frames left to skip
+        uint32_t  length{0};   // frames skipped after the last overrun
+        LineRange served_stale;
+    };
+
     std::vector<std::shared_ptr<DecorationSource>> sources_;
+    WorkerPool*                                    pool_{nullptr};
+    // One per source for range queries, reused across calls. A skipped
+    // source's buffer keeps its previous spans as the fallback.
+    mutable std::vector<DecorationBuffer>          source_buffers_;
+    mutable std::vector<DecorationSourceStats>     stats_;
+    mutable std::vector<Backoff>                   backoff_;
+    std::chrono::microseconds                      budget_{0};
+    LineGenerations                                generations_;
+    LineVersions                                   versions_;
+    EditJournal                                    journal_;
+    uint64_t                                       batch_{0};
+    int                                            batch_depth_{0};
 };
 
 } // namespace sprawn
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <sprawn/decoration.h>
+#include <sprawn/middleware/edit_journal.h>
 
+#include <chrono>
 #include <cstddef>
+#include <mutex>
 #include <string_view>
 
 namespace sprawn {
@@ -11,12 +14,51 @@ class DecorationSource {
 public:
     virtual ~DecorationSource() = default;
     virtual LineDecoration decorate(size_t line_number) const = 0;
+    // Spans of lines [first, last) appended to `out`, with one end_line()
+    // per line. The default calls decorate() per line; sources that share
+    // work between consecutive lines override it. Called from one thread
+    // at a time, but possibly not the one that calls decorate().
+    virtual void decorate_range(size_t first, size_t last, DecorationBuffer& out) const {
+        for (size_t line = first; line < last; ++line) {
+            for (const auto& span : decorate(line).spans) out.push(span);
+            out.end_line();
+        }
+    }
     virtual std::string_view name() const = 0;
     virtual int base_priority() const { return 0; }
-    virtual void on_edit(size_t line, size_t col,
-                         std::string_view text, bool is_insert) {
-        (void)line; (void)col; (void)text; (void)is_insert;
+    // Heap bytes held by the source's caches (reported by Controller::memory_report).
+    virtual size_t memory_usage() const { return 0; }
+    // Called after every insert and erase, with the document already changed.
+    virtual void on_edit(const EditRecord& edit) {
+        (void)edit;
+    }
+    // Called from the event loop when it has spare time. Do incremental
+    // background work until `deadline`; return true if more work remains.
+    virtual bool on_idle(std::chrono::steady_clock::time_point deadline) {
+        (void)deadline;
+        return false;
+    }
+
+    // Lines published dirty since the last call (Controller polls once per
+    // frame). Thread-safe.
+    LineRange take_dirty() {
+        std::lock_guard lock(dirty_mutex_);
+        LineRange r = dirty_;
+        dirty_ = {};
+        return r;
     }
+
+protected:
+    // Marks lines whose decorate() output changed without a text edit:
+    // results arrived, states converged. Thread-safe.
+    void publish_dirty(LineRange lines) const {
+        std::lock_guard lock(dirty_mutex_);
+        dirty_.merge(lines);
+    }
+
+private:
+    mutable std::mutex dirty_mutex_;
+    mutable LineRange  dirty_;
 };
 
 } // namespace sprawn
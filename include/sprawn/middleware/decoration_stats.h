@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sprawn {
+
+// Latencies of the last kWindow samples in power-of-two microsecond
+// buckets: recording is O(1) and a percentile walks kBuckets counters.
+class LatencyHistogram {
+public:
+    static constexpr size_t kWindow  = 256;
+    // Bucket 0 holds samples under 1 us, bucket b >= 1 [2^(b-1), 2^b) us;
+    // the last one everything slower.
+    static constexpr size_t kBuckets = 24;
+
+    void record(std::chrono::microseconds latency);
+
+    size_t samples() const { return count_; }
+    // Upper bound of the bucket holding the p-th percentile (0..100) of
+    // the window; zero without samples.
+    std::chrono::microseconds percentile(double p) const;
+    std::chrono::microseconds max() const;
+    const std::array<uint32_t, kBuckets>& buckets() const { return buckets_; }
+
+private:
+    static size_t bucket_of(uint32_t us);
+
+    std::array<uint32_t, kWindow>  ring_{};  // the window's samples, in us
+    std::array<uint32_t, kBuckets> buckets_{};
+    size_t                         next_{0};
+    size_t                         count_{0};
+};
+
+// Timing of one source's range queries in Controller::decorations().
+struct DecorationSourceStats {
+    std::string               name;
+    uint64_t                  calls{0};
+    // Range queries answered from the source's previous spans because it
+    // had overrun the budget.
+    uint64_t                  skipped{0};
+    std::chrono::microseconds last{0};
+    LatencyHistogram          latency;
+};
+
+} // namespace sprawn
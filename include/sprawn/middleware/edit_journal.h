@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sprawn {
+
+// One insert or erase, as published by Controller to decoration sources
+// and kept in its EditJournal. Positions are byte columns.
+struct EditRecord {
+    uint64_t version{0};       // Document::version() after the edit
+    uint64_t batch{0};         // edits made between begin_batch()/end_batch() share it
+    size_t   offset{0};        // absolute byte offset of the edit
+    size_t   old_length{0};    // bytes erased
+    size_t   new_length{0};    // bytes inserted
+    size_t   line{0};          // start of the edit (same before and after)
+    size_t   col{0};
+    size_t   old_end_line{0};  // end of the erased text, before the edit
+    size_t   old_end_col{0};
+    size_t   new_end_line{0};  // end of the inserted text, after the edit
+    size_t   new_end_col{0};
+    size_t   lines_removed{0}; // line breaks erased
+    size_t   lines_added{0};   // line breaks inserted
+    // The erased bytes, if at most EditJournal::kMaxErasedText of them:
+    // erased_text.size() == old_length tells whether they were kept.
+    std::string erased_text;
+
+    long long line_delta() const {
+        return static_cast<long long>(lines_added) - static_cast<long long>(lines_removed);
+    }
+
+    // Where line `l` from before the edit is after it. Lines before the
+    // edit stay, lines after the erased ones move by line_delta(); nullopt
+    // for the lines whose text changed: `line` itself and the erased lines
+    // (line, line + lines_removed].
+    std::optional<size_t> map_line(size_t l) const {
+        if (l < line) return l;
+        if (l > line + lines_removed)
+            return static_cast<size_t>(static_cast<long long>(l) + line_delta());
+        return std::nullopt;
+    }
+};
+
+// The most recent edits, oldest dropped first, so asynchronous consumers
+// can replay what changed since the version they last saw instead of
+// rebuilding. Thread-safe.
+class EditJournal {
+public:
+    static constexpr size_t kDefaultCapacity = 1024;
+    static constexpr size_t kMaxErasedText   = 64 * 1024;
+
+    explicit EditJournal(size_t capacity = kDefaultCapacity) : capacity_(capacity) {}
+
+    void push(EditRecord record);
+    // Forgets every record; consumers older than `version` must rebuild
+    // (a new file was opened).
+    void reset(uint64_t version);
+
+    // Appends the records newer than `version`, oldest first, to `out`.
+    // Returns false if some of them were already dropped: the consumer
+    // has to rebuild from the document instead.
+    bool since(uint64_t version, std::vector<EditRecord>& out) const;
+
+    size_t size() const;
+    size_t memory_usage() const;
+
+private:
+    mutable std::mutex      mutex_;
+    std::deque<EditRecord>  records_;
+    size_t                  capacity_;
+    uint64_t                dropped_through_{0};  // newest version no longer held
+};
+
+} // namespace sprawn
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sprawn {
+
+enum class WordClass : uint8_t {
+    None,
+    Keyword,
+    Type,
+};
+
+struct KeywordEntry {
+    std::string_view word;
+    WordClass        cls;
+};
+
+// Minimal perfect hashing (hash-and-displace) over a fixed word set.
+// Words are grouped into buckets by one half of a 64-bit hash; each bucket
+// gets a displacement that scatters its words into free slots using the
+// other half. A lookup is one hash, two array reads and one compare.
+namespace keyword_detail {
+
+inline constexpr uint16_t kEmptySlot = 0xFFFF;
+inline constexpr uint32_t kMaxDisplacement = 1u << 16;
+
+constexpr uint64_t hash_word(std::string_view w) {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ w.size();
+    for (char c : w) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 0x100000001B3ull;
+    }
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+constexpr uint32_t bucket_of(uint64_t h, size_t bucket_mask) {
+    return static_cast<uint32_t>(h) & static_cast<uint32_t>(bucket_mask);
+}
+
+constexpr uint32_t slot_of(uint64_t h, uint32_t disp, size_t slot_mask) {
+    uint32_t x = static_cast<uint32_t>(h >> 32) ^ (disp * 0x9E3779B9u);
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    return x & static_cast<uint32_t>(slot_mask);
+}
+
+constexpr size_t slot_count(size_t n)   { return std::bit_ceil(std::max<size_t>(n * 4, 2)); }
+constexpr size_t bucket_count(size_t n) { return std::bit_ceil(std::max<size_t>(n / 2, 1)); }
+
+// Fills `slots` (power-of-two size, kEmptySlot = free) and `disp` (power-of-
+// two size). Returns false if some bucket found no displacement; callers
+// then retry with more slots. Words must be unique.
+template <class Words, class Slots, class Disp>
+constexpr bool build(const Words& words, Slots& slots, Disp& disp) {
+    const size_t n = words.size();
+    for (auto& s : slots) s = kEmptySlot;
+    for (auto& d : disp)  d = 0;
+
+    std::vector<std::vector<uint16_t>> buckets(disp.size());
+    for (size_t i = 0; i < n; ++i)
+        buckets[bucket_of(hash_word(words[i].word), disp.size() - 1)]
+            .push_back(static_cast<uint16_t>(i));
+
+    // Place the fullest buckets first, while most slots are still free.
+    std::vector<uint32_t> order(buckets.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<uint32_t>(i);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<uint32_t> placed;
+    for (uint32_t b : order) {
+        const auto& keys = buckets[b];
+        if (keys.empty()) break;
+        bool ok = false;
+        for (uint32_t d = 0; d < kMaxDisplacement && !ok; ++d) {
+            placed.clear();
+            ok = true;
+            for (uint16_t k : keys) {
+                uint32_t s = slot_of(hash_word(words[k].word), d, slots.size() - 1);
+                if (slots[s] != kEmptySlot ||
+                    std::find(placed.begin(), placed.end(), s) != placed.end())
+                {
+                    ok = false;
+                    break;
+                }
+                placed.push_back(s);
+            }
+            if (ok) {
+                for (size_t j = 0; j < keys.size(); ++j) slots[placed[j]] = keys[j];
+                disp[b] = d;
+            }
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+} // namespace keyword_detail
+
+// Perfect hash table generated at compile time for a built-in language:
+//   static constexpr auto kTable = make_keyword_table(std::array{...});
+template <size_t N>
+struct StaticKeywordTable {
+    static_assert(N < keyword_detail::kEmptySlot, "too many words");
+    std::array<KeywordEntry, N>                               words;
+    std::array<uint16_t, keyword_detail::slot_count(N)>       slots;
+    std::array<uint32_t, keyword_detail::bucket_count(N)>     disp;
+};
+
+template <size_t N>
+constexpr StaticKeywordTable<N> make_keyword_table(const std::array<KeywordEntry, N>& words) {
+    StaticKeywordTable<N> t{words, {}, {}};
+    if (!keyword_detail::build(t.words, t.slots, t.disp))
+        throw "keyword perfect hash construction failed";  // compile-time error
+    return t;
+}
+
+// Lookup handle used by the scanner. Either views a StaticKeywordTable with
+// static storage duration, or owns a table built at language load time.
+// Copies are cheap and share the storage.
+class KeywordTable {
+public:
+    KeywordTable() = default;
+
+    // Build at load time. Duplicates are ignored; a word listed in both
+    // sets is classified as a keyword.
+    KeywordTable(const std::vector<std::string>& keywords,
+                 const std::vector<std::string>& types);
+
+    template <size_t N>
+    explicit KeywordTable(const StaticKeywordTable<N>& t)
+        : words_(t.words), slots_(t.slots), disp_(t.disp) {}
+
+    WordClass lookup(std::string_view w) const {
+        if (slots_.empty()) return WordClass::None;
+        uint64_t h = keyword_detail::hash_word(w);
+        uint32_t d = disp_[keyword_detail::bucket_of(h, disp_.size() - 1)];
+        uint16_t idx = slots_[keyword_detail::slot_of(h, d, slots_.size() - 1)];
+        if (idx == keyword_detail::kEmptySlot) return WordClass::None;
+        const KeywordEntry& e = words_[idx];
+        return e.word == w ? e.cls : WordClass::None;
+    }
+
+    bool   empty() const { return words_.empty(); }
+    size_t size()  const { return words_.size(); }
+
+    // Heap bytes owned by a load-time table (0 for static tables).
+    size_t memory_usage() const;
+
+private:
+    struct Storage;
+
+    std::span<const KeywordEntry> words_;
+    std::span<const uint16_t>     slots_;
+    std::span<const uint32_t>     disp_;
+    std::shared_ptr<const Storage> storage_;
+};
+
+} // namespace sprawn
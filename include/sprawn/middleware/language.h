@@ -0,0 +1,145 @@
+#pragma once
+
+#include <sprawn/middleware/keyword_table.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sprawn {
+
+enum class TokenType {
+    Plain,
+    Keyword,
+    Type,
+    StringLiteral,
+    CharLiteral,
+    Number,
+    Comment,
+    Preprocessor,
+};
+
+struct Token {
+    int       byte_start;
+    int       byte_end;
+    TokenType type;
+};
+
+// Lexer state carried from the end of one line into the next: which
+// multi-line rule is still open, how deeply it is nested, and the closing
+// delimiter captured from the opener (raw strings, heredocs). Eight bytes,
+// so it is passed and returned in a register.
+struct LineState {
+    uint16_t region{0};  // 0: code; otherwise 1 + index into LanguageDef::rules
+    uint16_t depth{0};   // nesting depth; for heredocs, 1 if tabs may indent the end
+    uint32_t delim{0};   // hash of the captured closing tag; '#' count for HashRaw
+
+    bool operator==(const LineState&) const = default;
+
+    static const LineState Normal;
+    // Inside the first rule of the language: the block comment for the
+    // built-in C-family definitions.
+    static const LineState InBlockComment;
+};
+
+inline constexpr LineState LineState::Normal{};
+inline constexpr LineState LineState::InBlockComment{1, 0, 0};
+
+enum class DelimiterKind : uint8_t {
+    Fixed,      // body ends at `close`
+    RawString,  // C++ R"tag( ... )tag"
+    HashRaw,    // Rust r#" ... "#: as many '#' after the quote as before it
+    Heredoc,    // <<WORD, <<-WORD, <<'WORD': the following lines up to WORD
+};
+
+enum class RuleAnchor : uint8_t {
+    Anywhere,
+    LineStart,   // first non-blank byte of the line only
+    AfterBlank,  // at line start or after a space or tab
+};
+
+// A token that runs from an opening to a closing delimiter: comments,
+// strings, preprocessor lines. An empty `close` runs to end of line.
+struct DelimitedRule {
+    TokenType     type{TokenType::Plain};
+    std::string   open;
+    std::string   close;
+    char          escape{0};          // the byte after it never closes the rule; an
+                                      // opener ending in it escapes the first body byte
+    bool          multiline{false};   // unterminated at end of line: continues
+    bool          nestable{false};    // `open` in the body nests (Rust comments)
+    DelimiterKind kind{DelimiterKind::Fixed};
+    RuleAnchor    anchor{RuleAnchor::Anywhere};
+    uint16_t      max_length{0};      // nonzero: longer or unterminated matches are
+                                      // rejected (Rust char literals vs lifetimes)
+    uint8_t       max_code_points{0}; // nonzero: likewise for bodies of more UTF-8
+                                      // code points
+};
+
+struct NumberRule {
+    bool        enabled{true};
+    char        separator{0};   // digit separator, e.g. '\'' or '_'
+    bool        hex{true};      // 0x
+    bool        binary{true};   // 0b
+    bool        octal{false};   // 0o
+    bool        exponent{true};
+    std::string suffixes;       // bytes allowed after the digits, e.g. "uUlLfF"
+};
+
+// Declarative language description, compiled by the highlighter into lookup
+// tables when selected. Rules sharing a first byte are tried longest first.
+struct LanguageDef {
+    std::string                name;
+    std::vector<DelimitedRule> rules;
+    NumberRule                 numbers;
+    std::vector<std::string>   keywords;
+    std::vector<std::string>   types;
+    std::vector<std::string>   extensions;   // e.g. ".cpp", ".h"
+    std::vector<std::string>   shebangs;     // interpreter names, e.g. "python3"
+    // Perfect hash over keywords/types. Built-in languages ship one
+    // generated at compile time; if empty, set_language() builds it.
+    KeywordTable               keyword_table;
+
+    static LanguageDef cpp();
+    static LanguageDef python();
+    static LanguageDef json();
+    static LanguageDef yaml();
+    static LanguageDef rust();
+    static LanguageDef go();
+    static LanguageDef shell();
+    static LanguageDef log();
+};
+
+// Languages by name, file extension and shebang interpreter.
+class LanguageRegistry {
+public:
+    // Every built-in LanguageDef.
+    static const LanguageRegistry& builtin();
+
+    // Later definitions take over extensions and interpreters they share
+    // with earlier ones.
+    void add(LanguageDef def);
+
+    const LanguageDef* by_name(std::string_view name) const;
+    const LanguageDef* by_extension(std::string_view ext) const;
+    // `first_line` like "#!/usr/bin/env python3"; nullptr if not a shebang.
+    const LanguageDef* by_shebang(std::string_view first_line) const;
+    // Extension first, then the shebang on the first line.
+    const LanguageDef* detect(const std::filesystem::path& path,
+                              std::string_view first_line) const;
+
+    size_t size() const { return langs_.size(); }
+
+private:
+    std::vector<std::unique_ptr<LanguageDef>> langs_;
+    std::unordered_map<std::string, const LanguageDef*> names_;
+    std::unordered_map<std::string, const LanguageDef*> extensions_;
+    std::unordered_map<std::string, const LanguageDef*> interpreters_;
+};
+
+} // namespace sprawn
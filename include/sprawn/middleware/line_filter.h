@@ -0,0 +1,63 @@
+#pragma once
+
+#include <sprawn/decoration.h>
+#include <sprawn/middleware/edit_journal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sprawn {
+
+class Controller;
+class WorkerPool;
+
+// The document lines containing a pattern, in order: the line mapping of
+// a filtered ("grep") view. Built by one parallel scan and kept current by
+// replaying the controller's edit journal, so appends and edits rescan
+// only the lines they touched. Lookups are O(1) from view to document
+// line and O(log n) back.
+class LineFilter {
+public:
+    // Scans the whole document on `pool` (nullptr: on the calling thread).
+    LineFilter(const Controller& ctrl, std::string pattern, WorkerPool* pool = nullptr);
+
+    const std::string& pattern() const { return pattern_; }
+    size_t size() const { return matches_.size(); }
+    bool   empty() const { return matches_.empty(); }
+
+    // Document line shown at `view_line` (< size()).
+    size_t doc_line(size_t view_line) const { return matches_[view_line]; }
+    // View line of the first match at or after `doc_line`; the last one if
+    // there is none after it, 0 if there are no matches.
+    size_t view_line(size_t doc_line) const;
+    bool   contains(size_t doc_line) const;
+
+    // Catches up with edits made since the last call. Returns true if the
+    // matches changed.
+    bool sync();
+
+    size_t memory_usage() const;
+
+    // Lines per task of a parallel scan.
+    static constexpr size_t kChunkLines = 16 * 1024;
+
+private:
+    // Matching lines of [first, last), in order, appended to `out`.
+    void scan(size_t first, size_t last, std::vector<size_t>& out) const;
+    void rescan_all();
+    // Renumbers matches for `edit` and drops those on lines it touched;
+    // the touched lines are added to `dirty_` for rescanning.
+    void apply(const EditRecord& edit);
+
+    const Controller&   ctrl_;
+    std::string         pattern_;
+    WorkerPool*         pool_;
+    std::vector<size_t> matches_;
+    uint64_t            version_{0};
+    std::vector<LineRange>  dirty_;
+    std::vector<EditRecord> replay_;
+};
+
+} // namespace sprawn
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <sprawn/decoration.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace sprawn {
+
+// A generation number per line that moves whenever the line's decorations
+// may have changed. Stored as runs of lines sharing one value, so a huge
+// file with a few edited regions costs a handful of entries.
+class LineGenerations {
+public:
+    // Gives every line in `lines` a new generation, unique across calls,
+    // and returns it.
+    uint64_t bump(LineRange lines);
+    uint64_t bump_all();
+
+    uint64_t at(size_t line) const;
+
+    size_t runs() const { return runs_.size(); }
+    size_t memory_usage() const;
+
+    // Past this many runs the next bump renumbers every line at once:
+    // one full recomposite instead of unbounded growth.
+    static constexpr size_t kMaxRuns = 4096;
+
+private:
+    std::map<size_t, uint64_t> runs_{{0, 0}};  // first line of run -> generation
+    uint64_t                   next_{1};
+};
+
+} // namespace sprawn
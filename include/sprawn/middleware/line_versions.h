@@ -0,0 +1,42 @@
+#pragma once
+
+#include <sprawn/middleware/edit_journal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace sprawn {
+
+// A version stamp per line that identifies its text: it changes when the
+// line is edited and follows the line when edits elsewhere move it to
+// another line number. Stamps are never reused, so equal stamps mean equal
+// text and frontends can key caches on them without reading or hashing
+// the line. Stored as runs of consecutive lines with consecutive stamps:
+// a run starting at line F with base B gives line L the stamp B + (L - F).
+class LineVersions {
+public:
+    explicit LineVersions(size_t line_count = 0) { reset(line_count); }
+
+    // Fresh stamps for a document of `line_count` lines (a file was opened).
+    void reset(size_t line_count);
+    // Lines touched by `edit` get fresh stamps; the ones after it move by
+    // its change in line count, keeping theirs.
+    void apply(const EditRecord& edit);
+
+    uint64_t at(size_t line) const;
+
+    size_t runs() const { return runs_.size(); }
+    size_t memory_usage() const;
+
+    // Past this many runs the next edit restamps every line at once: one
+    // full cache miss instead of unbounded growth.
+    static constexpr size_t kMaxRuns = 4096;
+
+private:
+    std::map<size_t, uint64_t> runs_;     // first line of run -> base stamp
+    uint64_t                   next_{1};  // first stamp not handed out
+    size_t                     line_count_{0};
+};
+
+} // namespace sprawn
@@ -2,39 +2,23 @@
 
 #include <sprawn/decoration.h>
 #include <sprawn/middleware/decoration_source.h>
+#include <sprawn/middleware/language.h>
 
-#include <array>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace sprawn {
 
 class Controller;
-
-enum class TokenType {
-    Plain,
-    Keyword,
-    Type,
-    StringLiteral,
-    CharLiteral,
-    Number,
-    Comment,
-    Preprocessor,
-};
-
-struct Token {
-    int       byte_start;
-    int       byte_end;
-    TokenType type;
-};
-
-enum class LineState {
-    Normal,
-    InBlockComment,
-};
+class Lexer;
+class WorkerPool;
 
 struct SyntaxTheme {
     TextStyle plain;
@@ -50,50 +34,146 @@ struct SyntaxTheme {
     static SyntaxTheme dark_default();
 };
 
-struct LanguageDef {
-    std::vector<std::string> keywords;       // sorted
-    std::vector<std::string> types;          // sorted
-    std::string              line_comment;   // e.g. "//"
-    std::string              block_open;     // e.g. "/*"
-    std::string              block_close;    // e.g. "*/"
-    std::vector<std::string> extensions;     // e.g. ".cpp", ".h"
-
-    static LanguageDef cpp();
-};
-
 struct ScanResult {
     std::vector<Token> tokens;
     LineState          exit_state;
 };
 
+// Exact entry state of `line`; the highlighter keeps one roughly every
+// kCheckpointInterval lines instead of one per line.
+struct Checkpoint {
+    size_t    line;
+    LineState state;
+};
+
+struct TokenCacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t evictions{0};
+    size_t   entries{0};
+    size_t   capacity{0};
+
+    double hit_rate() const {
+        uint64_t total = hits + misses;
+        return total ? static_cast<double>(hits) / static_cast<double>(total) : 0.0;
+    }
+};
+
 class SyntaxHighlighter : public DecorationSource {
 public:
     explicit SyntaxHighlighter(Controller& ctrl);
 
+    // Compiles `lang` into the scanner tables.
     void set_language(const LanguageDef& lang);
-    void detect_language(const std::filesystem::path& filepath);
+    // By extension, then by the shebang on the document's first line.
+    // Highlighting is off if nothing matches.
+    void detect_language(const std::filesystem::path& filepath,
+                         const LanguageRegistry& registry = LanguageRegistry::builtin());
+    // Name of the active language, empty while highlighting is off.
+    std::string_view language_name() const;
 
     // DecorationSource interface
     LineDecoration   decorate(size_t line_number) const override;
+    void             decorate_range(size_t first, size_t last,
+                                    DecorationBuffer& out) const override;
     std::string_view name() const override;
     int              base_priority() const override;
-    void             on_edit(size_t line, size_t col,
-                             std::string_view text, bool is_insert) override;
+    size_t           memory_usage() const override;
+    void             on_edit(const EditRecord& edit) override;
+    bool             on_idle(std::chrono::steady_clock::time_point deadline) override;
+
+    // True if `line` was last decorated from a guessed (Normal) entry state
+    // because the exact state has not been scanned that far yet.
+    bool is_speculative(size_t line) const;
+
+    // Background confirmation lexes chunks of the file on `pool` when one
+    // is set (nullptr: one chunk at a time on the calling thread).
+    void set_worker_pool(WorkerPool* pool) { pool_ = pool; }
+
+    // Entry states are exact for every line <= confirmed_line().
+    size_t confirmed_line() const { return frontier_; }
+
+    TokenCacheStats token_cache_stats() const;
+
+    // Scan one line into `tokens` (cleared first, capacity reused) and
+    // return its exit state. Does not allocate once `tokens` has grown.
+    LineState  scan_line(std::string_view text, LineState entry,
+                         std::vector<Token>& tokens) const;
 
     // Exposed for testing
     ScanResult scan_line(std::string_view text, LineState entry) const;
 
+    static constexpr size_t kCheckpointInterval = 256;
+    // Lines past the frontier that decorate() will still scan synchronously;
+    // anything further is highlighted speculatively until on_idle() gets there.
+    static constexpr size_t kMaxSyncLines = 4096;
+    static constexpr size_t kTokenCacheCapacity = 2048;
+    // Largest chunk of the parallel pass (a multiple of kCheckpointInterval).
+    static constexpr size_t kParallelChunkLines = 16 * kCheckpointInterval;
+    // on_idle() sizes each step to what is left of its budget at the
+    // measured scan rate, but always confirms at least this many lines.
+    static constexpr size_t kMinIdleLines = 64;
+
 private:
-    void ensure_states(size_t line_number) const;
+    // Scan result for one line. Valid while the line's text is unchanged
+    // (on_edit drops or renumbers entries) and its entry state matches.
+    struct CachedLine {
+        LineState          entry;
+        LineState          exit;
+        std::vector<Token> tokens;
+    };
+
+    void      reset_states();
+    // After an edit of lines [line, touched_end]: rescan from `line` with
+    // the new text until the state entering a line matches the stored
+    // checkpoint (or frontier) state again, updating checkpoints on the way.
+    void      rescan_until_converged(size_t line, size_t touched_end);
+    void      advance_frontier(size_t target_line) const;
+    // Confirms up to concurrency() chunks of `chunk_lines` (a multiple of
+    // kCheckpointInterval) past the frontier at once.
+    void      advance_frontier_parallel(WorkerPool& pool, size_t chunk_lines) const;
+    LineState entry_state(size_t line_number) const;
+    void      fill_window(size_t line_number) const;
+    const CachedLine& scan_cached(size_t line_number, LineState entry) const;
+    void      evict_far_from(size_t line_number) const;
 
     Controller&   ctrl_;
     LanguageDef   lang_;
+    std::shared_ptr<const Lexer> lexer_;
     SyntaxTheme   theme_;
     bool          active_{false};
-
-    // Mutable for lazy computation in const decorate()
-    mutable std::vector<LineState> entry_state_;
-    mutable size_t                 states_valid_up_to_{0};
+    WorkerPool*   pool_{nullptr};
+    // Measured wall time of on_idle() steps: per line scanned serially, and
+    // per chunk line of a parallel round.
+    double        serial_ns_per_line_{1000};
+    double        parallel_ns_per_line_{4000};
+
+    // Mutable for lazy computation in const decorate().
+    // checkpoints_ is sorted by line, starts at line 0 and has a gap of at
+    // most kCheckpointInterval up to frontier_.
+    mutable std::vector<Checkpoint> checkpoints_;
+    mutable size_t                  frontier_{0};
+    mutable LineState               frontier_state_{LineState::Normal};
+
+    // Entry states of one block of lines around the last decorated line, so
+    // a steady viewport does not rescan from its checkpoint every frame.
+    mutable size_t                 window_first_{0};
+    mutable std::vector<LineState> window_;
+    mutable bool                   window_speculative_{false};
+    // Hull of lines decorated speculatively; published dirty as the
+    // frontier passes them.
+    mutable LineRange              speculative_;
+
+    // Reused by scans that go through the controller, so steady-state
+    // scanning does not allocate.
+    mutable std::string                            line_buf_;
+    mutable std::vector<Token>                     scratch_tokens_;
+    mutable std::unordered_map<size_t, CachedLine> token_cache_;
+    // Evicted nodes, re-keyed and refilled on later misses instead of
+    // freeing and reallocating the node and its token vector.
+    mutable std::vector<std::unordered_map<size_t, CachedLine>::node_type> spare_nodes_;
+    mutable TokenCacheStats                        cache_stats_;
+    mutable size_t                                 known_line_count_{0};
 };
 
 } // namespace sprawn
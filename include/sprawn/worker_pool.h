@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sprawn {
+
+// Fixed set of worker threads fed from one FIFO queue. Used for work that
+// splits into independent pieces (lexing file chunks, rasterizing glyphs).
+class WorkerPool {
+public:
+    // `threads` counts the caller, so threads - 1 workers are started; with
+    // one (or zero) everything runs inline on the calling thread.
+    explicit WorkerPool(size_t threads = std::thread::hardware_concurrency());
+    // Finishes queued tasks, then joins.
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Threads that run parallel_for() work, including the caller.
+    size_t concurrency() const { return threads_.size() + 1; }
+
+    // Run `task` on a worker (inline if there are none). Exceptions escaping
+    // it terminate the program, as for std::thread.
+    void submit(std::function<void()> task);
+
+    // Calls fn(i) for every i in [0, n) on the workers and the calling
+    // thread; returns once all calls finished. The first exception thrown
+    // by `fn` is rethrown here after the rest have completed.
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn);
+
+    // Process-wide pool sized to the machine.
+    static WorkerPool& shared();
+
+private:
+    void run_worker();
+
+    std::vector<std::thread>          threads_;
+    std::mutex                        mutex_;
+    std::condition_variable           wake_;
+    std::deque<std::function<void()>> queue_;
+    bool                              stopping_{false};
+};
+
+} // namespace sprawn
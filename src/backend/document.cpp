@@ -14,9 +14,11 @@ struct Document::Impl {
     PieceTable table;
     LineIndex index;
     Encoding encoding = Encoding::utf8;
+    uint64_t version = 0;
 
     void rebuild_index() {
         index.rebuild(table);
+        ++version;
     }
 };
 
@@ -41,10 +43,28 @@ std::string Document::line(size_t line_number) const {
     return impl_->table.text(span.offset, span.length);
 }
 
+void Document::line(size_t line_number, std::string& out) const {
+    auto span = impl_->index.line_span(line_number);
+    impl_->table.text(span.offset, span.length, out);
+}
+
 size_t Document::line_count() const {
     return impl_->index.line_count();
 }
 
+size_t Document::offset_of(size_t line, size_t col) const {
+    return impl_->index.to_offset(line, col);
+}
+
+std::pair<size_t, size_t> Document::position_of(size_t offset) const {
+    auto pos = impl_->index.to_position(offset);
+    return {pos.line, pos.col};
+}
+
+std::string Document::text(size_t offset, size_t count) const {
+    return impl_->table.text(offset, count);
+}
+
 void Document::insert(size_t line, size_t col, std::string_view text) {
     size_t offset = impl_->index.to_offset(line, col);
     impl_->table.insert(offset, text);
@@ -57,8 +77,22 @@ void Document::erase(size_t line, size_t col, size_t count) {
     impl_->rebuild_index();
 }
 
+uint64_t Document::version() const {
+    return impl_->version;
+}
+
 Encoding Document::encoding() const {
     return impl_->encoding;
 }
 
+void Document::memory_report(MemoryReport& report) const {
+    report.add("backend.line_index", impl_->index.memory_usage());
+    report.add("backend.piece_table.add_buffer", impl_->table.add_buffer_bytes());
+    report.add("backend.piece_table.pieces", impl_->table.pieces_bytes());
+    if (impl_->source) {
+        report.mapped_bytes          += impl_->source->mapped_bytes();
+        report.mapped_resident_bytes += impl_->source->resident_bytes();
+    }
+}
+
 } // namespace sprawn
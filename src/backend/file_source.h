@@ -14,6 +14,9 @@ public:
 
     std::span<const std::byte> data() const override;
 
+    size_t mapped_bytes() const { return file_.size(); }
+    size_t resident_bytes() const { return file_.resident_bytes(); }
+
 private:
     MappedFile file_;
 };
@@ -85,4 +85,17 @@ size_t LineIndex::to_offset(size_t line, size_t col) const {
     return line_starts_[line] + col;
 }
 
+LineIndex::Position LineIndex::to_position(size_t offset) const {
+    if (offset > total_length_) {
+        throw std::out_of_range("offset out of range");
+    }
+    auto it = std::upper_bound(line_starts_.begin(), line_starts_.end(), offset) - 1;
+    return {static_cast<size_t>(it - line_starts_.begin()), offset - *it};
+}
+
+size_t LineIndex::memory_usage() const {
+    return line_starts_.capacity() * sizeof(size_t)
+         + cr_before_lf_.capacity() * sizeof(char);
+}
+
 } // namespace sprawn
@@ -27,6 +27,16 @@ public:
     // Convert (line, col) to absolute byte offset
     size_t to_offset(size_t line, size_t col) const;
 
+    // Line containing byte `offset` and the offset's column in it.
+    struct Position {
+        size_t line;
+        size_t col;
+    };
+    Position to_position(size_t offset) const;
+
+    // Heap bytes held by the index vectors.
+    size_t memory_usage() const;
+
 private:
     // line_starts_[i] is the byte offset where line i begins
     std::vector<size_t> line_starts_;
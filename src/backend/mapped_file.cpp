@@ -2,6 +2,7 @@
 
 #include <stdexcept>
 #include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -121,6 +122,29 @@ std::span<const std::byte> MappedFile::data() const {
     return {data_, size_};
 }
 
+size_t MappedFile::resident_bytes() const {
+    if (!data_ || size_ == 0) return 0;
+#ifdef _WIN32
+    return 0;
+#else
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t pages = (size_ + page - 1) / page;
+#ifdef __APPLE__
+    std::vector<char> vec(pages);
+#else
+    std::vector<unsigned char> vec(pages);
+#endif
+    if (::mincore(data_, size_, vec.data()) != 0) return 0;
+
+    size_t resident = 0;
+    for (size_t i = 0; i < pages; ++i) {
+        if (vec[i] & 1)
+            resident += (i + 1 == pages) ? size_ - i * page : page;
+    }
+    return resident;
+#endif
+}
+
 void MappedFile::close() {
 #ifdef _WIN32
     if (data_) {
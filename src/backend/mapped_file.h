@@ -20,6 +20,10 @@ public:
 
     std::span<const std::byte> data() const;
     size_t size() const { return size_; }
+
+    // Bytes of the mapping currently resident in physical memory.
+    // Returns 0 where the platform offers no cheap way to ask.
+    size_t resident_bytes() const;
 #ifdef _WIN32
     bool is_open() const { return file_handle_ != nullptr; }
 #else
@@ -0,0 +1,59 @@
+#include <sprawn/memory_report.h>
+
+#include <cstdio>
+
+namespace sprawn {
+
+namespace {
+
+void append_json_string(std::string& out, std::string_view s) {
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x",
+                                  static_cast<unsigned>(c));
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+void MemoryReport::add(std::string name, size_t bytes) {
+    entries.push_back({std::move(name), bytes});
+}
+
+size_t MemoryReport::heap_total() const {
+    size_t total = 0;
+    for (const auto& e : entries)
+        total += e.bytes;
+    return total;
+}
+
+std::string MemoryReport::to_json() const {
+    std::string out = "{\"heap_bytes\":" + std::to_string(heap_total());
+    out += ",\"mapped_bytes\":" + std::to_string(mapped_bytes);
+    out += ",\"mapped_resident_bytes\":" + std::to_string(mapped_resident_bytes);
+    out += ",\"subsystems\":{";
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i > 0) out += ',';
+        append_json_string(out, entries[i].name);
+        out += ':';
+        out += std::to_string(entries[i].bytes);
+    }
+    out += "}}";
+    return out;
+}
+
+} // namespace sprawn
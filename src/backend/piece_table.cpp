@@ -124,12 +124,18 @@ std::string PieceTable::text() const {
 }
 
 std::string PieceTable::text(size_t pos, size_t count) const {
+    std::string result;
+    text(pos, count, result);
+    return result;
+}
+
+void PieceTable::text(size_t pos, size_t count, std::string& result) const {
+    result.clear();
     if (count > total_length_ || pos > total_length_ - count) {
         count = total_length_ > pos ? total_length_ - pos : 0;
     }
-    if (count == 0) return {};
+    if (count == 0) return;
 
-    std::string result;
     result.reserve(count);
 
     auto [pi, off] = find_piece(pos);
@@ -145,8 +151,6 @@ std::string PieceTable::text(size_t pos, size_t count) const {
         off = 0;
         ++pi;
     }
-
-    return result;
 }
 
 size_t PieceTable::length() const {
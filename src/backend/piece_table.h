@@ -27,11 +27,17 @@ public:
 
     std::string text() const;
     std::string text(size_t pos, size_t count) const;
+    // Same range into `out`, reusing its capacity.
+    void text(size_t pos, size_t count, std::string& out) const;
     size_t length() const;
 
     const std::vector<Piece>& pieces() const { return pieces_; }
     const char* buffer_data(Buffer buf) const;
 
+    // Heap bytes held by the add buffer and the piece list (capacity, not size).
+    size_t add_buffer_bytes() const { return add_buffer_.capacity(); }
+    size_t pieces_bytes() const { return pieces_.capacity() * sizeof(Piece); }
+
 private:
     struct PieceLocation {
         size_t piece_index;
@@ -0,0 +1,96 @@
+#include <sprawn/worker_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace sprawn {
+
+WorkerPool::WorkerPool(size_t threads) {
+    size_t workers = threads > 1 ? threads - 1 : 0;
+    threads_.reserve(workers);
+    for (size_t i = 0; i < workers; ++i)
+        threads_.emplace_back([this] { run_worker(); });
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+    if (threads_.empty()) {
+        task();
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+void WorkerPool::run_worker() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;  // stopping
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        task();
+    }
+}
+
+void WorkerPool::parallel_for(size_t n, const std::function<void(size_t)>& fn) {
+    if (n == 0) return;
+
+    // Indices are claimed one at a time, so uneven items balance out. The
+    // caller waits for items, not helpers: a helper that starts after all
+    // items were claimed returns without touching `fn`, so a busy pool or a
+    // call from inside a task cannot stall it.
+    struct Shared {
+        std::atomic<size_t>     next{0};
+        std::mutex              mutex;
+        std::condition_variable done;
+        size_t                  finished{0};
+        std::exception_ptr      error;
+    };
+    auto shared = std::make_shared<Shared>();
+    auto drain = [&fn, n](Shared& s) {
+        for (size_t i; (i = s.next.fetch_add(1)) < n;) {
+            std::exception_ptr error;
+            try {
+                fn(i);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard lock(s.mutex);
+            if (error && !s.error) s.error = error;
+            if (++s.finished == n) s.done.notify_one();
+        }
+    };
+
+    size_t helpers = std::min(threads_.size(), n - 1);
+    for (size_t h = 0; h < helpers; ++h)
+        submit([shared, drain] { drain(*shared); });
+    drain(*shared);
+
+    std::unique_lock lock(shared->mutex);
+    shared->done.wait(lock, [&] { return shared->finished == n; });
+    if (shared->error) std::rethrow_exception(shared->error);
+}
+
+WorkerPool& WorkerPool::shared() {
+    static WorkerPool pool;
+    return pool;
+}
+
+} // namespace sprawn
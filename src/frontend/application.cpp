@@ -5,10 +5,12 @@
 #include <sprawn/document.h>
 #include <sprawn/middleware/controller.h>
 #include <sprawn/middleware/syntax_highlighter.h>
+#include <sprawn/worker_pool.h>
 
 #include "font_chain.h"
 #include "glyph_atlas.h"
 
+#include <chrono>
 #include <cstdio>
 #include <stdexcept>
 #include <string>
@@ -18,6 +20,9 @@ namespace sprawn {
 bool run_application(std::string_view filepath) {
     Document doc;
     Controller controller(doc);
+    controller.set_worker_pool(&WorkerPool::shared());
+    // Half a 60 Hz frame per source; slower ones fall back to their last spans.
+    controller.set_decoration_budget(std::chrono::milliseconds(8));
     if (!filepath.empty()) {
         try {
             controller.open_file(std::string(filepath));
@@ -29,6 +34,7 @@ bool run_application(std::string_view filepath) {
         }
         auto highlighter = std::make_shared<SyntaxHighlighter>(controller);
         highlighter->detect_language(std::string(filepath));
+        highlighter->set_worker_pool(&WorkerPool::shared());
         controller.add_decoration_source(highlighter);
     } else {
         controller.insert(0, 0, "");
@@ -44,7 +50,7 @@ bool run_application(std::string_view filepath) {
 
         // Set render scale for HiDPI
         float scale = window.dpi_scale();
-        SDL_RenderSetScale(renderer.raw(), scale, scale);
+        renderer.set_scale(scale);
 
         auto font_path = find_system_mono_font();
         if (font_path.empty()) {
@@ -63,24 +69,40 @@ bool run_application(std::string_view filepath) {
 
         GlyphAtlas atlas(renderer, fonts);
         Editor editor(controller, renderer, fonts, atlas, kInitW, kInitH, scale);
+        editor.set_worker_pool(&WorkerPool::shared());
 
+        // Frames are drawn only when something changed. With nothing to
+        // draw the loop blocks for input: briefly while background work is
+        // pending (its results arrive without an event), otherwise for up to
+        // kIdleWaitMs.
+        constexpr int kBusyWaitMs = 4;
+        constexpr int kIdleWaitMs = 500;
         bool running = true;
+        bool busy    = true;
         while (running) {
-            running = window.poll_events([&](const SDL_Event& ev) {
+            int wait_ms = editor.needs_redraw() ? 0 : busy ? kBusyWaitMs : kIdleWaitMs;
+            running = window.wait_events(wait_ms, [&](const SDL_Event& ev) {
                 if (ev.type == SDL_WINDOWEVENT &&
                     ev.window.event == SDL_WINDOWEVENT_RESIZED)
                 {
                     float new_scale = window.dpi_scale();
                     if (new_scale != scale) {
                         scale = new_scale;
-                        SDL_RenderSetScale(renderer.raw(), scale, scale);
+                        renderer.set_scale(scale);
                         editor.on_dpi_change(scale);
                     }
                 }
                 editor.handle_event(ev);
             });
-            editor.render();
-            window.present();
+            if (!running) break;
+            if (editor.needs_redraw()) {
+                editor.render();
+                window.present();
+            }
+
+            // Spend a slice of each iteration on background work (e.g. the
+            // highlighter scanning ahead to confirm block-comment state).
+            busy = controller.on_idle(std::chrono::milliseconds(4)) || editor.busy();
         }
     } catch (const std::exception& e) {
         std::fprintf(stderr, "sprawn: fatal error: %s\n", e.what());
@@ -90,4 +112,30 @@ bool run_application(std::string_view filepath) {
     return true;
 }
 
+bool print_memory_report(std::string_view filepath) {
+    Document doc;
+    Controller controller(doc);
+    try {
+        controller.open_file(std::string(filepath));
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "sprawn: cannot open '%.*s': %s\n",
+                     static_cast<int>(filepath.size()), filepath.data(),
+                     e.what());
+        return false;
+    }
+    auto highlighter = std::make_shared<SyntaxHighlighter>(controller);
+    highlighter->detect_language(std::string(filepath));
+    highlighter->set_worker_pool(&WorkerPool::shared());
+    controller.add_decoration_source(highlighter);
+
+    // Run background work to completion so lazily built state reaches its
+    // worst case before measuring.
+    while (controller.on_idle(std::chrono::seconds(1))) {}
+    if (size_t lc = controller.line_count(); lc > 0)
+        controller.decorations(lc - 1);
+
+    std::printf("%s\n", controller.memory_report().to_json().c_str());
+    return true;
+}
+
 } // namespace sprawn
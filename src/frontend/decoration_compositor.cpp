@@ -9,12 +9,22 @@ std::vector<StyledSpan> DecorationCompositor::flatten(
     const LineDecoration& deco, int line_byte_len,
     const TextStyle& default_style)
 {
+    std::vector<StyledSpan> result;
+    flatten(deco.spans, line_byte_len, result, default_style);
+    return result;
+}
+
+void DecorationCompositor::flatten(
+    std::span<const StyledSpan> spans, int line_byte_len,
+    std::vector<StyledSpan>& result, const TextStyle& default_style)
+{
+    result.clear();
     if (line_byte_len <= 0)
-        return {};
+        return;
 
     // Collect valid spans (clamped to line bounds, non-zero length)
     std::vector<const StyledSpan*> valid;
-    for (const auto& span : deco.spans) {
+    for (const auto& span : spans) {
         int s = std::max(span.byte_start, 0);
         int e = std::min(span.byte_end, line_byte_len);
         if (s < e)
@@ -28,7 +38,8 @@ std::vector<StyledSpan> DecorationCompositor::flatten(
         ds.byte_end = line_byte_len;
         ds.style = default_style;
         ds.priority = 0;
-        return {ds};
+        result.push_back(ds);
+        return;
     }
 
     // Collect boundary points
@@ -48,7 +59,6 @@ std::vector<StyledSpan> DecorationCompositor::flatten(
                      boundaries.end());
 
     // Build output spans for each sub-interval
-    std::vector<StyledSpan> result;
     result.reserve(boundaries.size() - 1);
 
     for (size_t i = 0; i + 1 < boundaries.size(); ++i) {
@@ -107,8 +117,6 @@ std::vector<StyledSpan> DecorationCompositor::flatten(
         out.priority = best_priority >= 0 ? best_priority : 0;
         result.push_back(out);
     }
-
-    return result;
 }
 
 } // namespace sprawn
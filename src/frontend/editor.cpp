@@ -1,29 +1,27 @@
 #include <sprawn/frontend/editor.h>
 #include <sprawn/decoration.h>
 #include <sprawn/frontend/decoration_compositor.h>
+#include <sprawn/worker_pool.h>
 #include "font_chain.h"
 #include "glyph_atlas.h"
+#include "shaper.h"
+#include "shaping_pool.h"
 
 #include <SDL2/SDL.h>
 #include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <deque>
 #include <string>
+#include <vector>
 
 namespace sprawn {
 
 namespace {
 
-// FNV-1a 64-bit hash
-uint64_t fnv1a(std::string_view s) {
-    uint64_t h = 14695981039346656037ULL;
-    for (unsigned char c : s) {
-        h ^= c;
-        h *= 1099511628211ULL;
-    }
-    return h;
-}
-
 // Count UTF-8 characters (codepoints) in s.
 size_t utf8_char_count(std::string_view s) {
     size_t n = 0;
@@ -58,10 +56,17 @@ size_t utf8_byte_count(std::string_view s, size_t char_start, size_t char_count)
     return end_byte - start_byte;
 }
 
-// Format a line number into a fixed-width right-aligned string.
-std::string format_line_number(size_t n, int width) {
+// Human-readable byte count for the stats overlay.
+std::string format_bytes(size_t bytes) {
     char buf[32];
-    std::snprintf(buf, sizeof(buf), "%*zu", width, n + 1);
+    if (bytes >= (size_t{1} << 30))
+        std::snprintf(buf, sizeof(buf), "%.2f GiB", bytes / double(size_t{1} << 30));
+    else if (bytes >= (size_t{1} << 20))
+        std::snprintf(buf, sizeof(buf), "%.2f MiB", bytes / double(size_t{1} << 20));
+    else if (bytes >= 1024)
+        std::snprintf(buf, sizeof(buf), "%.1f KiB", bytes / 1024.0);
+    else
+        std::snprintf(buf, sizeof(buf), "%zu B", bytes);
     return buf;
 }
 
@@ -81,11 +86,14 @@ Editor::Editor(Controller& ctrl, Renderer& renderer,
       layout_(atlas, fonts, dpi_scale),
       viewport_(width_px, height_px, layout_.line_height()),
       line_cache_(512),
+      tiles_(renderer),
       dpi_scale_(dpi_scale)
 {
     recompute_gutter();
 }
 
+Editor::~Editor() = default;
+
 void Editor::rebuild_fonts(int logical_size, float scale) {
     font_size_logical_ = logical_size;
     dpi_scale_ = scale;
@@ -93,9 +101,14 @@ void Editor::rebuild_fonts(int logical_size, float scale) {
     fonts_.rebuild(phys);
     atlas_.clear();
     layout_.reset(scale);
+    if (shaping_) shaping_->reset(fonts_.size_px(), scale);
+    prefetch_first_ = SIZE_MAX;
     viewport_.set_line_height(layout_.line_height());
+    // The visible lines are shaped again, in parallel, by the next render().
     line_cache_.clear();
+    ++layout_epoch_;
     recompute_gutter();
+    damaged_ = full_redraw_ = true;
 }
 
 void Editor::on_dpi_change(float new_scale) {
@@ -121,6 +134,17 @@ void Editor::handle_event(const SDL_Event& ev) {
         on_resize(ev.window.data1, ev.window.data2);
         return;
     }
+    if ((ev.type == SDL_WINDOWEVENT && ev.window.event == SDL_WINDOWEVENT_EXPOSED) ||
+        ev.type == SDL_RENDER_TARGETS_RESET || ev.type == SDL_RENDER_DEVICE_RESET)
+    {
+        // The window or the retained canvas lost its pixels.
+        if (ev.type != SDL_WINDOWEVENT) {
+            renderer_.invalidate();
+            tiles_.clear();
+        }
+        damaged_ = full_redraw_ = true;
+        return;
+    }
 
     auto cmd = input_.translate(ev);
     if (cmd) apply_command(*cmd);
@@ -128,6 +152,28 @@ void Editor::handle_event(const SDL_Event& ev) {
 
 void Editor::on_resize(int w, int h) {
     viewport_.resize(w, h);
+    damaged_ = full_redraw_ = true;
+}
+
+MemoryReport Editor::memory_report() const {
+    MemoryReport report = ctrl_.memory_report();
+    report.add("frontend.line_cache", line_cache_.memory_usage());
+    report.add("frontend.line_tiles", tiles_.memory_usage());
+    size_t deco = deco_buf_.memory_usage() + line_spans_.capacity() * sizeof(StyledSpan)
+                + composed_.bucket_count() * sizeof(void*);
+    for (const auto& t : frame_text_) deco += sizeof(std::string) + t.capacity();
+    for (const auto& [L, c] : composed_)
+        deco += sizeof(L) + sizeof(ComposedLine) + 2 * sizeof(void*)
+              + c.flat.capacity() * sizeof(StyledSpan);
+    report.add("frontend.decorations", deco);
+    if (filter_) report.add("frontend.line_filter", filter_->memory_usage());
+    report.add("frontend.shape_cache", layout_.shaper().memory_usage());
+    if (shaping_) report.add("frontend.shaping_pool", shaping_->memory_usage());
+    report.add("frontend.font_coverage", fonts_.coverage_bytes());
+    report.add("frontend.glyph_atlas.index", atlas_.index_bytes());
+    report.add("frontend.glyph_atlas.alpha", atlas_.alpha_bytes());
+    report.add("frontend.glyph_atlas.texture", atlas_.texture_bytes());
+    return report;
 }
 
 // ---------------------------------------------------------------------------
@@ -148,6 +194,22 @@ std::pair<CursorPos, CursorPos> Editor::selection_range() const {
     return {c, a};
 }
 
+bool Editor::selects_line(size_t L) const {
+    if (!has_selection()) return false;
+    auto [start, end] = selection_range();
+    return L >= start.line && L <= end.line;
+}
+
+std::pair<int, int> Editor::selection_bytes(size_t L, std::string_view utf8) const {
+    if (!selects_line(L)) return {-1, -1};
+    auto [start, end] = selection_range();
+    int b0 = L == start.line ? static_cast<int>(utf8_byte_offset(utf8, start.col)) : 0;
+    int b1 = L == end.line   ? static_cast<int>(utf8_byte_offset(utf8, end.col))
+                             : static_cast<int>(utf8.size());
+    if (b1 <= b0) return {-1, -1};
+    return {b0, b1};
+}
+
 std::string Editor::selected_text() const {
     if (!has_selection()) return {};
     auto [start, end] = selection_range();
@@ -186,7 +248,6 @@ void Editor::delete_selection() {
         size_t byte_col = utf8_byte_offset(line_text, start.col);
         size_t byte_count = utf8_byte_count(line_text, start.col, end.col - start.col);
         ctrl_.erase(start.line, byte_col, byte_count);
-        line_cache_.invalidate(start.line);
     } else {
         // Count total bytes to erase (including newlines)
         std::string first_line = ctrl_.line(start.line);
@@ -199,14 +260,32 @@ void Editor::delete_selection() {
         count += utf8_byte_offset(ctrl_.line(end.line), end.col);
 
         ctrl_.erase(start.line, byte_col, count);
-        line_cache_.invalidate(start.line);
-        line_cache_.invalidate_range(start.line + 1, removed_lines,
-                                     -static_cast<int>(removed_lines));
     }
 
     cursor_ = start;
     anchor_.active = false;
-    viewport_.ensure_line_visible(cursor_.line, ctrl_.line_count());
+    scroll_to_cursor();
+}
+
+// ---------------------------------------------------------------------------
+// Filtered view
+// ---------------------------------------------------------------------------
+
+size_t Editor::view_line_count() const {
+    return filter_ ? filter_->size() : ctrl_.line_count();
+}
+
+size_t Editor::to_doc_line(size_t view_line) const {
+    return filter_ ? filter_->doc_line(view_line) : view_line;
+}
+
+size_t Editor::to_view_line(size_t doc_line) const {
+    return filter_ ? filter_->view_line(doc_line) : doc_line;
+}
+
+void Editor::scroll_to_cursor() {
+    if (filter_) filter_->sync();
+    viewport_.ensure_line_visible(to_view_line(cursor_.line), view_line_count());
 }
 
 // ---------------------------------------------------------------------------
@@ -214,6 +293,11 @@ void Editor::delete_selection() {
 // ---------------------------------------------------------------------------
 
 void Editor::apply_command(const EditorCommand& cmd) {
+    // Whatever edits one command makes (e.g. replacing the selection with
+    // typed text) are published as one batch.
+    damaged_ = true;
+    ctrl_.begin_batch();
+    struct BatchGuard { Controller& c; ~BatchGuard() { c.end_batch(); } } batch{ctrl_};
     std::visit([this](const auto& c) {
         using T = std::decay_t<decltype(c)>;
 
@@ -229,15 +313,15 @@ void Editor::apply_command(const EditorCommand& cmd) {
 
         if constexpr (std::is_same_v<T, MoveCursor>) {
             handle_shift(c.shift);
-            size_t total = ctrl_.line_count();
+            size_t total = view_line_count();
             if (total == 0) return;
 
             if (c.dy != 0) {
-                long long new_line = static_cast<long long>(cursor_.line) + c.dy;
+                long long new_line = static_cast<long long>(to_view_line(cursor_.line)) + c.dy;
                 if (new_line < 0) new_line = 0;
                 if (new_line >= static_cast<long long>(total))
                     new_line = static_cast<long long>(total) - 1;
-                cursor_.line = static_cast<size_t>(new_line);
+                cursor_.line = to_doc_line(static_cast<size_t>(new_line));
             }
 
             if (c.dx != 0) {
@@ -249,7 +333,7 @@ void Editor::apply_command(const EditorCommand& cmd) {
                 cursor_.col = static_cast<size_t>(new_col);
             }
 
-            viewport_.ensure_line_visible(cursor_.line, ctrl_.line_count());
+            scroll_to_cursor();
 
         } else if constexpr (std::is_same_v<T, MoveHome>) {
             handle_shift(c.shift);
@@ -261,41 +345,46 @@ void Editor::apply_command(const EditorCommand& cmd) {
 
         } else if constexpr (std::is_same_v<T, MovePgUp>) {
             handle_shift(c.shift);
+            if (view_line_count() == 0) return;
             size_t vl = viewport_.visible_lines();
-            cursor_.line = cursor_.line > vl ? cursor_.line - vl : 0;
-            viewport_.ensure_line_visible(cursor_.line, ctrl_.line_count());
+            size_t v  = to_view_line(cursor_.line);
+            cursor_.line = to_doc_line(v > vl ? v - vl : 0);
+            scroll_to_cursor();
 
         } else if constexpr (std::is_same_v<T, MovePgDn>) {
             handle_shift(c.shift);
             size_t vl    = viewport_.visible_lines();
-            size_t total = ctrl_.line_count();
-            cursor_.line = std::min(cursor_.line + vl, total > 0 ? total - 1 : 0);
-            viewport_.ensure_line_visible(cursor_.line, ctrl_.line_count());
+            size_t total = view_line_count();
+            if (total == 0) return;
+            cursor_.line = to_doc_line(std::min(to_view_line(cursor_.line) + vl, total - 1));
+            scroll_to_cursor();
 
         } else if constexpr (std::is_same_v<T, ScrollLines>) {
-            viewport_.scroll_by(0.0f, c.dy, ctrl_.line_count());
+            viewport_.scroll_by(0.0f, c.dy, view_line_count());
 
         } else if constexpr (std::is_same_v<T, ClickPosition>) {
             // Determine clicked line
-            size_t clicked_line = viewport_.y_to_line(c.y_px);
-            size_t total = ctrl_.line_count();
-            if (total > 0 && clicked_line >= total)
-                clicked_line = total - 1;
+            size_t clicked_view = viewport_.y_to_line(c.y_px);
+            size_t total = view_line_count();
+            if (total == 0) return;
+            if (clicked_view >= total)
+                clicked_view = total - 1;
+            size_t clicked_line = to_doc_line(clicked_view);
 
             // Determine column from x
             int text_x = c.x_px - gutter_width_ + viewport_.scroll_x_px();
             if (text_x < 0) text_x = 0;
 
             std::string utf8 = ctrl_.line(clicked_line);
-            uint64_t h = fnv1a(utf8);
-            const GlyphRun* cached = line_cache_.get(clicked_line, h);
+            uint64_t version = ctrl_.line_version(clicked_line);
+            const GlyphRun* cached = line_cache_.get(version);
             size_t col;
             if (cached) {
                 col = layout_.column_for_x(*cached, utf8, text_x);
             } else {
                 GlyphRun run = layout_.shape_line(utf8);
                 col = layout_.column_for_x(run, utf8, text_x);
-                line_cache_.put(clicked_line, h, std::move(run));
+                line_cache_.put(version, std::move(run));
             }
 
             if (c.shift) {
@@ -313,7 +402,6 @@ void Editor::apply_command(const EditorCommand& cmd) {
             size_t byte_col = utf8_byte_offset(line_text, cursor_.col);
             ctrl_.insert(cursor_.line, byte_col, c.text);
             cursor_.col += utf8_char_count(c.text);
-            line_cache_.invalidate(cursor_.line);
 
         } else if constexpr (std::is_same_v<T, DeleteBackward>) {
             if (has_selection()) {
@@ -326,17 +414,15 @@ void Editor::apply_command(const EditorCommand& cmd) {
                 size_t byte_count = utf8_byte_count(line_text, cursor_.col - 1, 1);
                 ctrl_.erase(cursor_.line, byte_col, byte_count);
                 --cursor_.col;
-                line_cache_.invalidate(cursor_.line);
             } else if (cursor_.line > 0) {
                 std::string prev_line = ctrl_.line(cursor_.line - 1);
                 size_t prev_len = utf8_char_count(prev_line);
                 size_t prev_byte_len = prev_line.size();
                 ctrl_.erase(cursor_.line - 1, prev_byte_len, 1);
-                line_cache_.invalidate_range(cursor_.line - 1, 1, -1);
                 --cursor_.line;
                 cursor_.col = prev_len;
                 recompute_gutter();
-                viewport_.ensure_line_visible(cursor_.line, ctrl_.line_count());
+                scroll_to_cursor();
             }
 
         } else if constexpr (std::is_same_v<T, DeleteForward>) {
@@ -350,11 +436,9 @@ void Editor::apply_command(const EditorCommand& cmd) {
                 size_t byte_col = utf8_byte_offset(line_text_del, cursor_.col);
                 size_t byte_count = utf8_byte_count(line_text_del, cursor_.col, 1);
                 ctrl_.erase(cursor_.line, byte_col, byte_count);
-                line_cache_.invalidate(cursor_.line);
             } else {
                 // Merge with next line (delete the newline)
                 ctrl_.erase(cursor_.line, line_text_del.size(), 1);
-                line_cache_.invalidate_range(cursor_.line, 1, -1);
                 recompute_gutter();
             }
 
@@ -365,12 +449,10 @@ void Editor::apply_command(const EditorCommand& cmd) {
                 size_t byte_col = utf8_byte_offset(nl_line, cursor_.col);
                 ctrl_.insert(cursor_.line, byte_col, "\n");
             }
-            line_cache_.invalidate_range(cursor_.line, 0, 1);
-            line_cache_.invalidate(cursor_.line + 1);
             ++cursor_.line;
             cursor_.col = 0;
             recompute_gutter();
-            viewport_.ensure_line_visible(cursor_.line, ctrl_.line_count());
+            scroll_to_cursor();
 
         } else if constexpr (std::is_same_v<T, Copy>) {
             std::string text = has_selection() ? selected_text()
@@ -389,7 +471,6 @@ void Editor::apply_command(const EditorCommand& cmd) {
                 if (!s.empty()) {
                     ctrl_.erase(cursor_.line, 0, s.size());
                     cursor_.col = 0;
-                    line_cache_.invalidate(cursor_.line);
                 }
             }
 
@@ -413,19 +494,14 @@ void Editor::apply_command(const EditorCommand& cmd) {
                 }
                 if (newlines == 0) {
                     cursor_.col += utf8_char_count(text);
-                    line_cache_.invalidate(cursor_.line);
                 } else {
                     size_t chars_after = utf8_char_count(
                         std::string_view(text).substr(last_nl + 1));
-                    line_cache_.invalidate_range(cursor_.line, 0,
-                                                  static_cast<int>(newlines));
-                    line_cache_.invalidate(cursor_.line);
                     cursor_.line += newlines;
                     cursor_.col   = chars_after;
-                    line_cache_.invalidate(cursor_.line);
                     recompute_gutter();
                 }
-                viewport_.ensure_line_visible(cursor_.line, ctrl_.line_count());
+                scroll_to_cursor();
             }
 
         } else if constexpr (std::is_same_v<T, SelectAll>) {
@@ -435,12 +511,52 @@ void Editor::apply_command(const EditorCommand& cmd) {
             cursor_.line = total - 1;
             cursor_.col  = utf8_char_count(ctrl_.line(cursor_.line));
 
+        } else if constexpr (std::is_same_v<T, FilterLines>) {
+            // The selection's first line, else the word under the cursor.
+            std::string pattern;
+            if (has_selection()) {
+                pattern = selected_text();
+                pattern.resize(std::min(pattern.find('\n'), pattern.size()));
+            } else {
+                std::string text = ctrl_.line(cursor_.line);
+                size_t at = utf8_byte_offset(text, cursor_.col);
+                auto word = [&](size_t i) {
+                    unsigned char b = static_cast<unsigned char>(text[i]);
+                    return std::isalnum(b) || b == '_' || b >= 0x80;
+                };
+                size_t b = at, e = at;
+                while (b > 0 && word(b - 1)) --b;
+                while (e < text.size() && word(e)) ++e;
+                pattern = text.substr(b, e - b);
+            }
+            if (pattern.empty()) return;
+            auto filter = std::make_unique<LineFilter>(ctrl_, std::move(pattern), pool_);
+            if (filter->empty()) return;  // keep the current view
+            filter_ = std::move(filter);
+            anchor_.active = false;
+            cursor_.line = to_doc_line(to_view_line(cursor_.line));
+            cursor_.col  = 0;
+            scroll_to_cursor();
+
+        } else if constexpr (std::is_same_v<T, ClearFilter>) {
+            if (!filter_) return;
+            filter_.reset();
+            scroll_to_cursor();
+
         } else if constexpr (std::is_same_v<T, ZoomFont>) {
             int new_size = font_size_logical_ + c.delta * 2;
             new_size = std::clamp(new_size, 8, 72);
             if (new_size != font_size_logical_)
                 rebuild_fonts(new_size, dpi_scale_);
 
+        } else if constexpr (std::is_same_v<T, ToggleStatsOverlay>) {
+            show_stats_ = !show_stats_;
+            stats_refreshed_ = {};
+
+        } else if constexpr (std::is_same_v<T, DumpMemoryReport>) {
+            std::printf("%s\n", memory_report().to_json().c_str());
+            std::fflush(stdout);
+
         } else if constexpr (std::is_same_v<T, Quit>) {
             SDL_Event quit{};
             quit.type = SDL_QUIT;
@@ -454,108 +570,373 @@ void Editor::apply_command(const EditorCommand& cmd) {
 // Rendering
 // ---------------------------------------------------------------------------
 
+void Editor::set_worker_pool(WorkerPool* pool) {
+    pool_ = pool;
+    atlas_.set_worker_pool(pool);
+    // Without workers, shaping ahead would only move the work onto the
+    // UI thread sooner.
+    shaping_.reset();
+    prefetch_first_ = SIZE_MAX;
+    if (pool && pool->concurrency() > 1)
+        shaping_ = std::make_unique<ShapingPool>(*pool, atlas_, fonts_.paths(),
+                                                 fonts_.size_px(), dpi_scale_);
+}
+
+bool Editor::busy() const {
+    return atlas_.pending() || (shaping_ && shaping_->busy());
+}
+
+int Editor::shape_limit(size_t doc_line) const {
+    if (doc_line == cursor_.line) return 0;
+    // Visible width plus a margin.
+    return viewport_.width_px() - gutter_width_ + viewport_.scroll_x_px() + 200;
+}
+
+const GlyphRun* Editor::cached_run(size_t doc_line, uint64_t version) {
+    const GlyphRun* run = line_cache_.get(version);
+    if (!run || !run->truncated) return run;
+    int limit = shape_limit(doc_line);
+    return limit == 0 || limit > run->max_width_px ? nullptr : run;
+}
+
+void Editor::prefetch_lines(size_t first, size_t rows) {
+    if (!shaping_ || first == prefetch_first_) return;
+    bool down = prefetch_first_ == SIZE_MAX || first > prefetch_first_;
+    prefetch_first_ = first;
+
+    size_t shown = view_line_count();
+    size_t from  = down ? std::min(first + rows, shown) : (first > rows ? first - rows : 0);
+    size_t to    = down ? std::min(first + 2 * rows, shown) : first;
+    std::vector<ShapingPool::Job> jobs;
+    jobs.reserve(to - from);
+    // Nearest the viewport first.
+    for (size_t k = 0; k < to - from; ++k) {
+        size_t   L       = to_doc_line(down ? from + k : to - 1 - k);
+        uint64_t version = ctrl_.line_version(L);
+        if (cached_run(L, version)) continue;
+        jobs.push_back({version, ctrl_.line(L), shape_limit(L)});
+    }
+    // Replaces the previous page's jobs still waiting.
+    shaping_->prefetch(std::move(jobs));
+}
+
+bool Editor::needs_redraw() {
+    // Glyphs rasterized in the background are packed here, before drawing.
+    if (atlas_.collect()) damaged_ = true;
+    // Lines shaped ahead of the viewport wait in the line cache; they are
+    // off screen, so nothing is damaged. A run whose line was edited
+    // meanwhile is keyed by a version no line has any more and ages out.
+    if (shaping_) {
+        std::vector<ShapingPool::Job> landed;
+        shaping_->take(landed);
+        for (ShapingPool::Job& j : landed) {
+            if (!j.shaped) continue;
+            // Kept unless it is cut shorter than what is cached already.
+            const GlyphRun* have = line_cache_.get(j.version);
+            if (!have || (have->truncated && (!j.run.truncated ||
+                                              j.run.max_width_px > have->max_width_px)))
+                line_cache_.put(j.version, std::move(j.run));
+        }
+    }
+    // Drained every iteration, not only when drawing, so that budget
+    // backoffs keep counting down while nothing else happens.
+    LineRange changed = ctrl_.poll_decoration_changes();
+    if (!changed.empty() && !frame_lines_.empty() &&
+        changed.first <= frame_lines_.back() && changed.last > frame_lines_.front())
+        damaged_ = true;
+    if (ctrl_.document_version() != drawn_version_) damaged_ = true;
+    if (show_stats_ && std::chrono::steady_clock::now() - stats_refreshed_ >= std::chrono::seconds(1))
+        damaged_ = true;
+    return damaged_;
+}
+
 void Editor::render() {
-    renderer_.begin_frame(Color{30, 30, 30, 255});
+    atlas_.begin_frame();
+    damaged_       = false;
+    drawn_version_ = ctrl_.document_version();
+    const Color bg{30, 30, 30, 255};
 
+    if (filter_) filter_->sync();
     size_t total = ctrl_.line_count();
-    if (total == 0) {
+    size_t shown = view_line_count();
+    if (shown == 0) {
+        renderer_.begin_frame(bg);
         renderer_.end_frame();
+        frame_lines_.clear();
+        drawn_rows_.clear();
         return;
     }
 
+    // Viewport positions are view lines; frame_lines_ maps the visible ones
+    // to document lines.
     int lh     = layout_.line_height();
     size_t first = viewport_.first_line();
-    size_t last  = viewport_.last_line(total);
-
-    // Pre-compute selection range (avoid repeated calls inside the loop)
-    bool     sel = has_selection();
-    CursorPos sel_start{}, sel_end{};
-    if (sel) {
-        auto [s, e] = selection_range();
-        sel_start = s;
-        sel_end   = e;
-    }
-
-    // Text clip region (exclude gutter)
-    SDL_Rect text_clip{gutter_width_, 0, 32767, 32767};
-    renderer_.set_clip(text_clip);
-
-    for (size_t L = first; L < last; ++L) {
-        int y      = viewport_.line_to_y(L);
-        int text_x = gutter_width_ - viewport_.scroll_x_px();
-
-        // Shape the line (from cache or fresh)
-        std::string utf8 = ctrl_.line(L);
-        uint64_t    h    = fnv1a(utf8);
-        const GlyphRun* run_ptr = line_cache_.get(L, h);
-        GlyphRun tmp_run;
-        if (!run_ptr) {
-            // Lazy shaping: only shape up to visible width + margin
-            int shape_limit = viewport_.width_px() - gutter_width_
-                            + viewport_.scroll_x_px() + 200;
-            tmp_run = layout_.shape_line(utf8, shape_limit);
-
-            // If cursor is on this truncated line, re-shape fully
-            if (tmp_run.truncated && L == cursor_.line) {
-                tmp_run = layout_.shape_line(utf8);
-            }
-
-            line_cache_.put(L, h, tmp_run);
-            run_ptr = line_cache_.get(L, h);
-            if (!run_ptr) run_ptr = &tmp_run;
+    size_t last  = viewport_.last_line(shown);
+
+    // Only runs of visible lines whose text, selection or decoration
+    // generation moved are queried and flattened again; the rest reuse
+    // last frame's spans. Generations were bumped by needs_redraw().
+    size_t n = last - first;
+    if (frame_text_.size() < n) frame_text_.resize(n);
+    frame_text_read_.assign(n, 0);
+    frame_lines_.resize(n);
+    for (size_t i = 0; i < n; ++i) frame_lines_[i] = to_doc_line(first + i);
+    // Rows whose stamps all match are never read.
+    auto text = [&](size_t i) -> const std::string& {
+        if (!frame_text_read_[i]) {
+            ctrl_.line(frame_lines_[i], frame_text_[i]);
+            frame_text_read_[i] = 1;
         }
-
-        // Fetch decorations and inject selection as a high-priority bg span
-        LineDecoration deco = ctrl_.decorations(L);
-        if (sel && L >= sel_start.line && L <= sel_end.line) {
-            int b0, b1;
-            if (sel_start.line == sel_end.line) {
-                b0 = static_cast<int>(utf8_byte_offset(utf8, sel_start.col));
-                b1 = static_cast<int>(utf8_byte_offset(utf8, sel_end.col));
-            } else if (L == sel_start.line) {
-                b0 = static_cast<int>(utf8_byte_offset(utf8, sel_start.col));
-                b1 = static_cast<int>(utf8.size());
-            } else if (L == sel_end.line) {
-                b0 = 0;
-                b1 = static_cast<int>(utf8_byte_offset(utf8, sel_end.col));
-            } else {
-                b0 = 0;
-                b1 = static_cast<int>(utf8.size());
-            }
-            if (b1 > b0) {
+        return frame_text_[i];
+    };
+    size_t stale_from = n;
+    auto composite = [&](size_t end) {
+        if (stale_from >= end) return;
+        ctrl_.decorations(frame_lines_[stale_from], frame_lines_[end - 1] + 1, deco_buf_);
+        for (size_t i = stale_from; i < end; ++i) {
+            size_t L = frame_lines_[i];
+            const std::string& utf8 = text(i);
+            ComposedLine& c = composed_[L];
+            auto line_spans = deco_buf_.line(L);
+            line_spans_.assign(line_spans.begin(), line_spans.end());
+            // The selection as a high-priority bg span
+            if (c.selection.first >= 0) {
                 StyledSpan sel_span;
-                sel_span.byte_start = b0;
-                sel_span.byte_end   = b1;
+                sel_span.byte_start = c.selection.first;
+                sel_span.byte_end   = c.selection.second;
                 sel_span.style.bg   = Color{65, 120, 200, 160};
                 sel_span.priority    = 1000;
-                deco.spans.push_back(sel_span);
+                line_spans_.push_back(sel_span);
             }
+            DecorationCompositor::flatten(line_spans_, static_cast<int>(utf8.size()), c.flat);
+        }
+        stale_from = n;
+    };
+    for (size_t i = 0; i < n; ++i) {
+        size_t L = frame_lines_[i];
+        // A range query covers consecutive document lines only.
+        if (stale_from < i && frame_lines_[i - 1] + 1 != L) composite(i);
+        uint64_t ver = ctrl_.line_version(L);
+        uint64_t gen = ctrl_.decoration_generation(L);
+        std::pair<int, int> sb{-1, -1};
+        if (selects_line(L)) sb = selection_bytes(L, text(i));
+        ComposedLine& c = composed_[L];
+        if (c.valid && c.version == ver && c.generation == gen && c.selection == sb) {
+            composite(i);
+            continue;
+        }
+        c = ComposedLine{true, ver, gen, sb, std::move(c.flat)};
+        if (stale_from == n) stale_from = i;
+    }
+    composite(n);
+    std::erase_if(composed_, [&](const auto& kv) {
+        return n == 0 || kv.first < frame_lines_.front() || kv.first > frame_lines_.back();
+    });
+
+    // Damage: a row is redrawn if what it shows differs from last frame;
+    // anything moving the rows themselves (scroll, resize, zoom, gutter
+    // width) or the overlay on top of them redraws everything.
+    int digits = 1;
+    for (size_t t = total > 0 ? total - 1 : 0; t >= 10; t /= 10) ++digits;
+    FrameKey frame{first, n, viewport_.scroll_x_px(), gutter_width_,
+                   viewport_.width_px(), lh, digits};
+    bool full = full_redraw_ || show_stats_ || frame != drawn_frame_ ||
+                drawn_rows_.size() != n || !renderer_.begin_partial_frame();
+    if (full) renderer_.begin_frame(bg);
+    full_redraw_ = false;
+    drawn_frame_ = frame;
+    drawn_rows_.resize(n);
+
+    int width  = viewport_.width_px();
+    int text_x = gutter_width_ - viewport_.scroll_x_px();
+    int tile_w = std::max(width - gutter_width_, 0);
+    int tile_pw = static_cast<int>(std::ceil(tile_w * dpi_scale_));
+    int tile_ph = static_cast<int>(std::ceil(lh * dpi_scale_));
+    // Shaped run of document line `L` (cached, or shaped now).
+    std::deque<GlyphRun> uncached_runs;
+    auto shaped = [&](size_t L, const std::string& utf8, uint64_t version) -> const GlyphRun& {
+        if (const GlyphRun* run = cached_run(L, version)) return *run;
+        GlyphRun run = layout_.shape_line(utf8, shape_limit(L));
+        line_cache_.put(version, run);
+        if (const GlyphRun* cached = line_cache_.get(version)) return *cached;
+        return uncached_runs.emplace_back(std::move(run));
+    };
+
+    auto draw_text = [&](size_t i) {
+        size_t L = frame_lines_[i];
+        int    y = viewport_.line_to_y(first + i);
+        const std::string& utf8 = text(i);
+        const ComposedLine& composed = composed_[L];
+        auto run = [&]() -> const GlyphRun& { return shaped(L, utf8, composed.version); };
+
+        // An unchanged row is one blit of its tile; a changed one is drawn
+        // into its tile first. Rows missing glyphs that are still being
+        // rasterized are drawn again once they land.
+        bool complete = true;
+        TileKey key{composed.version, composed.generation, composed.selection,
+                    tile_w, lh, viewport_.scroll_x_px(), layout_epoch_};
+        TextureHandle tile = tiles_.find(L, key);
+        if (!tile && (tile = tiles_.acquire(L, key, tile_pw, tile_ph))) {
+            renderer_.begin_target(tile, bg);
+            complete = layout_.draw_run(renderer_, run(), text_x - gutter_width_, 0, composed.flat, utf8);
+            renderer_.end_target();
+            if (!complete) tiles_.forget(L);
         }
-        auto flat = DecorationCompositor::flatten(deco, static_cast<int>(utf8.size()));
-        layout_.draw_run(renderer_, *run_ptr, text_x, y, flat, utf8);
+        if (tile)
+            renderer_.blit(tile, SDL_Rect{0, 0, tile_pw, tile_ph},
+                           SDL_Rect{gutter_width_, y, tile_w, lh}, Color{255, 255, 255, 255});
+        else
+            complete = layout_.draw_run(renderer_, run(), text_x, y, composed.flat, utf8);
+        if (!complete) drawn_rows_[i].line = SIZE_MAX;
 
         // Draw cursor if on this line
         if (L == cursor_.line)
-            render_cursor(y, *run_ptr, utf8);
+            render_cursor(y, run(), utf8);
+    };
+    // Original line numbers, also in a filtered view.
+    auto draw_gutter = [&](size_t i) {
+        int y = viewport_.line_to_y(first + i);
+        renderer_.fill_rect(Rect{0, y, gutter_width_, lh}, Color{40, 40, 40, 255});
+        if (!layout_.draw_number(renderer_, frame_lines_[i] + 1, gutter_width_ - kGutterPad, y,
+                                 Color{100, 110, 120, 255}))
+            drawn_rows_[i].line = SIZE_MAX;
+    };
+
+    redraw_rows_.assign(n, full);
+    for (size_t i = 0; i < n; ++i) {
+        size_t L = frame_lines_[i];
+        const ComposedLine& c = composed_[L];
+        RowKey key{L, c.version, c.generation, c.selection,
+                   L == cursor_.line ? cursor_.col : SIZE_MAX};
+        if (!full && drawn_rows_[i] == key) continue;
+        drawn_rows_[i]  = key;
+        redraw_rows_[i] = true;
     }
 
-    renderer_.clear_clip();
+    // Rows about to be drawn that are not shaped yet are shaped together
+    // on the shaping threads: every visible row after a zoom, the newly
+    // exposed ones after a scroll past what was prefetched.
+    if (shaping_) {
+        std::vector<ShapingPool::Job> jobs;
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t version = composed_[frame_lines_[i]].version;
+            if (redraw_rows_[i] && !cached_run(frame_lines_[i], version))
+                jobs.push_back({version, text(i), shape_limit(frame_lines_[i])});
+        }
+        if (jobs.size() > 1) {
+            shaping_->shape(jobs);
+            for (ShapingPool::Job& j : jobs)
+                if (j.shaped) line_cache_.put(j.version, std::move(j.run));
+        }
+    }
 
-    // Draw gutter (unclipped, on top of text/selection)
-    int digits = 1;
-    for (size_t n = total > 0 ? total - 1 : 0; n >= 10; n /= 10) ++digits;
+    // Ask for the glyphs of every row about to be drawn before drawing
+    // any, so the rasterizer threads work on all of them at once.
+    for (size_t i = 0; i < n; ++i) {
+        if (redraw_rows_[i])
+            layout_.prefetch(shaped(frame_lines_[i], text(i),
+                                    composed_[frame_lines_[i]].version));
+    }
+    // Whatever finished meanwhile (all of it without worker threads) is
+    // drawn this frame.
+    atlas_.collect();
+
+    for (size_t i = 0; i < n && !full; ++i) {
+        if (!redraw_rows_[i]) continue;
+        // Repaint the row band over the retained frame.
+        int y = viewport_.line_to_y(first + i);
+        renderer_.set_clip(SDL_Rect{gutter_width_, y, std::max(width - gutter_width_, 0), lh});
+        renderer_.fill_rect(Rect{gutter_width_, y, width - gutter_width_, lh}, bg);
+        draw_text(i);
+        renderer_.set_clip(SDL_Rect{0, y, gutter_width_, lh});
+        draw_gutter(i);
+    }
 
-    for (size_t L = first; L < last; ++L) {
-        int y = viewport_.line_to_y(L);
-        renderer_.fill_rect(Rect{0, y, gutter_width_, lh}, Color{40, 40, 40, 255});
+    if (full) {
+        // Text clip region (exclude gutter)
+        renderer_.set_clip(SDL_Rect{gutter_width_, 0, 32767, 32767});
+        for (size_t i = 0; i < n; ++i) draw_text(i);
+        renderer_.clear_clip();
+
+        // Draw gutter (unclipped, on top of text/selection)
+        for (size_t i = 0; i < n; ++i) draw_gutter(i);
 
-        std::string num_str = format_line_number(L, digits);
-        GlyphRun num_run = layout_.shape_line(num_str);
-        int gx = gutter_width_ - kGutterPad - num_run.total_width;
-        layout_.draw_run(renderer_, num_run, gx, y, Color{100, 110, 120, 255});
+        if (show_stats_)
+            render_stats_overlay();
+    } else {
+        renderer_.clear_clip();
     }
 
     renderer_.end_frame();
+    prefetch_lines(first, n);
+}
+
+void Editor::render_stats_overlay() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - stats_refreshed_ >= std::chrono::seconds(1)) {
+        stats_report_    = memory_report();
+        stats_refreshed_ = now;
+    }
+    const MemoryReport& report = stats_report_;
+
+    std::vector<std::string> rows;
+    rows.push_back("heap   " + format_bytes(report.heap_total()));
+    rows.push_back("mapped " + format_bytes(report.mapped_resident_bytes) +
+                   " / " + format_bytes(report.mapped_bytes) + " resident");
+    for (const auto& e : report.entries)
+        rows.push_back("  " + e.name + "  " + format_bytes(e.bytes));
+    // Decoration cost per source, from the last 256 range queries.
+    for (const auto& st : ctrl_.decoration_stats()) {
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "deco %s  p50 <%lldus  p99 <%lldus  max %lldus  skipped %llu",
+                      st.name.c_str(),
+                      static_cast<long long>(st.latency.percentile(50).count()),
+                      static_cast<long long>(st.latency.percentile(99).count()),
+                      static_cast<long long>(st.latency.max().count()),
+                      static_cast<unsigned long long>(st.skipped));
+        rows.push_back(buf);
+    }
+    // The previous frame: this one is still being drawn.
+    {
+        const Renderer::FrameStats& fs = renderer_.last_frame_stats();
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "frame  %.2fms  %d draw calls  %d quads",
+                      fs.cpu_ms, fs.draw_calls, fs.quads);
+        rows.push_back(buf);
+        std::snprintf(buf, sizeof(buf), "tiles  %zu hits  %zu misses",
+                      tiles_.hits(), tiles_.misses());
+        rows.push_back(buf);
+        AtlasStats as = atlas_.stats();
+        size_t lookups = as.hits + as.misses;
+        std::snprintf(buf, sizeof(buf), "atlas  %zu/%zu pages (%zu rgba)  %.0f%% full  %zu glyphs  hit %.1f%%  %zu evictions  %zu uploads",
+                      as.pages, as.max_pages, as.color_pages, as.occupancy * 100.0, as.glyphs,
+                      lookups ? 100.0 * as.hits / lookups : 100.0, as.evictions, as.uploads);
+        rows.push_back(buf);
+        ShapeStats ss = layout_.shaper().stats();
+        size_t words = ss.hits + ss.misses;
+        std::snprintf(buf, sizeof(buf), "shape  %zu words  hit %.1f%%  %zu uncached",
+                      ss.words, words ? 100.0 * ss.hits / words : 100.0, ss.direct);
+        rows.push_back(buf);
+    }
+
+    std::vector<GlyphRun> runs;
+    int max_w = 0;
+    for (const auto& r : rows) {
+        runs.push_back(layout_.shape_line(r));
+        max_w = std::max(max_w, static_cast<int>(runs.back().total_width / dpi_scale_));
+    }
+
+    int lh = layout_.line_height();
+    int w  = max_w + kGutterPad * 2;
+    int h  = static_cast<int>(rows.size()) * lh + kGutterPad * 2;
+    int x0 = viewport_.width_px() - w - kGutterPad;
+    int y0 = kGutterPad;
+    renderer_.fill_rect(Rect{x0, y0, w, h}, Color{20, 20, 20, 220});
+    for (size_t i = 0; i < runs.size(); ++i) {
+        layout_.draw_run(renderer_, runs[i], x0 + kGutterPad,
+                         y0 + kGutterPad + static_cast<int>(i) * lh,
+                         Color{200, 200, 120, 255});
+    }
 }
 
 void Editor::render_cursor(int y, const GlyphRun& run, std::string_view utf8) {
@@ -24,6 +24,7 @@ void FontChain::add_fallback(const std::filesystem::path& path) {
     try {
         fonts_.push_back(std::make_unique<FontFace>(library_, path, size_px_));
         paths_.push_back(path);
+        clear_coverage();
     } catch (const std::exception& e) {
         std::fprintf(stderr, "sprawn: skipping fallback font '%s': %s\n",
                      path.c_str(), e.what());
@@ -42,16 +43,61 @@ void FontChain::rebuild(int new_size_px) {
             fonts_.push_back(nullptr); // keep aligned with paths_
         }
     }
+    clear_coverage();
 }
 
-std::pair<uint8_t, uint32_t> FontChain::resolve(uint32_t codepoint) const {
+void FontChain::clear_coverage() {
+    std::lock_guard lock(coverage_mutex_);
+    if (bmp_ready_.load(std::memory_order_relaxed)) {
+        for (uint32_t i = 0; i < kBmpSize; ++i)
+            bmp_[i].store(kUnknown, std::memory_order_relaxed);
+    }
+    astral_.clear();
+}
+
+uint32_t FontChain::lookup(uint32_t codepoint) const {
     for (uint8_t i = 0; i < fonts_.size(); ++i) {
         if (!fonts_[i]) continue;
         uint32_t gid = fonts_[i]->glyph_index(codepoint);
         if (gid != 0)
-            return {i, gid};
+            return (gid << 8) | i;
     }
-    return {0, 0};
+    return kNotCovered;
+}
+
+std::pair<uint8_t, uint32_t> FontChain::resolve(uint32_t codepoint) const {
+    uint32_t e = kUnknown;
+    if (codepoint < kBmpSize) {
+        if (bmp_ready_.load(std::memory_order_acquire))
+            e = bmp_[codepoint].load(std::memory_order_relaxed);
+        if (e == kUnknown) {
+            std::lock_guard lock(coverage_mutex_);
+            if (!bmp_ready_.load(std::memory_order_relaxed)) {
+                bmp_ = std::make_unique<std::atomic<uint32_t>[]>(kBmpSize);
+                for (uint32_t i = 0; i < kBmpSize; ++i)
+                    bmp_[i].store(kUnknown, std::memory_order_relaxed);
+                bmp_ready_.store(true, std::memory_order_release);
+            }
+            e = lookup(codepoint);
+            bmp_[codepoint].store(e, std::memory_order_relaxed);
+        }
+    } else {
+        std::lock_guard lock(coverage_mutex_);
+        auto [it, added] = astral_.try_emplace(codepoint, kUnknown);
+        if (added) it->second = lookup(codepoint);
+        e = it->second;
+    }
+    if (e == kNotCovered) return {0, 0};
+    return {static_cast<uint8_t>(e & 0xFF), e >> 8};
+}
+
+size_t FontChain::coverage_bytes() const {
+    std::lock_guard lock(coverage_mutex_);
+    size_t bytes = astral_.bucket_count() * sizeof(void*)
+                 + astral_.size() * (2 * sizeof(uint32_t) + 2 * sizeof(void*));
+    if (bmp_ready_.load(std::memory_order_relaxed))
+        bytes += kBmpSize * sizeof(std::atomic<uint32_t>);
+    return bytes;
 }
 
 } // namespace sprawn
@@ -2,10 +2,14 @@
 
 #include "font_face.h"
 
+#include <atomic>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -24,22 +28,46 @@ public:
     uint8_t   count() const           { return static_cast<uint8_t>(fonts_.size()); }
 
     // Find a font that has the codepoint. Returns {font_index, glyph_id}.
-    // Returns {0, 0} if no font has it.
+    // Returns {0, 0} if no font has it. Answers are cached (safe to call
+    // from several threads), so only the first lookup of a codepoint asks
+    // FreeType.
     std::pair<uint8_t, uint32_t> resolve(uint32_t codepoint) const;
 
     // Rebuild all fonts at a new pixel size. Clears and recreates all FontFaces.
     void rebuild(int new_size_px);
 
     int size_px()       const { return size_px_; }
+    // Files of the chain, in font index order (for opening the same fonts
+    // on other threads).
+    const std::vector<std::filesystem::path>& paths() const { return paths_; }
     int line_height()   const { return fonts_[0]->line_height(); }
     int ascent()        const { return fonts_[0]->ascent(); }
     int advance_width() const { return fonts_[0]->advance_width(); }
 
+    // Bytes of the coverage cache.
+    size_t coverage_bytes() const;
+
 private:
+    // Coverage entries: (glyph_id << 8) | font_index, kNotCovered if no
+    // font has the codepoint, kUnknown if it was not looked up yet.
+    static constexpr uint32_t kUnknown     = 0xFFFFFFFFu;
+    static constexpr uint32_t kNotCovered  = 0;
+    static constexpr uint32_t kBmpSize     = 0x10000;
+
+    uint32_t lookup(uint32_t codepoint) const;
+    void     clear_coverage();
+
     FT_Library library_{};
     std::vector<std::unique_ptr<FontFace>> fonts_;
     std::vector<std::filesystem::path> paths_;
     int size_px_;
+
+    // Dense for the BMP (allocated on first use), a map for the astral
+    // planes. Misses are filled under the mutex.
+    mutable std::unique_ptr<std::atomic<uint32_t>[]> bmp_;
+    mutable std::atomic<bool>                        bmp_ready_{false};
+    mutable std::unordered_map<uint32_t, uint32_t>   astral_;
+    mutable std::mutex                               coverage_mutex_;
 };
 
 } // namespace sprawn
@@ -1,43 +1,120 @@
 #include "glyph_atlas.h"
 
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPRAWN_ATLAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
 namespace sprawn {
 
+// ---------------------------------------------------------------------------
+// GlyphAtlas
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// Alpha coverage to white ABGR8888 texels ({r, g, b, a} bytes in memory),
+// 16 pixels per step with SSE2.
+void expand_alpha(const uint8_t* src, uint32_t* dst, size_t n) {
+    size_t i = 0;
+#ifdef SPRAWN_ATLAS_SSE2
+    const __m128i white = _mm_set1_epi8(static_cast<char>(0xFF));
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // Byte pairs {0xFF, a}, then quads {0xFF, 0xFF, 0xFF, a}.
+        __m128i lo = _mm_unpacklo_epi8(white, a);
+        __m128i hi = _mm_unpackhi_epi8(white, a);
+        auto* out = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(white, lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(white, lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(white, hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(white, hi));
+    }
+#endif
+    for (; i < n; ++i)
+        dst[i] = 0x00FFFFFFu | (static_cast<uint32_t>(src[i]) << 24);
+}
+
+SDL_Rect union_rect(SDL_Rect a, SDL_Rect b) {
+    if (a.w == 0) return b;
+    int x0 = std::min(a.x, b.x), y0 = std::min(a.y, b.y);
+    int x1 = std::max(a.x + a.w, b.x + b.w), y1 = std::max(a.y + a.h, b.y + b.h);
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+} // namespace
+
 GlyphAtlas::GlyphAtlas(Renderer& renderer, FontChain& fonts,
-                       int atlas_w, int atlas_h)
+                       int atlas_w, int atlas_h, size_t max_pages)
     : renderer_(renderer), fonts_(fonts),
-      atlas_w_(atlas_w), atlas_h_(atlas_h)
+      atlas_w_(atlas_w), atlas_h_(atlas_h),
+      max_pages_(std::clamp<size_t>(max_pages, 2, 256))
 {
-    texture_ = renderer_.create_texture(atlas_w_, atlas_h_);
-    if (!texture_)
-        throw std::runtime_error("Failed to create glyph atlas texture");
+    add_page(false);
+    renderer_.set_pre_flush([this] { upload_dirty(); });
+    precache_ascii();
+}
 
-    // Clear texture to transparent
-    std::vector<uint8_t> clear(atlas_w_ * atlas_h_ * 4, 0);
-    renderer_.update_texture(texture_, clear.data(), atlas_w_ * 4);
+GlyphAtlas::~GlyphAtlas() {
+    rasterizer_.reset();
+    renderer_.set_pre_flush(nullptr);
+    for (const Page& p : pages_)
+        if (p.texture) renderer_.destroy_texture(p.texture);
+}
 
-    // Pre-cache common ASCII printable range using primary font glyph IDs
-    FontFace& primary = fonts_.primary();
-    for (uint32_t cp = 32; cp < 127; ++cp) {
-        uint32_t gid = primary.glyph_index(cp);
-        if (gid != 0)
-            get_or_add(gid, 0);
+void GlyphAtlas::add_page(bool color) {
+    SDL_Texture* tex = renderer_.create_texture(atlas_w_, atlas_h_);
+    if (!tex)
+        throw std::runtime_error("Failed to create glyph atlas texture");
+    // Leave a 1px border: the packer covers [1, w) x [1, h).
+    pages_.push_back(Page{tex, SkylinePacker(atlas_w_ - 1, atlas_h_ - 1), color, frame_, 0, {}, {}});
+    // A new texture's pixels are undefined, so it is blanked once in full.
+    // Later resets rely on every glyph's padding being rewritten with it.
+    if (color) {
+        std::vector<uint8_t> blank(static_cast<size_t>(atlas_w_) * atlas_h_ * 4, 0);
+        renderer_.update_texture(tex, blank.data(), atlas_w_ * 4);
+        ++uploads_;
     }
+    reset_page(pages_.size() - 1, color);
+    if (!color) pages_.back().dirty = {0, 0, atlas_w_, atlas_h_};
+}
+
+void GlyphAtlas::reset_page(size_t p, bool color) {
+    Page& page = pages_[p];
+    page.packer.reset();
+    page.glyphs = 0;
+    page.color  = color;
+    page.dirty  = {0, 0, 0, 0};
+    if (color) {
+        page.alpha.clear();
+        page.alpha.shrink_to_fit();
+    } else {
+        page.alpha.assign(static_cast<size_t>(atlas_w_) * atlas_h_, 0);
+    }
+    for (auto& [key, ag] : cache_)
+        if (ag.page == p && ag.rect.w > 0) ag.resident = false;
+    if (p == 0) reserve_solid();
 }
 
 void GlyphAtlas::clear() {
     cache_.clear();
-    cur_x_ = 1;
-    cur_y_ = 1;
-    shelf_h_ = 0;
-
-    // Blank the texture
-    std::vector<uint8_t> blank(atlas_w_ * atlas_h_ * 4, 0);
-    renderer_.update_texture(texture_, blank.data(), atlas_w_ * 4);
+    failed_.clear();
+    // Back to one page; the rest are created again as needed. Page 0 is
+    // only reset in memory: nothing on the GPU is blanked.
+    for (size_t p = 1; p < pages_.size(); ++p)
+        renderer_.destroy_texture(pages_[p].texture);
+    pages_.erase(pages_.begin() + 1, pages_.end());
+    reset_page(0, false);
+    if (rasterizer_) rasterizer_->reset(fonts_.size_px());
+    precache_ascii();
+}
 
-    // Re-pre-cache common ASCII printable range using primary font glyph IDs
+void GlyphAtlas::precache_ascii() {
+    // Pre-cache common ASCII printable range using primary font glyph IDs
     FontFace& primary = fonts_.primary();
     for (uint32_t cp = 32; cp < 127; ++cp) {
         uint32_t gid = primary.glyph_index(cp);
@@ -46,8 +123,19 @@ void GlyphAtlas::clear() {
     }
 }
 
-GlyphAtlas::~GlyphAtlas() {
-    if (texture_) SDL_DestroyTexture(texture_);
+void GlyphAtlas::reserve_solid() {
+    // An opaque block on page 0; the renderer samples its centre for rect
+    // fills so they batch with the glyphs on that page.
+    constexpr int kSize = 3;
+    const int pad = 1;
+    Page& page = pages_[0];
+    int x = 0, y = 0;
+    page.packer.insert(kSize + pad, kSize + pad, x, y);
+    ++x; ++y;
+    for (int r = 0; r < kSize; ++r)
+        std::memset(&page.alpha[static_cast<size_t>(y + r) * atlas_w_ + x], 255, kSize);
+    mark_dirty(page, {x, y, kSize + pad, kSize + pad});
+    renderer_.set_solid_texel(page.texture, x + kSize / 2, y + kSize / 2);
 }
 
 const AtlasGlyph* GlyphAtlas::get(uint32_t glyph_id, uint8_t font_index) const {
@@ -58,13 +146,58 @@ const AtlasGlyph* GlyphAtlas::get(uint32_t glyph_id, uint8_t font_index) const {
     return nullptr;
 }
 
+bool GlyphAtlas::place(int w, int h, bool color, uint8_t& page, int& x, int& y) {
+    // Too big for any page: evicting one would not help.
+    if (w > atlas_w_ || h > atlas_h_) return false;
+    // Most recently created pages first: older ones are usually full.
+    for (size_t p = pages_.size(); p-- > 0;) {
+        if (pages_[p].color == color && pages_[p].packer.insert(w, h, x, y)) {
+            page = static_cast<uint8_t>(p);
+            return true;
+        }
+    }
+    if (pages_.size() < max_pages_) {
+        add_page(color);
+        page = static_cast<uint8_t>(pages_.size() - 1);
+        return pages_.back().packer.insert(w, h, x, y);
+    }
+
+    // Any page can change kind when evicted, except page 0, which holds
+    // the solid texel.
+    size_t victim = pages_.size();
+    for (size_t p = color ? 1 : 0; p < pages_.size(); ++p) {
+        if (pages_[p].last_used >= frame_) continue;
+        if (victim == pages_.size() || pages_[p].last_used < pages_[victim].last_used)
+            victim = p;
+    }
+    if (victim == pages_.size()) return false;
+    if (color) {
+        // RGBA glyphs are uploaded without their padding: blank the page.
+        std::vector<uint8_t> blank(static_cast<size_t>(atlas_w_) * atlas_h_ * 4, 0);
+        renderer_.update_texture(pages_[victim].texture, blank.data(), atlas_w_ * 4);
+        ++uploads_;
+    }
+    reset_page(victim, color);
+    ++evictions_;
+    page = static_cast<uint8_t>(victim);
+    return pages_[victim].packer.insert(w, h, x, y);
+}
+
 const AtlasGlyph* GlyphAtlas::get_or_add(uint32_t glyph_id, uint8_t font_index) {
     uint64_t key = make_key(glyph_id, font_index);
     auto it = cache_.find(key);
-    if (it != cache_.end())
+    if (it != cache_.end() && (it->second.resident || it->second.rect.w == 0)) {
+        ++hits_;
+        pages_[it->second.page].last_used = frame_;
         return &it->second;
+    }
+    if (failed_.count(key)) return nullptr;
+    ++misses_;
 
-    GlyphBitmap bm = fonts_.font(font_index).rasterize_glyph(glyph_id);
+    return insert(key, fonts_.font(font_index).rasterize_glyph(glyph_id));
+}
+
+const AtlasGlyph* GlyphAtlas::insert(uint64_t key, const GlyphBitmap& bm) {
     if (bm.pixels.empty() || (bm.width == 0 || bm.height == 0)) {
         // Invisible or missing glyph — store a dummy entry so we don't retry
         AtlasGlyph ag{};
@@ -77,56 +210,161 @@ const AtlasGlyph* GlyphAtlas::get_or_add(uint32_t glyph_id, uint8_t font_index)
     }
 
     const int pad = 1;
-    int w = bm.width  + pad;
-    int h = bm.height + pad;
-
-    // Start a new shelf if needed
-    if (cur_x_ + w > atlas_w_) {
-        cur_x_   = 1;
-        cur_y_  += shelf_h_ + pad;
-        shelf_h_ = 0;
+    if (bm.width + pad > atlas_w_ || bm.height + pad > atlas_h_) {
+        // Larger than a page (huge zoom): kept as an empty entry, like an
+        // invisible glyph, so it is not rasterized again until clear().
+        AtlasGlyph ag{};
+        ag.bearing_x = bm.bearing_x;
+        ag.bearing_y = bm.bearing_y;
+        ag.advance_x = bm.advance_x;
+        cache_[key] = ag;
+        return &cache_[key];
     }
-
-    if (cur_y_ + h > atlas_h_) {
-        // Atlas full — return nullptr (caller should handle gracefully)
+    uint8_t page = 0;
+    int x = 0, y = 0;
+    if (!place(bm.width + pad, bm.height + pad, bm.color, page, x, y)) {
+        // Every page is in use this frame — return nullptr (caller should
+        // handle gracefully)
+        failed_.insert(key);
         return nullptr;
     }
+    // Packer coordinates exclude the 1px border.
+    ++x; ++y;
 
-    if (h > shelf_h_) shelf_h_ = h;
-
-    upload_glyph(cur_x_, cur_y_, bm);
+    store_glyph(pages_[page], x, y, bm);
+    pages_[page].last_used = frame_;
+    ++pages_[page].glyphs;
 
     AtlasGlyph ag;
-    ag.rect      = {cur_x_, cur_y_, bm.width, bm.height};
+    ag.rect      = {x, y, bm.width, bm.height};
     ag.bearing_x = bm.bearing_x;
     ag.bearing_y = bm.bearing_y;
     ag.advance_x = bm.advance_x;
-
-    cur_x_ += w;
+    ag.page      = page;
+    ag.resident  = true;
 
     cache_[key] = ag;
     return &cache_[key];
 }
 
-void GlyphAtlas::upload_glyph(int tex_x, int tex_y, const GlyphBitmap& bm) {
+void GlyphAtlas::set_worker_pool(WorkerPool* pool) {
+    rasterizer_.reset();
+    landed_.clear();
+    if (pool)
+        rasterizer_ = std::make_unique<GlyphRasterizer>(*pool, fonts_.paths(), fonts_.size_px());
+}
+
+const AtlasGlyph* GlyphAtlas::get_or_request(uint32_t glyph_id, uint8_t font_index, bool& pending) {
+    if (!rasterizer_) return get_or_add(glyph_id, font_index);
+    uint64_t key = make_key(glyph_id, font_index);
+    auto it = cache_.find(key);
+    if (it != cache_.end() && (it->second.resident || it->second.rect.w == 0)) {
+        ++hits_;
+        pages_[it->second.page].last_used = frame_;
+        return &it->second;
+    }
+    // Rasterized already but not placed: skipped until the next frame, so
+    // the row is not redrawn (and the glyph requested) over and over.
+    if (failed_.count(key)) return nullptr;
+    ++misses_;
+    rasterizer_->request(key);
+    pending = true;
+    return nullptr;
+}
+
+bool GlyphAtlas::collect() {
+    if (!rasterizer_) return false;
+    landed_.clear();
+    rasterizer_->take(landed_);
+    bool inserted = false;
+    for (const auto& r : landed_) {
+        auto it = cache_.find(r.key);
+        if (it != cache_.end() && (it->second.resident || it->second.rect.w == 0)) continue;
+        if (insert(r.key, r.bitmap)) inserted = true;
+    }
+    return inserted;
+}
+
+void GlyphAtlas::mark_dirty(Page& page, SDL_Rect r) {
+    page.dirty = union_rect(page.dirty, r);
+}
+
+void GlyphAtlas::upload_dirty() {
+    for (Page& page : pages_) {
+        const SDL_Rect& d = page.dirty;
+        if (page.color || d.w == 0) continue;
+        staging_.resize(static_cast<size_t>(d.w) * d.h);
+        for (int r = 0; r < d.h; ++r) {
+            expand_alpha(&page.alpha[static_cast<size_t>(d.y + r) * atlas_w_ + d.x],
+                         &staging_[static_cast<size_t>(r) * d.w], static_cast<size_t>(d.w));
+        }
+        // Straight to SDL: the renderer is in the middle of a flush.
+        SDL_UpdateTexture(page.texture, &d, staging_.data(), d.w * 4);
+        ++uploads_;
+        page.dirty = {0, 0, 0, 0};
+    }
+    // A full-page upload leaves 4 MB behind; keep glyph-sized ones only.
+    if (staging_.capacity() > (size_t{1} << 18)) {
+        staging_.clear();
+        staging_.shrink_to_fit();
+    }
+}
+
+AtlasStats GlyphAtlas::stats() const {
+    AtlasStats s;
+    s.pages     = pages_.size();
+    s.max_pages = max_pages_;
+    s.hits      = hits_;
+    s.misses    = misses_;
+    s.evictions = evictions_;
+    s.uploads   = uploads_;
+    for (const Page& p : pages_) {
+        s.color_pages += p.color;
+        s.glyphs      += p.glyphs;
+        s.occupancy   += p.packer.occupancy();
+    }
+    s.occupancy /= static_cast<double>(pages_.size());
+    return s;
+}
+
+size_t GlyphAtlas::alpha_bytes() const {
+    size_t bytes = staging_.capacity() * sizeof(uint32_t);
+    for (const Page& p : pages_) bytes += p.alpha.capacity();
+    return bytes;
+}
+
+size_t GlyphAtlas::index_bytes() const {
+    constexpr size_t kNode = sizeof(uint64_t) + sizeof(AtlasGlyph) + 2 * sizeof(void*);
+    return cache_.bucket_count() * sizeof(void*) + cache_.size() * kNode;
+}
+
+void GlyphAtlas::store_glyph(Page& page, int tex_x, int tex_y, const GlyphBitmap& bm) {
     int w = bm.width;
     int h = bm.height;
-    SDL_Rect dst{tex_x, tex_y, w, h};
 
     if (bm.color) {
-        // Color emoji: pixels are already RGBA
-        SDL_UpdateTexture(texture_, &dst, bm.pixels.data(), w * 4);
-    } else {
-        // Alpha-only bitmap → RGBA (white text, varying alpha)
-        std::vector<uint8_t> rgba(w * h * 4);
-        for (int i = 0; i < w * h; ++i) {
-            rgba[i * 4 + 0] = 255;
-            rgba[i * 4 + 1] = 255;
-            rgba[i * 4 + 2] = 255;
-            rgba[i * 4 + 3] = bm.pixels[i];
+        // Color emoji: pixels are already RGBA. Written straight to the
+        // texture: the region is fresh, so no queued quad samples it.
+        SDL_Rect dst{tex_x, tex_y, w, h};
+        SDL_UpdateTexture(page.texture, &dst, bm.pixels.data(), w * 4);
+        ++uploads_;
+        return;
+    }
+    // Alpha-only bitmap: kept as is, expanded to white RGBA on upload. The
+    // padding is cleared too, in case the page held other glyphs before.
+    const int pad = 1;
+    for (int r = 0; r <= h && tex_y + r < atlas_h_; ++r) {
+        uint8_t* row = &page.alpha[static_cast<size_t>(tex_y + r) * atlas_w_ + tex_x];
+        int cols = std::min(w + pad, atlas_w_ - tex_x);
+        if (r < h) {
+            std::memcpy(row, &bm.pixels[static_cast<size_t>(r) * w], static_cast<size_t>(w));
+            if (cols > w) row[w] = 0;
+        } else {
+            std::memset(row, 0, static_cast<size_t>(cols));
         }
-        SDL_UpdateTexture(texture_, &dst, rgba.data(), w * 4);
     }
+    mark_dirty(page, {tex_x, tex_y, std::min(w + pad, atlas_w_ - tex_x),
+                      std::min(h + pad, atlas_h_ - tex_y)});
 }
 
 } // namespace sprawn
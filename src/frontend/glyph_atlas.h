@@ -1,62 +1,164 @@
 #pragma once
 
 #include "font_chain.h"
+#include "glyph_rasterizer.h"
 #include <sprawn/frontend/renderer.h>
+#include <sprawn/frontend/skyline_packer.h>
 
 #include <SDL2/SDL.h>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace sprawn {
 
+class WorkerPool;
+
 struct AtlasGlyph {
-    SDL_Rect rect;     // location in atlas texture (pixels)
+    SDL_Rect rect;     // location in its page's texture (pixels)
     int bearing_x;     // left bearing
     int bearing_y;     // top bearing from baseline (positive = up)
     int advance_x;     // horizontal advance in pixels
+    uint8_t page{0};
+    // False once its page was evicted: the metrics above stay valid, the
+    // bitmap is rasterized again by the next get_or_add().
+    bool resident{true};
+};
+
+struct AtlasStats {
+    size_t pages{0};
+    size_t color_pages{0};
+    size_t max_pages{0};
+    size_t glyphs{0};      // resident
+    size_t hits{0};
+    size_t misses{0};      // rasterized on demand
+    size_t evictions{0};   // pages dropped to make room
+    size_t uploads{0};     // SDL_UpdateTexture calls
+    double occupancy{0};   // packed area / area of all pages
 };
 
+// Glyph bitmaps packed into up to `max_pages` textures. When every page is
+// full, the page least recently drawn from is wiped and reused; pages
+// drawn from in the current frame are never evicted, so quads already
+// queued stay valid. Call begin_frame() once per frame.
+//
+// Monochrome glyphs go to alpha pages, kept as one byte per pixel and
+// uploaded as a single dirty rectangle per page just before the renderer
+// submits quads; colour glyphs (emoji) go to RGBA pages, uploaded as they
+// are added. Page 0 is always an alpha page.
 class GlyphAtlas {
 public:
     GlyphAtlas(Renderer& renderer, FontChain& fonts,
-               int atlas_w = 1024, int atlas_h = 1024);
+               int atlas_w = 1024, int atlas_h = 1024, size_t max_pages = 4);
     ~GlyphAtlas();
 
     GlyphAtlas(const GlyphAtlas&) = delete;
     GlyphAtlas& operator=(const GlyphAtlas&) = delete;
 
-    // Clear all cached glyphs and reset the atlas. Re-pre-caches ASCII.
+    // Clear all cached glyphs and reset the atlas to one page. Re-pre-caches
+    // ASCII.
     void clear();
 
-    // Returns nullptr if the glyph cannot be rendered.
+    void begin_frame() {
+        ++frame_;
+        failed_.clear();
+    }
+
+    // Returns nullptr if the glyph cannot be rendered, or cannot be made
+    // resident without evicting a page used this frame. Rasterizes inline.
     const AtlasGlyph* get_or_add(uint32_t glyph_id, uint8_t font_index = 0);
 
+    // Rasterize on `pool` from now on (nullptr: inline again).
+    void set_worker_pool(WorkerPool* pool);
+    // Like get_or_add(), but with a worker pool set a glyph not yet
+    // resident is queued for rasterization instead: returns nullptr and
+    // sets `pending`. It becomes available after a later collect().
+    const AtlasGlyph* get_or_request(uint32_t glyph_id, uint8_t font_index, bool& pending);
+    // Packs the glyphs rasterized since the last call (render thread).
+    // Returns true if any were inserted. A glyph that found no room (every
+    // page in use this frame) is dropped and, until the next frame, skipped
+    // by get_or_request() rather than requested again.
+    bool collect();
+    // True while requested glyphs are still being rasterized.
+    bool pending() const { return rasterizer_ && rasterizer_->busy(); }
+
     // Const lookup — returns nullptr if the glyph is not already cached.
+    // The result may not be resident; use it for metrics only.
     const AtlasGlyph* get(uint32_t glyph_id, uint8_t font_index = 0) const;
 
-    SDL_Texture* texture() const { return texture_; }
+    SDL_Texture* texture(uint8_t page = 0) const { return pages_[page].texture; }
+    // Uploads the pending glyphs of every alpha page. Runs from the
+    // renderer before each batch is submitted.
+    void upload_dirty();
+    size_t page_count() const { return pages_.size(); }
+
+    AtlasStats stats() const;
+
+    // Bytes of the page textures (driver/GPU side; SDL2 offers no
+    // single-channel texture format, so every page is RGBA there), of the
+    // alpha pages' pixels and of the glyph index.
+    size_t texture_bytes() const {
+        return pages_.size() * static_cast<size_t>(atlas_w_) * atlas_h_ * 4;
+    }
+    size_t alpha_bytes() const;
+    size_t index_bytes() const;
 
 private:
+    struct Page {
+        SDL_Texture*  texture{};
+        SkylinePacker packer;
+        bool          color{false};
+        uint64_t      last_used{0};  // frame
+        size_t        glyphs{0};
+        std::vector<uint8_t> alpha;  // alpha pages: one byte per pixel
+        SDL_Rect      dirty{0, 0, 0, 0};  // not yet uploaded
+    };
+
     Renderer&   renderer_;
     FontChain&  fonts_;
-    SDL_Texture* texture_{};
     int atlas_w_, atlas_h_;
-
-    // Shelf packing state
-    int cur_x_{1};   // leave 1px border
-    int cur_y_{1};
-    int shelf_h_{0};
+    size_t max_pages_;
+    std::vector<Page> pages_;
+    uint64_t frame_{1};
+    size_t hits_{0}, misses_{0}, evictions_{0}, uploads_{0};
+    std::vector<uint32_t> staging_;  // dirty rectangle expanded to RGBA
 
     // Key: (uint64_t(font_index) << 32) | glyph_id
     std::unordered_map<uint64_t, AtlasGlyph> cache_;
+    // Keys place() found no room for this frame.
+    std::unordered_set<uint64_t> failed_;
+
+    std::unique_ptr<GlyphRasterizer>     rasterizer_;
+    std::vector<GlyphRasterizer::Result> landed_;
 
     static uint64_t make_key(uint32_t glyph_id, uint8_t font_index) {
         return (uint64_t(font_index) << 32) | glyph_id;
     }
 
-    // Upload a single glyph bitmap region to the texture.
-    void upload_glyph(int tex_x, int tex_y, const GlyphBitmap& bm);
+    void add_page(bool color);
+    // Empties page `p`, makes it an alpha or colour page and marks its
+    // glyphs non-resident.
+    void reset_page(size_t p, bool color);
+    // Finds room for a w x h bitmap on a page of the given kind: in an
+    // existing page, a new page, or the least recently used page after
+    // evicting it. False if none, or if it is larger than a page; nothing is
+    // evicted then.
+    bool place(int w, int h, bool color, uint8_t& page, int& x, int& y);
+    void mark_dirty(Page& page, SDL_Rect r);
+    void precache_ascii();
+    // Caches a rasterized glyph, packing its bitmap if it has one.
+    const AtlasGlyph* insert(uint64_t key, const GlyphBitmap& bm);
+
+    // Reserves the white block fill_rect samples on page 0 and registers
+    // it with the renderer.
+    void reserve_solid();
+
+    // Copies a glyph bitmap into its page: the alpha shadow, or straight
+    // to the texture for colour pages.
+    void store_glyph(Page& page, int tex_x, int tex_y, const GlyphBitmap& bm);
 };
 
 } // namespace sprawn
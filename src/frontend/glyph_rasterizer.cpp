@@ -0,0 +1,111 @@
+#include "glyph_rasterizer.h"
+
+#include <sprawn/worker_pool.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <utility>
+
+namespace sprawn {
+
+GlyphRasterizer::Faces::~Faces() {
+    fonts.clear(); // destroy faces before library
+    if (library) FT_Done_FreeType(library);
+}
+
+GlyphRasterizer::GlyphRasterizer(WorkerPool& pool, std::vector<std::filesystem::path> paths,
+                                 int size_px)
+    : pool_(pool)
+    , paths_(std::move(paths))
+    , max_tasks_(std::max<size_t>(pool.concurrency() - 1, 1))
+    , size_px_(size_px)
+{}
+
+GlyphRasterizer::~GlyphRasterizer() {
+    std::unique_lock lock(mutex_);
+    queue_.clear();
+    idle_.wait(lock, [this] { return running_ == 0; });
+}
+
+std::unique_ptr<GlyphRasterizer::Faces> GlyphRasterizer::open_faces(int size_px) const {
+    auto faces = std::make_unique<Faces>();
+    faces->size_px = size_px;
+    if (FT_Init_FreeType(&faces->library)) {
+        faces->library = nullptr;
+        return faces;
+    }
+    for (const auto& p : paths_) {
+        try {
+            faces->fonts.push_back(std::make_unique<FontFace>(faces->library, p, size_px));
+        } catch (const std::exception&) {
+            faces->fonts.push_back(nullptr); // keep aligned with the chain
+        }
+    }
+    return faces;
+}
+
+void GlyphRasterizer::request(uint64_t key) {
+    {
+        std::lock_guard lock(mutex_);
+        if (!requested_.insert(key).second) return;
+        queue_.push_back(key);
+        if (running_ >= max_tasks_) return;
+        ++running_;
+    }
+    pool_.submit([this] { run(); });
+}
+
+void GlyphRasterizer::run() {
+    std::unique_lock lock(mutex_);
+    std::unique_ptr<Faces> faces;
+    if (!spare_faces_.empty()) {
+        faces = std::move(spare_faces_.back());
+        spare_faces_.pop_back();
+    }
+    // In request order: the visible lines ask first.
+    while (!queue_.empty()) {
+        uint64_t key = queue_.front();
+        queue_.pop_front();
+        uint64_t epoch = epoch_;
+        int      size  = size_px_;
+        lock.unlock();
+
+        if (!faces || faces->size_px != size) faces = open_faces(size);
+        GlyphBitmap bm{};
+        auto font_index = static_cast<size_t>(key >> 32);
+        if (font_index < faces->fonts.size() && faces->fonts[font_index])
+            bm = faces->fonts[font_index]->rasterize_glyph(static_cast<uint32_t>(key));
+
+        lock.lock();
+        if (epoch == epoch_) done_.push_back(Result{key, std::move(bm)});
+    }
+    if (faces) spare_faces_.push_back(std::move(faces));
+    --running_;
+    idle_.notify_all();
+}
+
+void GlyphRasterizer::take(std::vector<Result>& out) {
+    std::lock_guard lock(mutex_);
+    for (Result& r : done_) {
+        requested_.erase(r.key);
+        out.push_back(std::move(r));
+    }
+    done_.clear();
+}
+
+bool GlyphRasterizer::busy() const {
+    std::lock_guard lock(mutex_);
+    return !requested_.empty();
+}
+
+void GlyphRasterizer::reset(int size_px) {
+    std::lock_guard lock(mutex_);
+    ++epoch_;
+    size_px_ = size_px;
+    queue_.clear();
+    requested_.clear();
+    done_.clear();
+}
+
+} // namespace sprawn
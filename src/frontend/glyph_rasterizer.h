@@ -0,0 +1,75 @@
+#pragma once
+
+#include "font_face.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace sprawn {
+
+class WorkerPool;
+
+// Rasterizes glyphs on worker threads. FreeType faces must not be shared
+// between threads, so every concurrently running task works with its own
+// FT_Library and faces, opened from the font chain's files at the current
+// pixel size and reused by later tasks.
+class GlyphRasterizer {
+public:
+    // Keys are GlyphAtlas keys: (font_index << 32) | glyph_id.
+    struct Result {
+        uint64_t    key;
+        GlyphBitmap bitmap;  // empty if the glyph has nothing to draw
+    };
+
+    GlyphRasterizer(WorkerPool& pool, std::vector<std::filesystem::path> paths, int size_px);
+    // Drops queued glyphs and waits for the ones being rasterized.
+    ~GlyphRasterizer();
+
+    GlyphRasterizer(const GlyphRasterizer&) = delete;
+    GlyphRasterizer& operator=(const GlyphRasterizer&) = delete;
+
+    // Queues `key` unless it is already queued, running or finished.
+    void request(uint64_t key);
+    // Moves out the glyphs finished since the last call.
+    void take(std::vector<Result>& out);
+    // True while requested glyphs are queued, running or not yet taken.
+    bool busy() const;
+
+    // Drops queued and finished glyphs; later requests rasterize at
+    // `size_px`. Results still running are discarded when they land.
+    void reset(int size_px);
+
+private:
+    struct Faces {
+        FT_Library library{};
+        int        size_px{0};
+        std::vector<std::unique_ptr<FontFace>> fonts;  // nullptr: failed to open
+        ~Faces();
+    };
+
+    void run();
+    std::unique_ptr<Faces> open_faces(int size_px) const;
+
+    WorkerPool& pool_;
+    const std::vector<std::filesystem::path> paths_;
+    size_t max_tasks_;
+
+    mutable std::mutex      mutex_;
+    std::condition_variable idle_;
+    std::deque<uint64_t>    queue_;
+    std::unordered_set<uint64_t> requested_;  // queued, running or in done_
+    std::vector<Result>     done_;
+    std::vector<std::unique_ptr<Faces>> spare_faces_;
+    size_t   running_{0};
+    uint64_t epoch_{0};
+    int      size_px_;
+};
+
+} // namespace sprawn
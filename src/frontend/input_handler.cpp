@@ -16,6 +16,7 @@ std::optional<EditorCommand> InputHandler::translate(const SDL_Event& ev) const
         if (ctrl) {
             switch (k.sym) {
             case SDLK_a: return SelectAll{};
+            case SDLK_f: return FilterLines{};
             case SDLK_c: return Copy{};
             case SDLK_v: return Paste{};
             case SDLK_x: return Cut{};
@@ -35,8 +36,12 @@ std::optional<EditorCommand> InputHandler::translate(const SDL_Event& ev) const
         case SDLK_PAGEDOWN:  return MovePgDn{shift};
         case SDLK_BACKSPACE: return DeleteBackward{};
         case SDLK_DELETE:    return DeleteForward{};
+        case SDLK_ESCAPE:    return ClearFilter{};
         case SDLK_RETURN:    [[fallthrough]];
         case SDLK_KP_ENTER:  return NewLine{};
+        case SDLK_F12:
+            if (shift) return DumpMemoryReport{};
+            return ToggleStatsOverlay{};
         default: break;
         }
         break;
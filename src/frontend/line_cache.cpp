@@ -1,96 +1,92 @@
 #include <sprawn/frontend/line_cache.h>
 
 #include <algorithm>
+#include <bit>
+#include <utility>
 
 namespace sprawn {
 
-LineCache::LineCache(size_t capacity) : capacity_(capacity) {}
-
-const GlyphRun* LineCache::get(size_t line, uint64_t hash) {
-    auto it = index_.find(line);
-    if (it == index_.end()) return nullptr;
-
-    auto list_it = it->second;
-    if (list_it->hash != hash) return nullptr;
+LineCache::LineCache(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {
+    size_t slots = std::bit_ceil(capacity_ * 2);
+    mask_  = slots - 1;
+    shift_ = 64 - std::countr_zero(slots);
+    slots_.resize(slots);
+}
 
-    // Move to front (most recently used)
-    lru_.splice(lru_.begin(), lru_, list_it);
-    return &list_it->run;
+size_t LineCache::home(uint64_t version) const {
+    // Fibonacci hashing: versions are handed out in sequence, the
+    // multiplication spreads them over the table.
+    return static_cast<size_t>((version * 0x9E3779B97F4A7C15ull) >> shift_);
 }
 
-void LineCache::put(size_t line, uint64_t hash, GlyphRun run) {
-    auto it = index_.find(line);
-    if (it != index_.end()) {
-        // Update existing entry
-        auto list_it = it->second;
-        list_it->hash = hash;
-        list_it->run  = std::move(run);
-        lru_.splice(lru_.begin(), lru_, list_it);
-        return;
+size_t LineCache::find(uint64_t version) const {
+    for (size_t i = home(version);; i = (i + 1) & mask_) {
+        const Slot& s = slots_[i];
+        if (!s.used) return npos;
+        if (s.version == version) return i;
     }
-
-    evict_if_full();
-
-    lru_.push_front(CacheEntry{line, hash, std::move(run)});
-    index_[line] = lru_.begin();
 }
 
-void LineCache::invalidate(size_t line) {
-    auto it = index_.find(line);
-    if (it == index_.end()) return;
-    lru_.erase(it->second);
-    index_.erase(it);
+const GlyphRun* LineCache::get(uint64_t version) {
+    size_t i = find(version);
+    if (i == npos) return nullptr;
+    slots_[i].referenced = true;
+    return &slots_[i].run;
 }
 
-void LineCache::invalidate_range(size_t first, size_t removed_count,
-                                  int line_delta)
-{
-    // Collect keys to remove and keys to renumber
-    std::vector<size_t>                      to_remove;
-    std::vector<std::pair<size_t, size_t>>   to_renumber; // {old_key, new_key}
-
-    for (auto& [key, _] : index_) {
-        if (key >= first && key < first + removed_count) {
-            to_remove.push_back(key);
-        } else if (key >= first + removed_count && line_delta != 0) {
-            size_t new_key = static_cast<size_t>(
-                static_cast<long long>(key) + line_delta);
-            to_renumber.emplace_back(key, new_key);
-        }
-    }
-
-    for (size_t k : to_remove) {
-        lru_.erase(index_[k]);
-        index_.erase(k);
+void LineCache::put(uint64_t version, GlyphRun run) {
+    size_t i = find(version);
+    if (i == npos) {
+        if (size_ >= capacity_) evict_one();
+        for (i = home(version); slots_[i].used; i = (i + 1) & mask_) {}
+        slots_[i].used    = true;
+        slots_[i].version = version;
+        ++size_;
     }
+    slots_[i].run = std::move(run);
+    // Survives the hand's next pass, so a run is not dropped before it
+    // was drawn once.
+    slots_[i].referenced = true;
+}
 
-    // Sort to avoid key collisions during renumbering.
-    if (line_delta > 0) {
-        std::sort(to_renumber.begin(), to_renumber.end(),
-                  [](const auto& a, const auto& b) { return a.first > b.first; });
-    } else {
-        std::sort(to_renumber.begin(), to_renumber.end());
+void LineCache::erase_slot(size_t i) {
+    for (size_t j = (i + 1) & mask_; slots_[j].used; j = (j + 1) & mask_) {
+        // The entry at j may fill the hole if the hole lies on its probe
+        // path, i.e. between its home slot and j.
+        size_t h = home(slots_[j].version);
+        if (((j - h) & mask_) >= ((j - i) & mask_)) {
+            slots_[i] = std::move(slots_[j]);
+            i = j;
+        }
     }
+    slots_[i] = Slot{};
+    --size_;
+}
 
-    for (auto& [old_k, new_k] : to_renumber) {
-        auto it = index_[old_k];
-        it->line = new_k;
-        index_.erase(old_k);
-        index_[new_k] = it;
+void LineCache::evict_one() {
+    // At most two sweeps: the first clears every reference bit.
+    for (;; hand_ = (hand_ + 1) & mask_) {
+        Slot& s = slots_[hand_];
+        if (!s.used) continue;
+        if (!s.referenced) {
+            erase_slot(hand_);
+            return;
+        }
+        s.referenced = false;
     }
 }
 
 void LineCache::clear() {
-    lru_.clear();
-    index_.clear();
+    for (Slot& s : slots_) s = Slot{};
+    size_ = 0;
+    hand_ = 0;
 }
 
-void LineCache::evict_if_full() {
-    while (lru_.size() >= capacity_) {
-        auto& last = lru_.back();
-        index_.erase(last.line);
-        lru_.pop_back();
-    }
+size_t LineCache::memory_usage() const {
+    size_t bytes = slots_.capacity() * sizeof(Slot);
+    for (const Slot& s : slots_)
+        bytes += s.run.glyphs.capacity() * sizeof(GlyphEntry);
+    return bytes;
 }
 
 } // namespace sprawn
@@ -0,0 +1,69 @@
+#include <sprawn/frontend/line_tile_cache.h>
+
+namespace sprawn {
+
+LineTileCache::LineTileCache(Renderer& renderer, size_t max_bytes)
+    : renderer_(renderer), max_bytes_(max_bytes) {}
+
+LineTileCache::~LineTileCache() {
+    clear();
+}
+
+TextureHandle LineTileCache::find(size_t line, const TileKey& key) {
+    auto it = index_.find(line);
+    if (it == index_.end() || !(it->second->key == key)) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->texture;
+}
+
+TextureHandle LineTileCache::acquire(size_t line, const TileKey& key, int phys_w, int phys_h) {
+    if (phys_w <= 0 || phys_h <= 0) return nullptr;
+    auto it = index_.find(line);
+    if (it != index_.end()) {
+        Tile& t = *it->second;
+        if (t.w == phys_w && t.h == phys_h) {
+            t.key = key;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return t.texture;
+        }
+        release(t);
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+
+    size_t need = static_cast<size_t>(phys_w) * phys_h * 4;
+    while (!lru_.empty() && bytes_ + need > max_bytes_) {
+        release(lru_.back());
+        index_.erase(lru_.back().line);
+        lru_.pop_back();
+    }
+
+    TextureHandle tex = renderer_.create_target(phys_w, phys_h);
+    if (!tex) return nullptr;
+    bytes_ += need;
+    lru_.push_front(Tile{line, key, tex, phys_w, phys_h});
+    index_[line] = lru_.begin();
+    return tex;
+}
+
+void LineTileCache::forget(size_t line) {
+    auto it = index_.find(line);
+    if (it != index_.end()) it->second->key = TileKey{};
+}
+
+void LineTileCache::release(const Tile& t) {
+    renderer_.destroy_texture(t.texture);
+    bytes_ -= static_cast<size_t>(t.w) * t.h * 4;
+}
+
+void LineTileCache::clear() {
+    for (const Tile& t : lru_) release(t);
+    lru_.clear();
+    index_.clear();
+}
+
+} // namespace sprawn
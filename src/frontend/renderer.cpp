@@ -7,16 +7,75 @@ namespace sprawn {
 
 Renderer::Renderer(SDL_Renderer* r) : r_(r) {}
 
+Renderer::~Renderer() {
+    if (canvas_) SDL_DestroyTexture(canvas_);
+}
+
+void Renderer::set_scale(float scale) {
+    scale_ = scale;
+    SDL_RenderSetScale(r_, scale_, scale_);
+}
+
+void Renderer::start_frame() {
+    frame_start_ = std::chrono::steady_clock::now();
+    stats_       = {};
+    clipped_     = false;
+    verts_.clear();
+    indices_.clear();
+    if (canvas_bound_) {
+        SDL_SetRenderTarget(r_, canvas_);
+        // SDL resets the scale when the target changes.
+        SDL_RenderSetScale(r_, scale_, scale_);
+    }
+}
+
 void Renderer::begin_frame(Color bg) {
+    int w = 0, h = 0;
+    SDL_GetRendererOutputSize(r_, &w, &h);
+    if (SDL_RenderTargetSupported(r_) && (w != canvas_w_ || h != canvas_h_ || !canvas_)) {
+        if (canvas_) SDL_DestroyTexture(canvas_);
+        canvas_ = w > 0 && h > 0
+            ? SDL_CreateTexture(r_, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_TARGET, w, h)
+            : nullptr;
+        canvas_w_ = w;
+        canvas_h_ = h;
+    }
+    canvas_bound_ = canvas_ != nullptr;
+    canvas_valid_ = false;
+    start_frame();
     SDL_SetRenderDrawColor(r_, bg.r, bg.g, bg.b, bg.a);
     SDL_RenderClear(r_);
 }
 
+bool Renderer::begin_partial_frame() {
+    if (!canvas_ || !canvas_valid_) return false;
+    int w = 0, h = 0;
+    SDL_GetRendererOutputSize(r_, &w, &h);
+    if (w != canvas_w_ || h != canvas_h_) return false;
+    canvas_bound_ = true;
+    start_frame();
+    return true;
+}
+
 void Renderer::fill_rect(Rect rect, Color c) {
-    SDL_SetRenderDrawBlendMode(r_, SDL_BLENDMODE_BLEND);
-    SDL_SetRenderDrawColor(r_, c.r, c.g, c.b, c.a);
-    SDL_Rect sdlr{rect.x, rect.y, rect.w, rect.h};
-    SDL_RenderFillRect(r_, &sdlr);
+    auto x0 = static_cast<float>(rect.x), y0 = static_cast<float>(rect.y);
+    auto x1 = x0 + static_cast<float>(rect.w), y1 = y0 + static_cast<float>(rect.h);
+    push_quad(solid_tex_, x0, y0, x1, y1, solid_u_, solid_v_, solid_u_, solid_v_, c);
+}
+
+void Renderer::set_solid_texel(TextureHandle tex, int x, int y) {
+    flush();
+    int w = 0, h = 0;
+    SDL_QueryTexture(tex, nullptr, nullptr, &w, &h);
+    if (!tex || w <= 0 || h <= 0) {
+        solid_tex_ = nullptr;
+        solid_u_ = solid_v_ = 0;
+        return;
+    }
+    // Centre of the texel, so filtering never reaches its neighbours.
+    solid_tex_ = tex;
+    solid_u_   = (static_cast<float>(x) + 0.5f) / static_cast<float>(w);
+    solid_v_   = (static_cast<float>(y) + 0.5f) / static_cast<float>(h);
 }
 
 TextureHandle Renderer::create_texture(int w, int h) {
@@ -32,26 +91,111 @@ TextureHandle Renderer::create_texture(int w, int h) {
     return tex;
 }
 
+TextureHandle Renderer::create_target(int w, int h) {
+    if (!SDL_RenderTargetSupported(r_)) return nullptr;
+    SDL_Texture* tex = SDL_CreateTexture(
+        r_, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    if (tex)
+        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_NONE);
+    return tex;
+}
+
+void Renderer::destroy_texture(TextureHandle tex) {
+    // Queued quads may still sample it.
+    flush();
+    if (size_tex_ == tex) size_tex_ = nullptr;
+    SDL_DestroyTexture(tex);
+}
+
+void Renderer::begin_target(TextureHandle target, Color bg) {
+    flush();
+    SDL_SetRenderTarget(r_, target);
+    SDL_RenderSetScale(r_, scale_, scale_);
+    SDL_RenderSetClipRect(r_, nullptr);
+    SDL_SetRenderDrawColor(r_, bg.r, bg.g, bg.b, bg.a);
+    SDL_RenderClear(r_);
+}
+
+void Renderer::end_target() {
+    flush();
+    SDL_SetRenderTarget(r_, canvas_bound_ ? canvas_ : nullptr);
+    SDL_RenderSetScale(r_, scale_, scale_);
+    if (clipped_) SDL_RenderSetClipRect(r_, &clip_);
+}
+
 void Renderer::update_texture(TextureHandle tex, const void* pixels, int pitch) {
+    flush();
     SDL_UpdateTexture(tex, nullptr, pixels, pitch);
 }
 
 void Renderer::blit(TextureHandle tex, SDL_Rect src, SDL_Rect dst, Color tint) {
-    SDL_SetTextureColorMod(tex, tint.r, tint.g, tint.b);
-    SDL_SetTextureAlphaMod(tex, tint.a);
-    SDL_RenderCopy(r_, tex, &src, &dst);
+    if (tex != size_tex_) {
+        int w = 1, h = 1;
+        SDL_QueryTexture(tex, nullptr, nullptr, &w, &h);
+        size_tex_ = tex;
+        inv_w_    = 1.0f / static_cast<float>(w > 0 ? w : 1);
+        inv_h_    = 1.0f / static_cast<float>(h > 0 ? h : 1);
+    }
+    push_quad(tex,
+              static_cast<float>(dst.x), static_cast<float>(dst.y),
+              static_cast<float>(dst.x + dst.w), static_cast<float>(dst.y + dst.h),
+              static_cast<float>(src.x) * inv_w_, static_cast<float>(src.y) * inv_h_,
+              static_cast<float>(src.x + src.w) * inv_w_, static_cast<float>(src.y + src.h) * inv_h_,
+              tint);
+}
+
+void Renderer::push_quad(TextureHandle tex, float x0, float y0, float x1, float y1,
+                         float u0, float v0, float u1, float v1, Color c) {
+    if (tex != batch_tex_) {
+        flush();
+        batch_tex_ = tex;
+    }
+    int base = static_cast<int>(verts_.size());
+    SDL_Color col{c.r, c.g, c.b, c.a};
+    verts_.push_back({{x0, y0}, col, {u0, v0}});
+    verts_.push_back({{x1, y0}, col, {u1, v0}});
+    verts_.push_back({{x1, y1}, col, {u1, v1}});
+    verts_.push_back({{x0, y1}, col, {u0, v1}});
+    indices_.insert(indices_.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+    ++stats_.quads;
+}
+
+void Renderer::flush() {
+    if (verts_.empty()) return;
+    if (pre_flush_) pre_flush_();
+    SDL_RenderGeometry(r_, batch_tex_, verts_.data(), static_cast<int>(verts_.size()),
+                       indices_.data(), static_cast<int>(indices_.size()));
+    ++stats_.draw_calls;
+    verts_.clear();
+    indices_.clear();
 }
 
 void Renderer::set_clip(SDL_Rect r) {
+    flush();
+    clip_    = r;
+    clipped_ = true;
     SDL_RenderSetClipRect(r_, &r);
 }
 
 void Renderer::clear_clip() {
+    flush();
+    clipped_ = false;
     SDL_RenderSetClipRect(r_, nullptr);
 }
 
 void Renderer::end_frame() {
-    // Nothing needed here; Window::present() calls SDL_RenderPresent.
+    // Window::present() calls SDL_RenderPresent.
+    flush();
+    if (canvas_bound_) {
+        SDL_SetRenderTarget(r_, nullptr);
+        SDL_RenderSetScale(r_, scale_, scale_);
+        SDL_RenderCopy(r_, canvas_, nullptr, nullptr);
+        canvas_bound_ = false;
+        canvas_valid_ = true;
+    }
+    stats_.cpu_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - frame_start_).count();
+    last_stats_ = stats_;
 }
 
 } // namespace sprawn
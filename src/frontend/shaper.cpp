@@ -0,0 +1,192 @@
+#include "shaper.h"
+
+#include <hb-ot.h>
+
+#include <cstring>
+
+namespace sprawn {
+
+namespace {
+
+// The calling thread's HarfBuzz buffer, emptied.
+hb_buffer_t* thread_buffer() {
+    struct Holder {
+        hb_buffer_t* buf = hb_buffer_create();
+        ~Holder() { hb_buffer_destroy(buf); }
+    };
+    thread_local Holder holder;
+    hb_buffer_clear_contents(holder.buf);
+    return holder.buf;
+}
+
+// True if the font's space glyph appears anywhere in its GSUB or GPOS
+// lookups, as input or as context.
+bool space_in_lookups(hb_font_t* font) {
+    hb_codepoint_t space = 0;
+    if (!hb_font_get_nominal_glyph(font, ' ', &space)) return true;
+    hb_face_t* face = hb_font_get_face(font);
+    hb_set_t*  glyphs = hb_set_create();
+    bool found = false;
+    for (hb_tag_t table : {HB_OT_TAG_GSUB, HB_OT_TAG_GPOS}) {
+        unsigned count = hb_ot_layout_table_get_lookup_count(face, table);
+        for (unsigned i = 0; i < count && !found; ++i) {
+            hb_set_clear(glyphs);
+            hb_ot_layout_lookup_collect_glyphs(face, table, i, glyphs, glyphs, glyphs, nullptr);
+            found = hb_set_has(glyphs, space);
+        }
+    }
+    hb_set_destroy(glyphs);
+    return found;
+}
+
+} // namespace
+
+Shaper::Shaper(FontChain& fonts) : fonts_(fonts) {}
+
+Shaper::~Shaper() {
+    for (Plan& p : plans_) hb_shape_plan_destroy(p.plan);
+}
+
+void Shaper::reset() {
+    for (Plan& p : plans_) hb_shape_plan_destroy(p.plan);
+    plans_.clear();
+    word_safe_.clear();
+    words_.clear();
+    old_words_.clear();
+}
+
+hb_shape_plan_t* Shaper::plan_for(uint8_t font_index, const hb_segment_properties_t& props) {
+    for (const Plan& p : plans_)
+        if (p.font == font_index && hb_segment_properties_equal(&p.props, &props))
+            return p.plan;
+    hb_face_t* face = hb_font_get_face(fonts_.font(font_index).hb_font());
+    hb_shape_plan_t* plan = hb_shape_plan_create_cached(face, &props, nullptr, 0, nullptr);
+    plans_.push_back({font_index, props, plan});
+    return plan;
+}
+
+bool Shaper::word_safe(uint8_t font_index) {
+    if (word_safe_.size() < fonts_.count()) word_safe_.resize(fonts_.count(), -1);
+    int8_t& safe = word_safe_[font_index];
+    if (safe < 0) safe = space_in_lookups(fonts_.font(font_index).hb_font()) ? 0 : 1;
+    return safe == 1;
+}
+
+void Shaper::execute(uint8_t font_index, hb_buffer_t* buf, const hb_segment_properties_t& props,
+                     uint32_t cluster_base, std::vector<ShapedGlyph>& out)
+{
+    hb_shape_plan_execute(plan_for(font_index, props), fonts_.font(font_index).hb_font(),
+                          buf, nullptr, 0);
+    unsigned count = 0;
+    hb_glyph_info_t*     infos = hb_buffer_get_glyph_infos(buf, &count);
+    hb_glyph_position_t* pos   = hb_buffer_get_glyph_positions(buf, &count);
+    out.reserve(out.size() + count);
+    for (unsigned i = 0; i < count; ++i)
+        out.push_back({infos[i].codepoint, cluster_base + infos[i].cluster,
+                       pos[i].x_advance, pos[i].x_offset, pos[i].y_offset});
+}
+
+void Shaper::shape_word(uint8_t font_index, std::string_view text, int start, int length,
+                        const hb_segment_properties_t& props, std::vector<ShapedGlyph>& out)
+{
+    // Shaped without the surrounding text as context, so the result is the
+    // same wherever the word appears.
+    auto shape_alone = [&](std::vector<ShapedGlyph>& dst, uint32_t base) {
+        hb_buffer_t* buf = thread_buffer();
+        hb_buffer_add_utf8(buf, text.data() + start, length, 0, length);
+        hb_buffer_set_segment_properties(buf, &props);
+        execute(font_index, buf, props, base, dst);
+    };
+    if (static_cast<size_t>(length) > kMaxWordBytes) {
+        ++direct_;
+        shape_alone(out, static_cast<uint32_t>(start));
+        return;
+    }
+
+    key_.clear();
+    key_.push_back(static_cast<char>(font_index));
+    key_.push_back(static_cast<char>(props.direction));
+    char script[sizeof(props.script)];
+    std::memcpy(script, &props.script, sizeof(script));
+    key_.append(script, sizeof(script));
+    key_.append(text.data() + start, static_cast<size_t>(length));
+
+    auto it = words_.find(key_);
+    if (it == words_.end()) {
+        auto old = old_words_.find(key_);
+        if (old != old_words_.end()) {
+            it = words_.emplace(key_, std::move(old->second)).first;
+            old_words_.erase(old);
+        }
+    }
+    if (it != words_.end()) {
+        ++hits_;
+    } else {
+        ++misses_;
+        if (words_.size() >= kGenerationWords) {
+            old_words_.swap(words_);
+            words_.clear();
+        }
+        it = words_.emplace(key_, std::vector<ShapedGlyph>()).first;
+        shape_alone(it->second, 0);
+    }
+    for (const ShapedGlyph& g : it->second) {
+        out.push_back(g);
+        out.back().cluster += static_cast<uint32_t>(start);
+    }
+}
+
+void Shaper::shape(uint8_t font_index, std::string_view text, int start, int length,
+                   hb_direction_t direction, std::vector<ShapedGlyph>& out)
+{
+    hb_buffer_t* buf = thread_buffer();
+    hb_buffer_add_utf8(buf, text.data(), static_cast<int>(text.size()), start, length);
+    hb_buffer_set_direction(buf, direction);
+    hb_buffer_guess_segment_properties(buf);
+    hb_segment_properties_t props;
+    hb_buffer_get_segment_properties(buf, &props);
+
+    if (!word_safe(font_index)) {
+        ++direct_;
+        execute(font_index, buf, props, 0, out);
+        return;
+    }
+
+    // Words and runs of spaces, each shaped (or found) on its own. RTL
+    // output is in visual order, so the pieces are appended last first.
+    struct Piece { int start, length; };
+    thread_local std::vector<Piece> pieces;
+    pieces.clear();
+    int end = start + length;
+    for (int i = start; i < end;) {
+        bool space = text[i] == ' ';
+        int j = i + 1;
+        while (j < end && (text[j] == ' ') == space) ++j;
+        pieces.push_back({i, j - i});
+        i = j;
+    }
+    if (direction == HB_DIRECTION_RTL) {
+        for (size_t k = pieces.size(); k-- > 0;)
+            shape_word(font_index, text, pieces[k].start, pieces[k].length, props, out);
+    } else {
+        for (const Piece& p : pieces)
+            shape_word(font_index, text, p.start, p.length, props, out);
+    }
+}
+
+ShapeStats Shaper::stats() const {
+    return {words_.size() + old_words_.size(), hits_, misses_, direct_};
+}
+
+size_t Shaper::memory_usage() const {
+    size_t bytes = plans_.capacity() * sizeof(Plan) + key_.capacity();
+    for (const WordMap* m : {&words_, &old_words_}) {
+        bytes += m->bucket_count() * sizeof(void*);
+        for (const auto& [k, v] : *m)
+            bytes += sizeof(k) + sizeof(v) + 2 * sizeof(void*)
+                   + k.capacity() + v.capacity() * sizeof(ShapedGlyph);
+    }
+    return bytes;
+}
+
+} // namespace sprawn
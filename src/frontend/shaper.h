@@ -0,0 +1,92 @@
+#pragma once
+
+#include "font_chain.h"
+
+#include <hb.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sprawn {
+
+// One glyph as HarfBuzz positions it (26.6 fixed point).
+struct ShapedGlyph {
+    uint32_t      glyph_id;  // 0: .notdef
+    uint32_t      cluster;   // byte offset in the shaped text
+    hb_position_t x_advance;
+    hb_position_t x_offset;
+    hb_position_t y_offset;
+};
+
+struct ShapeStats {
+    size_t words{0};   // cached
+    size_t hits{0};
+    size_t misses{0};
+    size_t direct{0};  // runs or words shaped without the cache
+};
+
+// HarfBuzz shaping with a word cache. Runs are cut at spaces and each
+// word is looked up by (font, direction, script, bytes), so a line full of
+// identifiers seen before is shaped by concatenating cached glyphs. That
+// is exact only when the font's space glyph takes part in no GSUB or GPOS
+// lookup — nothing can then reach across a space — which is checked per
+// font; other fonts shape whole runs. Either way the HarfBuzz buffer is
+// reused (one per thread) and shape plans are kept per font and segment
+// properties.
+class Shaper {
+public:
+    explicit Shaper(FontChain& fonts);
+    ~Shaper();
+
+    Shaper(const Shaper&) = delete;
+    Shaper& operator=(const Shaper&) = delete;
+
+    // Shapes text[start, start + length) with font `font_index`, appending
+    // the glyphs in visual order; clusters are byte offsets into `text`.
+    void shape(uint8_t font_index, std::string_view text, int start, int length,
+               hb_direction_t direction, std::vector<ShapedGlyph>& out);
+
+    // Drops plans and cached words (after the fonts were rebuilt).
+    void reset();
+
+    ShapeStats stats() const;
+    size_t     memory_usage() const;
+
+    // Longer words are shaped every time rather than cached.
+    static constexpr size_t kMaxWordBytes = 64;
+    // Words per cache generation. A full generation becomes the old one
+    // and the previous old one is dropped; hits in the old generation move
+    // back to the current one.
+    static constexpr size_t kGenerationWords = 8192;
+
+private:
+    struct Plan {
+        uint8_t                 font;
+        hb_segment_properties_t props;
+        hb_shape_plan_t*        plan;
+    };
+    using WordMap = std::unordered_map<std::string, std::vector<ShapedGlyph>>;
+
+    hb_shape_plan_t* plan_for(uint8_t font_index, const hb_segment_properties_t& props);
+    // True if words may be shaped on their own with this font.
+    bool word_safe(uint8_t font_index);
+    // Shapes what was added to `buf` and appends it with clusters moved
+    // by `cluster_base`.
+    void execute(uint8_t font_index, hb_buffer_t* buf, const hb_segment_properties_t& props,
+                 uint32_t cluster_base, std::vector<ShapedGlyph>& out);
+    void shape_word(uint8_t font_index, std::string_view text, int start, int length,
+                    const hb_segment_properties_t& props, std::vector<ShapedGlyph>& out);
+
+    FontChain&          fonts_;
+    std::vector<Plan>   plans_;
+    std::vector<int8_t> word_safe_;  // per font: -1 not checked yet
+    WordMap             words_, old_words_;
+    std::string         key_;
+    size_t hits_{0}, misses_{0}, direct_{0};
+};
+
+} // namespace sprawn
@@ -0,0 +1,166 @@
+#include "shaping_pool.h"
+#include "shaper.h"
+
+#include <sprawn/worker_pool.h>
+
+#include <algorithm>
+#include <exception>
+#include <system_error>
+#include <utility>
+
+namespace sprawn {
+
+ShapingPool::ShapingPool(WorkerPool& pool, GlyphAtlas& atlas,
+                         std::vector<std::filesystem::path> paths, int size_px, float dpi_scale)
+    : pool_(pool)
+    , atlas_(atlas)
+    , paths_(std::move(paths))
+    , max_tasks_(std::max<size_t>(pool.concurrency() - 1, 1))
+    , size_px_(size_px)
+    , dpi_scale_(dpi_scale)
+{
+    for (const auto& path : paths_) {
+        std::error_code ec;
+        auto bytes = std::filesystem::file_size(path, ec);
+        if (!ec) font_bytes_ += static_cast<size_t>(bytes);
+    }
+}
+
+ShapingPool::~ShapingPool() {
+    std::unique_lock lock(mutex_);
+    queue_.clear();
+    idle_.wait(lock, [this] { return running_ == 0; });
+}
+
+std::unique_ptr<ShapingPool::Context> ShapingPool::acquire() {
+    std::unique_ptr<Context> ctx;
+    int   size;
+    float scale;
+    {
+        std::lock_guard lock(mutex_);
+        size  = size_px_;
+        scale = dpi_scale_;
+        if (!spare_.empty()) {
+            ctx = std::move(spare_.back());
+            spare_.pop_back();
+        }
+    }
+    if (!ctx && !paths_.empty()) {
+        try {
+            ctx = std::make_unique<Context>();
+            ctx->fonts = std::make_unique<FontChain>(paths_.front(), size);
+            for (size_t i = 1; i < paths_.size(); ++i) ctx->fonts->add_fallback(paths_[i]);
+            ctx->layout    = std::make_unique<TextLayout>(atlas_, *ctx->fonts, scale);
+            ctx->size_px   = size;
+            ctx->dpi_scale = scale;
+        } catch (const std::exception&) {
+            return nullptr;
+        }
+    }
+    if (ctx) resize(*ctx, size, scale);
+    return ctx;
+}
+
+void ShapingPool::resize(Context& ctx, int size_px, float dpi_scale) {
+    if (ctx.size_px == size_px && ctx.dpi_scale == dpi_scale) return;
+    ctx.fonts->rebuild(size_px);
+    ctx.layout->reset(dpi_scale);
+    ctx.size_px   = size_px;
+    ctx.dpi_scale = dpi_scale;
+}
+
+void ShapingPool::release(std::unique_ptr<Context> ctx) {
+    if (!ctx) return;
+    std::lock_guard lock(mutex_);
+    spare_.push_back(std::move(ctx));
+}
+
+void ShapingPool::shape(std::vector<Job>& jobs) {
+    // One task per thread, each taking every tasks-th job, so a context is
+    // acquired once per task rather than once per line.
+    size_t tasks = std::min(jobs.size(), pool_.concurrency());
+    pool_.parallel_for(tasks, [&](size_t t) {
+        std::unique_ptr<Context> ctx = acquire();
+        if (!ctx) return;
+        for (size_t i = t; i < jobs.size(); i += tasks) {
+            jobs[i].run    = ctx->layout->shape_line(jobs[i].text, jobs[i].max_width_px);
+            jobs[i].shaped = true;
+        }
+        release(std::move(ctx));
+    });
+}
+
+void ShapingPool::prefetch(std::vector<Job> jobs) {
+    size_t start;
+    {
+        std::lock_guard lock(mutex_);
+        queue_.clear();
+        for (Job& j : jobs) queue_.push_back(std::move(j));
+        start = std::min(queue_.size(), max_tasks_ > running_ ? max_tasks_ - running_ : 0);
+        running_ += start;
+    }
+    for (size_t i = 0; i < start; ++i) pool_.submit([this] { run(); });
+}
+
+void ShapingPool::run() {
+    std::unique_ptr<Context> ctx = acquire();
+    std::unique_lock lock(mutex_);
+    // Without fonts there is nothing to shape with: the editor shapes
+    // these lines itself when they come into view.
+    if (!ctx) queue_.clear();
+    while (!queue_.empty()) {
+        Job job = std::move(queue_.front());
+        queue_.pop_front();
+        uint64_t epoch = epoch_;
+        int      size  = size_px_;
+        float    scale = dpi_scale_;
+        lock.unlock();
+
+        // reset() may have come in since the context was acquired.
+        resize(*ctx, size, scale);
+        job.run    = ctx->layout->shape_line(job.text, job.max_width_px);
+        job.shaped = true;
+
+        lock.lock();
+        if (epoch == epoch_) done_.push_back(std::move(job));
+    }
+    if (ctx) spare_.push_back(std::move(ctx));
+    --running_;
+    idle_.notify_all();
+}
+
+void ShapingPool::take(std::vector<Job>& out) {
+    std::lock_guard lock(mutex_);
+    for (Job& j : done_) out.push_back(std::move(j));
+    done_.clear();
+}
+
+bool ShapingPool::busy() const {
+    std::lock_guard lock(mutex_);
+    return running_ > 0 || !queue_.empty() || !done_.empty();
+}
+
+size_t ShapingPool::memory_usage() const {
+    std::lock_guard lock(mutex_);
+    size_t bytes = spare_.capacity() * sizeof(std::unique_ptr<Context>);
+    for (const auto& ctx : spare_)
+        bytes += sizeof(Context) + font_bytes_ + ctx->fonts->coverage_bytes()
+               + ctx->layout->shaper().memory_usage();
+    auto job_bytes = [](const Job& j) {
+        return sizeof(Job) + j.text.capacity() + j.run.glyphs.capacity() * sizeof(GlyphEntry);
+    };
+    for (const Job& j : queue_) bytes += job_bytes(j);
+    for (const Job& j : done_)  bytes += job_bytes(j);
+    return bytes;
+}
+
+void ShapingPool::reset(int size_px, float dpi_scale) {
+    std::lock_guard lock(mutex_);
+    ++epoch_;
+    size_px_   = size_px;
+    dpi_scale_ = dpi_scale;
+    queue_.clear();
+    done_.clear();
+}
+
+} // namespace sprawn
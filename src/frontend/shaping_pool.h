@@ -0,0 +1,99 @@
+#pragma once
+
+#include "font_chain.h"
+#include <sprawn/frontend/text_layout.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sprawn {
+
+class GlyphAtlas;
+class WorkerPool;
+
+// Shapes lines on worker threads. HarfBuzz fonts and FreeType faces must
+// not be shared between threads, so every concurrently running task
+// shapes with its own FontChain and TextLayout, opened from the editor's
+// font files and reused (rebuilt at the new size after a zoom) by later
+// tasks. The results are the runs the editor's own TextLayout would
+// produce, ready for its LineCache.
+class ShapingPool {
+public:
+    struct Job {
+        uint64_t    version;       // Controller::line_version(), the LineCache key
+        std::string text;
+        int         max_width_px;  // as for TextLayout::shape_line()
+        GlyphRun    run{};         // filled in
+        bool        shaped{false}; // false if the fonts could not be opened
+    };
+
+    // `atlas` is only handed to the contexts' TextLayouts, which never
+    // touch it for shaping.
+    ShapingPool(WorkerPool& pool, GlyphAtlas& atlas,
+                std::vector<std::filesystem::path> paths, int size_px, float dpi_scale);
+    // Drops queued jobs and waits for the ones being shaped.
+    ~ShapingPool();
+
+    ShapingPool(const ShapingPool&) = delete;
+    ShapingPool& operator=(const ShapingPool&) = delete;
+
+    // Shapes every job on the pool and the calling thread; returns when
+    // all are done.
+    void shape(std::vector<Job>& jobs);
+
+    // Replaces the speculative jobs still queued with `jobs`, shaped in
+    // order in the background; take() moves out the finished ones.
+    void prefetch(std::vector<Job> jobs);
+    void take(std::vector<Job>& out);
+    // True while speculative jobs are queued, running or not yet taken.
+    bool busy() const;
+
+    // Drops queued and finished jobs; later jobs are shaped at the new
+    // size. Jobs still running are discarded when they finish.
+    void reset(int size_px, float dpi_scale);
+
+    // Bytes held by the idle contexts (font files, coverage and word
+    // caches) and by queued and finished jobs. Contexts being used by a
+    // running task are left out.
+    size_t memory_usage() const;
+
+private:
+    struct Context {
+        std::unique_ptr<FontChain>  fonts;
+        std::unique_ptr<TextLayout> layout;
+        int   size_px{0};
+        float dpi_scale{0};
+    };
+
+    // A context at the current size: a spare one, or a new one. nullptr
+    // if the primary font cannot be opened.
+    std::unique_ptr<Context> acquire();
+    void release(std::unique_ptr<Context> ctx);
+    static void resize(Context& ctx, int size_px, float dpi_scale);
+    void run();
+
+    WorkerPool& pool_;
+    GlyphAtlas& atlas_;
+    const std::vector<std::filesystem::path> paths_;
+    size_t font_bytes_{0};  // sizes of the font files, mapped by every context
+    size_t max_tasks_;
+
+    mutable std::mutex      mutex_;
+    std::condition_variable idle_;
+    std::deque<Job>         queue_;
+    std::vector<Job>        done_;
+    std::vector<std::unique_ptr<Context>> spare_;
+    size_t   running_{0};
+    uint64_t epoch_{0};
+    int      size_px_;
+    float    dpi_scale_;
+};
+
+} // namespace sprawn
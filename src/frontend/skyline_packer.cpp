@@ -0,0 +1,79 @@
+#include <sprawn/frontend/skyline_packer.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+
+namespace sprawn {
+
+SkylinePacker::SkylinePacker(int w, int h) : width_(w), height_(h) {
+    reset();
+}
+
+void SkylinePacker::reset() {
+    skyline_.assign(1, Segment{0, 0, width_});
+    used_area_ = 0;
+}
+
+double SkylinePacker::occupancy() const {
+    return static_cast<double>(used_area_) / (static_cast<double>(width_) * height_);
+}
+
+int SkylinePacker::fit(size_t i, int w, int h) const {
+    if (skyline_[i].x + w > width_) return -1;
+    int y    = 0;
+    int left = w;
+    for (size_t j = i; left > 0; ++j) {
+        y = std::max(y, skyline_[j].y);
+        if (y + h > height_) return -1;
+        left -= skyline_[j].w;
+    }
+    return y;
+}
+
+bool SkylinePacker::insert(int w, int h, int& out_x, int& out_y) {
+    // Lowest top edge, then narrowest segment to keep wide gaps for wide
+    // rectangles.
+    size_t best   = skyline_.size();
+    int    best_y = INT_MAX;
+    int    best_w = INT_MAX;
+    for (size_t i = 0; i < skyline_.size(); ++i) {
+        int y = fit(i, w, h);
+        if (y < 0) continue;
+        if (y + h < best_y || (y + h == best_y && skyline_[i].w < best_w)) {
+            best   = i;
+            best_y = y + h;
+            best_w = skyline_[i].w;
+        }
+    }
+    if (best == skyline_.size()) return false;
+
+    out_x = skyline_[best].x;
+    out_y = best_y - h;
+    skyline_.insert(skyline_.begin() + static_cast<std::ptrdiff_t>(best),
+                    Segment{out_x, best_y, w});
+
+    // Trim the segments now under the new one.
+    for (size_t j = best + 1; j < skyline_.size();) {
+        const Segment& prev = skyline_[j - 1];
+        int overlap = prev.x + prev.w - skyline_[j].x;
+        if (overlap <= 0) break;
+        skyline_[j].x += overlap;
+        skyline_[j].w -= overlap;
+        if (skyline_[j].w > 0) break;
+        skyline_.erase(skyline_.begin() + static_cast<std::ptrdiff_t>(j));
+    }
+    // Merge neighbours at the same height.
+    for (size_t j = 1; j < skyline_.size();) {
+        if (skyline_[j - 1].y == skyline_[j].y) {
+            skyline_[j - 1].w += skyline_[j].w;
+            skyline_.erase(skyline_.begin() + static_cast<std::ptrdiff_t>(j));
+        } else {
+            ++j;
+        }
+    }
+    used_area_ += static_cast<size_t>(w) * h;
+    return true;
+}
+
+} // namespace sprawn
@@ -1,22 +1,56 @@
 #include <sprawn/frontend/text_layout.h>
 #include "font_chain.h"
 #include "glyph_atlas.h"
+#include "shaper.h"
 
 #include <hb.h>
+#include <hb-ot.h>
 #include <unicode/ubidi.h>
 #include <unicode/ustring.h>
 
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <string_view>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPRAWN_LAYOUT_SSE2 1
+#include <emmintrin.h>
+#endif
+
 namespace sprawn {
 
 namespace {
 
+// True if every byte is below 0x80, 16 bytes per step with SSE2.
+bool is_ascii(std::string_view s) {
+    const char* p = s.data();
+    size_t n = s.size();
+    size_t i = 0;
+#ifdef SPRAWN_LAYOUT_SSE2
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        if (_mm_movemask_epi8(v) != 0) return false;
+    }
+#endif
+    for (; i < n; ++i)
+        if (static_cast<uint8_t>(p[i]) >= 0x80) return false;
+    return true;
+}
+
+// OpenType features HarfBuzz applies by default that could move or merge
+// ASCII glyphs.
+constexpr hb_tag_t kGsubFeatures[] = {
+    HB_TAG('l','i','g','a'), HB_TAG('c','l','i','g'),
+    HB_TAG('c','a','l','t'), HB_TAG('r','l','i','g'),
+};
+constexpr hb_tag_t kGposFeatures[] = {
+    HB_TAG('k','e','r','n'), HB_TAG('d','i','s','t'),
+};
+
 // Convert a byte offset in a UTF-8 string to a codepoint (column) index.
 size_t byte_offset_to_col(std::string_view utf8, int byte_off) {
     size_t col = 0;
@@ -63,7 +97,7 @@ bool might_need_bidi(std::string_view utf8) {
 
 // Shape a single directional run with HarfBuzz and append results to out.
 // If max_width_px > 0, stop shaping when x_accum exceeds it. Returns true if truncated.
-bool shape_run(FontChain& fonts, GlyphAtlas& /*atlas*/,
+bool shape_run(FontChain& fonts, Shaper& shaper,
                std::string_view utf8,     // full line
                int run_start,             // byte offset of run in utf8
                int run_length,            // byte length
@@ -72,17 +106,11 @@ bool shape_run(FontChain& fonts, GlyphAtlas& /*atlas*/,
                std::vector<GlyphEntry>& out,
                int max_width_px = 0)
 {
-    hb_buffer_t* buf = hb_buffer_create();
-    hb_buffer_add_utf8(buf, utf8.data(), static_cast<int>(utf8.size()),
-                       run_start, run_length);
-    hb_buffer_set_direction(buf, direction);
-    hb_buffer_guess_segment_properties(buf);
-
-    hb_shape(fonts.primary().hb_font(), buf, nullptr, 0);
-
-    unsigned glyph_count = 0;
-    hb_glyph_info_t*     infos = hb_buffer_get_glyph_infos(buf, &glyph_count);
-    hb_glyph_position_t* pos   = hb_buffer_get_glyph_positions(buf, &glyph_count);
+    thread_local std::vector<ShapedGlyph> shaped, fb_shaped;
+    shaped.clear();
+    shaper.shape(0, utf8, run_start, run_length, direction, shaped);
+    const ShapedGlyph* infos = shaped.data();
+    unsigned glyph_count = static_cast<unsigned>(shaped.size());
 
     // Decode the codepoint at a given byte position in utf8.
     auto decode_cp = [&](int byte_pos) -> uint32_t {
@@ -115,7 +143,7 @@ bool shape_run(FontChain& fonts, GlyphAtlas& /*atlas*/,
     struct Segment {
         enum Kind { Primary, Fallback };
         Kind kind;
-        unsigned start;  // index into infos/pos arrays
+        unsigned start;  // index into shaped
         unsigned count;
         uint8_t font_index;  // only for Fallback
     };
@@ -123,7 +151,7 @@ bool shape_run(FontChain& fonts, GlyphAtlas& /*atlas*/,
 
     unsigned i = 0;
     while (i < glyph_count) {
-        if (infos[i].codepoint == 0) {
+        if (infos[i].glyph_id == 0) {
             // .notdef — resolve fallback font for this glyph
             int cluster_byte = static_cast<int>(infos[i].cluster);
             uint32_t cp = decode_cp(cluster_byte);
@@ -135,7 +163,7 @@ bool shape_run(FontChain& fonts, GlyphAtlas& /*atlas*/,
                 unsigned run_start_idx = i;
                 uint8_t run_font = fi;
                 ++i;
-                while (i < glyph_count && infos[i].codepoint == 0) {
+                while (i < glyph_count && infos[i].glyph_id == 0) {
                     int cb = static_cast<int>(infos[i].cluster);
                     uint32_t cp2 = decode_cp(cb);
                     auto [fi2, gid2] = fonts.resolve(cp2);
@@ -153,7 +181,7 @@ bool shape_run(FontChain& fonts, GlyphAtlas& /*atlas*/,
             // Primary glyph — group consecutive primary glyphs
             unsigned run_start_idx = i;
             ++i;
-            while (i < glyph_count && infos[i].codepoint != 0)
+            while (i < glyph_count && infos[i].glyph_id != 0)
                 ++i;
             segments.push_back({Segment::Primary, run_start_idx,
                                 i - run_start_idx, 0});
@@ -165,18 +193,16 @@ bool shape_run(FontChain& fonts, GlyphAtlas& /*atlas*/,
         if (seg.kind == Segment::Primary) {
             for (unsigned j = seg.start; j < seg.start + seg.count; ++j) {
                 GlyphEntry ge;
-                ge.glyph_id   = infos[j].codepoint;
+                ge.glyph_id   = infos[j].glyph_id;
                 ge.font_index = 0;
-                ge.x          = x_accum + (pos[j].x_offset >> 6);
-                ge.y_offset   = pos[j].y_offset >> 6;
+                ge.x          = x_accum + (infos[j].x_offset >> 6);
+                ge.y_offset   = infos[j].y_offset >> 6;
                 ge.cluster    = static_cast<int>(infos[j].cluster);
                 out.push_back(ge);
-                x_accum += pos[j].x_advance >> 6;
+                x_accum += infos[j].x_advance >> 6;
 
-                if (max_width_px > 0 && x_accum > max_width_px) {
-                    hb_buffer_destroy(buf);
+                if (max_width_px > 0 && x_accum > max_width_px)
                     return true;
-                }
             }
         } else {
             // Fallback run: re-shape the entire byte range as one HarfBuzz buffer
@@ -197,34 +223,23 @@ bool shape_run(FontChain& fonts, GlyphAtlas& /*atlas*/,
             int fb_len = fb_byte_end - fb_byte_start;
             if (fb_len <= 0) fb_len = 1;
 
-            hb_buffer_t* fb_buf = hb_buffer_create();
-            hb_buffer_add_utf8(fb_buf, utf8.data(), static_cast<int>(utf8.size()),
-                               fb_byte_start, fb_len);
-            hb_buffer_set_direction(fb_buf, direction);
-            hb_buffer_guess_segment_properties(fb_buf);
-            hb_shape(fonts.font(seg.font_index).hb_font(), fb_buf, nullptr, 0);
-
-            unsigned fb_count = 0;
-            hb_glyph_info_t*     fb_infos = hb_buffer_get_glyph_infos(fb_buf, &fb_count);
-            hb_glyph_position_t* fb_pos   = hb_buffer_get_glyph_positions(fb_buf, &fb_count);
+            fb_shaped.clear();
+            shaper.shape(seg.font_index, utf8, fb_byte_start, fb_len, direction, fb_shaped);
 
             double scale = fonts.font(seg.font_index).bitmap_scale();
-            for (unsigned j = 0; j < fb_count; ++j) {
+            for (const ShapedGlyph& g : fb_shaped) {
                 GlyphEntry ge;
-                ge.glyph_id   = fb_infos[j].codepoint;
+                ge.glyph_id   = g.glyph_id;
                 ge.font_index = seg.font_index;
-                ge.x          = x_accum + static_cast<int>((fb_pos[j].x_offset >> 6) * scale);
-                ge.y_offset   = static_cast<int>((fb_pos[j].y_offset >> 6) * scale);
-                ge.cluster    = static_cast<int>(fb_infos[j].cluster);
+                ge.x          = x_accum + static_cast<int>((g.x_offset >> 6) * scale);
+                ge.y_offset   = static_cast<int>((g.y_offset >> 6) * scale);
+                ge.cluster    = static_cast<int>(g.cluster);
                 out.push_back(ge);
-                x_accum += static_cast<int>((fb_pos[j].x_advance >> 6) * scale);
+                x_accum += static_cast<int>((g.x_advance >> 6) * scale);
             }
-
-            hb_buffer_destroy(fb_buf);
         }
     }
 
-    hb_buffer_destroy(buf);
     return false;
 }
 
@@ -233,18 +248,105 @@ bool shape_run(FontChain& fonts, GlyphAtlas& /*atlas*/,
 TextLayout::TextLayout(GlyphAtlas& atlas, FontChain& fonts, float dpi_scale)
     : atlas_(atlas), fonts_(fonts), dpi_scale_(dpi_scale),
       line_height_(static_cast<int>(fonts.line_height() / dpi_scale + 0.5f)),
-      ascent_(static_cast<int>(fonts.ascent() / dpi_scale + 0.5f))
-{}
+      ascent_(static_cast<int>(fonts.ascent() / dpi_scale + 0.5f)),
+      shaper_(std::make_unique<Shaper>(fonts))
+{
+    build_ascii_table();
+    build_digit_table();
+}
+
+TextLayout::~TextLayout() = default;
 
 void TextLayout::reset(float dpi_scale) {
     dpi_scale_ = dpi_scale;
     line_height_ = static_cast<int>(fonts_.line_height() / dpi_scale_ + 0.5f);
     ascent_ = static_cast<int>(fonts_.ascent() / dpi_scale_ + 0.5f);
+    shaper_->reset();
+    build_ascii_table();
+    build_digit_table();
+}
+
+void TextLayout::set_ascii_path(bool enabled) {
+    ascii_enabled_ = enabled;
+    build_ascii_table();
+}
+
+void TextLayout::build_digit_table() {
+    digits_.clear();
+    std::vector<GlyphEntry> digits;
+    for (int d = 0; d < 10; ++d) {
+        char c = static_cast<char>('0' + d);
+        GlyphRun run = shape_line(std::string_view(&c, 1));
+        if (run.glyphs.size() != 1) return;
+        digits.push_back(run.glyphs.front());
+        digit_advance_[d] = run.total_width;
+    }
+    digits_ = std::move(digits);
+}
+
+void TextLayout::build_ascii_table() {
+    ascii_glyphs_.fill(0);
+    ascii_advance_ = 0;
+    if (!ascii_enabled_) return;
+
+    hb_font_t* font = fonts_.primary().hb_font();
+    hb_face_t* face = hb_font_get_face(font);
+    unsigned index;
+    for (hb_tag_t tag : kGsubFeatures)
+        if (hb_ot_layout_table_find_feature(face, HB_OT_TAG_GSUB, tag, &index)) return;
+    for (hb_tag_t tag : kGposFeatures)
+        if (hb_ot_layout_table_find_feature(face, HB_OT_TAG_GPOS, tag, &index)) return;
+
+    // Printable characters only: control bytes (tabs included) go through
+    // HarfBuzz and the fallback fonts as before.
+    std::array<uint32_t, 128> glyphs{};
+    hb_position_t advance = 0;
+    for (uint32_t cp = 0x20; cp < 0x7F; ++cp) {
+        hb_codepoint_t gid = 0;
+        if (!hb_font_get_nominal_glyph(font, cp, &gid) || gid == 0) continue;
+        hb_position_t adv = hb_font_get_glyph_h_advance(font, gid);
+        if (advance == 0) advance = adv;
+        if (adv != advance) return;  // proportional font
+        glyphs[cp] = gid;
+    }
+    if ((advance >> 6) <= 0) return;
+    ascii_glyphs_  = glyphs;
+    ascii_advance_ = advance >> 6;
+}
+
+bool TextLayout::shape_ascii(std::string_view utf8, int phys_limit, GlyphRun& run) const {
+    size_t n = utf8.size();
+    int cell = ascii_advance_;
+    // Same stopping point as shape_run: the first glyph whose advance
+    // passes the limit is kept and the run is marked truncated.
+    if (phys_limit > 0 && static_cast<size_t>(phys_limit / cell) < n) {
+        n = static_cast<size_t>(phys_limit / cell) + 1;
+        run.truncated = true;
+    }
+    run.glyphs.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t gid = ascii_glyphs_[static_cast<uint8_t>(utf8[i])];
+        if (gid == 0) {
+            run.glyphs.clear();
+            run.truncated = false;
+            return false;
+        }
+        GlyphEntry& ge = run.glyphs[i];
+        ge.glyph_id   = gid;
+        ge.font_index = 0;
+        ge.x          = static_cast<int>(i) * cell;
+        ge.y_offset   = 0;
+        ge.cluster    = static_cast<int>(i);
+    }
+    run.total_width = static_cast<int>(n) * cell;
+    run.cell_width  = cell;
+    return true;
 }
 
 GlyphRun TextLayout::shape_line(std::string_view utf8, int max_width_px) {
     GlyphRun run;
-    run.total_width = 0;
+    run.total_width  = 0;
+    run.max_width_px = max_width_px;
 
     if (utf8.empty()) return run;
 
@@ -257,11 +359,14 @@ GlyphRun TextLayout::shape_line(std::string_view utf8, int max_width_px) {
     // Convert logical limit to physical pixels for comparison with x_accum
     int phys_limit = (max_width_px > 0) ? static_cast<int>(max_width_px * dpi_scale_) : 0;
 
+    if (ascii_advance_ > 0 && is_ascii(utf8) && shape_ascii(utf8, phys_limit, run))
+        return run;
+
     int x_accum = 0;
 
     if (!might_need_bidi(utf8)) {
         // Fast path: pure LTR, single HarfBuzz run
-        run.truncated = shape_run(fonts_, atlas_, utf8, 0, static_cast<int>(utf8.size()),
+        run.truncated = shape_run(fonts_, *shaper_, utf8, 0, static_cast<int>(utf8.size()),
                   HB_DIRECTION_LTR, x_accum, run.glyphs, phys_limit);
     } else {
         // ICU BiDi path
@@ -278,7 +383,7 @@ GlyphRun TextLayout::shape_line(std::string_view utf8, int max_width_px) {
 
         if (U_FAILURE(err)) {
             // Fallback to LTR on conversion failure
-            shape_run(fonts_, atlas_, utf8, 0, static_cast<int>(utf8.size()),
+            shape_run(fonts_, *shaper_, utf8, 0, static_cast<int>(utf8.size()),
                       HB_DIRECTION_LTR, x_accum, run.glyphs);
             run.total_width = x_accum;
             return run;
@@ -289,7 +394,7 @@ GlyphRun TextLayout::shape_line(std::string_view utf8, int max_width_px) {
 
         if (U_FAILURE(err)) {
             ubidi_close(bidi);
-            shape_run(fonts_, atlas_, utf8, 0, static_cast<int>(utf8.size()),
+            shape_run(fonts_, *shaper_, utf8, 0, static_cast<int>(utf8.size()),
                       HB_DIRECTION_LTR, x_accum, run.glyphs);
             run.total_width = x_accum;
             return run;
@@ -298,7 +403,7 @@ GlyphRun TextLayout::shape_line(std::string_view utf8, int max_width_px) {
         int32_t run_count = ubidi_countRuns(bidi, &err);
         if (U_FAILURE(err)) {
             ubidi_close(bidi);
-            shape_run(fonts_, atlas_, utf8, 0, static_cast<int>(utf8.size()),
+            shape_run(fonts_, *shaper_, utf8, 0, static_cast<int>(utf8.size()),
                       HB_DIRECTION_LTR, x_accum, run.glyphs);
             run.total_width = x_accum;
             return run;
@@ -345,7 +450,7 @@ GlyphRun TextLayout::shape_line(std::string_view utf8, int max_width_px) {
             hb_direction_t hb_dir = (dir == UBIDI_RTL) ? HB_DIRECTION_RTL
                                                         : HB_DIRECTION_LTR;
 
-            shape_run(fonts_, atlas_, utf8, u8_start, u8_end - u8_start,
+            shape_run(fonts_, *shaper_, utf8, u8_start, u8_end - u8_start,
                       hb_dir, x_accum, run.glyphs);
         }
 
@@ -356,36 +461,93 @@ GlyphRun TextLayout::shape_line(std::string_view utf8, int max_width_px) {
     return run;
 }
 
-void TextLayout::draw_run(Renderer& r, const GlyphRun& run, int x, int y,
-                          Color tint)
+int TextLayout::resolve(const GlyphRun& run, bool& pending) {
+    int last_page = -1;
+    resolved_.resize(run.glyphs.size());
+    for (size_t i = 0; i < run.glyphs.size(); ++i) {
+        const GlyphEntry& ge = run.glyphs[i];
+        const AtlasGlyph* ag = atlas_.get_or_request(ge.glyph_id, ge.font_index, pending);
+        if (!ag || ag->rect.w == 0 || ag->rect.h == 0)
+            ag = nullptr;
+        else
+            last_page = std::max(last_page, static_cast<int>(ag->page));
+        resolved_[i] = ag;
+    }
+    return last_page;
+}
+
+void TextLayout::blit_glyph(Renderer& r, const GlyphEntry& ge, const AtlasGlyph& ag,
+                            int x, int baseline_y, Color c)
 {
-    int baseline_y = y + ascent_;
     float inv = 1.0f / dpi_scale_;
+    SDL_Rect src = ag.rect;
+    SDL_Rect dst;
+    dst.x = x + static_cast<int>(ge.x * inv) + static_cast<int>(ag.bearing_x * inv);
+    dst.y = baseline_y - static_cast<int>(ag.bearing_y * inv) - static_cast<int>(ge.y_offset * inv);
+    dst.w = static_cast<int>(ag.rect.w * inv);
+    dst.h = static_cast<int>(ag.rect.h * inv);
+
+    r.blit(atlas_.texture(ag.page), src, dst, c);
+}
 
-    for (const GlyphEntry& ge : run.glyphs) {
-        const AtlasGlyph* ag = atlas_.get_or_add(ge.glyph_id, ge.font_index);
-        if (!ag || ag->rect.w == 0 || ag->rect.h == 0)
-            continue;
+void TextLayout::prefetch(const GlyphRun& run) {
+    bool pending = false;
+    for (const GlyphEntry& ge : run.glyphs)
+        atlas_.get_or_request(ge.glyph_id, ge.font_index, pending);
+}
 
-        SDL_Rect src = ag->rect;
-        SDL_Rect dst;
-        dst.x = x + static_cast<int>(ge.x * inv) + static_cast<int>(ag->bearing_x * inv);
-        dst.y = baseline_y - static_cast<int>(ag->bearing_y * inv) - static_cast<int>(ge.y_offset * inv);
-        dst.w = static_cast<int>(ag->rect.w * inv);
-        dst.h = static_cast<int>(ag->rect.h * inv);
+bool TextLayout::draw_number(Renderer& r, size_t n, int right_x, int y, Color tint) {
+    if (digits_.empty()) {
+        char buf[24];
+        std::snprintf(buf, sizeof(buf), "%zu", n);
+        GlyphRun run = shape_line(buf);
+        int w = static_cast<int>(run.total_width / dpi_scale_ + 0.5f);
+        return draw_run(r, run, right_x - w, y, tint);
+    }
 
-        r.blit(atlas_.texture(), src, dst, tint);
+    // Digits come out least significant first and are placed right to
+    // left, in physical pixels relative to right_x.
+    int baseline_y = y + ascent_;
+    bool pending = false;
+    int  x = 0;
+    do {
+        int d = static_cast<int>(n % 10);
+        n /= 10;
+        x -= digit_advance_[d];
+        GlyphEntry ge = digits_[d];
+        ge.x = x;
+        const AtlasGlyph* ag = atlas_.get_or_request(ge.glyph_id, ge.font_index, pending);
+        if (ag && ag->rect.w != 0 && ag->rect.h != 0)
+            blit_glyph(r, ge, *ag, right_x, baseline_y, tint);
+    } while (n != 0);
+    return !pending;
+}
+
+bool TextLayout::draw_run(Renderer& r, const GlyphRun& run, int x, int y,
+                          Color tint)
+{
+    int baseline_y = y + ascent_;
+
+    // Page by page, so each page's glyphs form one batch. Glyphs still
+    // being rasterized are left out for now.
+    bool pending = false;
+    int last_page = resolve(run, pending);
+    for (int page = 0; page <= last_page; ++page) {
+        for (size_t i = 0; i < run.glyphs.size(); ++i) {
+            if (resolved_[i] && resolved_[i]->page == page)
+                blit_glyph(r, run.glyphs[i], *resolved_[i], x, baseline_y, tint);
+        }
     }
+    return !pending;
 }
 
-void TextLayout::draw_run(Renderer& r, const GlyphRun& run, int x, int y,
+bool TextLayout::draw_run(Renderer& r, const GlyphRun& run, int x, int y,
                           const std::vector<StyledSpan>& flat_spans,
                           std::string_view /*utf8*/)
 {
     if (flat_spans.empty() || run.glyphs.empty()) {
         // Fallback: use default white tint
-        draw_run(r, run, x, y, Color{220, 220, 220, 255});
-        return;
+        return draw_run(r, run, x, y, Color{220, 220, 220, 255});
     }
 
     int baseline_y = y + ascent_;
@@ -440,25 +602,23 @@ void TextLayout::draw_run(Renderer& r, const GlyphRun& run, int x, int y,
             r.fill_rect(Rect{x0, y, x1 - x0, lh}, span.style.bg);
     }
 
-    // Pass 2: Glyph rendering with per-glyph fg color
-    for (const GlyphEntry& ge : run.glyphs) {
-        const AtlasGlyph* ag = atlas_.get_or_add(ge.glyph_id, ge.font_index);
-        if (!ag || ag->rect.w == 0 || ag->rect.h == 0)
-            continue;
-
-        Color fg{220, 220, 220, 255};
-        const StyledSpan* sp = find_span(ge.cluster);
-        if (sp)
-            fg = sp->style.fg;
-
-        SDL_Rect src = ag->rect;
-        SDL_Rect dst;
-        dst.x = x + static_cast<int>(ge.x * inv) + static_cast<int>(ag->bearing_x * inv);
-        dst.y = baseline_y - static_cast<int>(ag->bearing_y * inv) - static_cast<int>(ge.y_offset * inv);
-        dst.w = static_cast<int>(ag->rect.w * inv);
-        dst.h = static_cast<int>(ag->rect.h * inv);
-
-        r.blit(atlas_.texture(), src, dst, fg);
+    // Pass 2: Glyph rendering with per-glyph fg color, page by page
+    bool pending = false;
+    int last_page = resolve(run, pending);
+    for (int page = 0; page <= last_page; ++page) {
+        for (size_t i = 0; i < run.glyphs.size(); ++i) {
+            const AtlasGlyph* ag = resolved_[i];
+            if (!ag || ag->page != page)
+                continue;
+
+            const GlyphEntry& ge = run.glyphs[i];
+            Color fg{220, 220, 220, 255};
+            const StyledSpan* sp = find_span(ge.cluster);
+            if (sp)
+                fg = sp->style.fg;
+
+            blit_glyph(r, ge, *ag, x, baseline_y, fg);
+        }
     }
 
     // Pass 3: Underline pass
@@ -482,6 +642,7 @@ void TextLayout::draw_run(Renderer& r, const GlyphRun& run, int x, int y,
             r.fill_rect(Rect{x0, baseline_y + 2, x1 - x0, 1}, uc);
         }
     }
+    return !pending;
 }
 
 int TextLayout::x_for_column(const GlyphRun& run, std::string_view utf8,
@@ -491,6 +652,12 @@ int TextLayout::x_for_column(const GlyphRun& run, std::string_view utf8,
 
     float inv = 1.0f / dpi_scale_;
 
+    if (run.cell_width > 0) {
+        if (col >= run.glyphs.size())
+            return static_cast<int>(run.total_width * inv);
+        return static_cast<int>(static_cast<int>(col) * run.cell_width * inv);
+    }
+
     // Convert column (codepoint index) to byte offset
     size_t target_byte = col_to_byte_offset(utf8, col);
 
@@ -513,6 +680,15 @@ size_t TextLayout::column_for_x(const GlyphRun& run, std::string_view utf8,
     // Convert logical x to physical for comparison with GlyphEntry positions
     int phys_x = static_cast<int>(x * dpi_scale_);
 
+    if (run.cell_width > 0) {
+        // Nearest cell boundary, rounding as the search below does; past
+        // the last glyph's midpoint is the end of the line.
+        int cell = run.cell_width;
+        int d = phys_x - cell / 2;
+        size_t i = d <= 0 ? 0 : static_cast<size_t>((d + cell - 1) / cell);
+        return i < run.glyphs.size() ? i : utf8.size();
+    }
+
     // Find nearest glyph by x position (physical coords)
     for (size_t i = 0; i + 1 < run.glyphs.size(); ++i) {
         int mid = (run.glyphs[i].x + run.glyphs[i + 1].x) / 2;
@@ -44,21 +44,36 @@ Window::~Window() {
 bool Window::poll_events(const std::function<void(const SDL_Event&)>& handler) {
     SDL_Event ev;
     while (SDL_PollEvent(&ev)) {
-        if (ev.type == SDL_QUIT)
+        if (!dispatch(ev, handler))
             return false;
-        if (ev.type == SDL_WINDOWEVENT &&
-            (ev.window.event == SDL_WINDOWEVENT_RESIZED ||
-             ev.window.event == SDL_WINDOWEVENT_SIZE_CHANGED))
-        {
-            width_  = ev.window.data1;
-            height_ = ev.window.data2;
-            update_dpi_scale();
-        }
-        handler(ev);
     }
     return true;
 }
 
+bool Window::wait_events(int timeout_ms, const std::function<void(const SDL_Event&)>& handler) {
+    SDL_Event ev;
+    if (timeout_ms > 0 && SDL_WaitEventTimeout(&ev, timeout_ms)) {
+        if (!dispatch(ev, handler))
+            return false;
+    }
+    return poll_events(handler);
+}
+
+bool Window::dispatch(const SDL_Event& ev, const std::function<void(const SDL_Event&)>& handler) {
+    if (ev.type == SDL_QUIT)
+        return false;
+    if (ev.type == SDL_WINDOWEVENT &&
+        (ev.window.event == SDL_WINDOWEVENT_RESIZED ||
+         ev.window.event == SDL_WINDOWEVENT_SIZE_CHANGED))
+    {
+        width_  = ev.window.data1;
+        height_ = ev.window.data2;
+        update_dpi_scale();
+    }
+    handler(ev);
+    return true;
+}
+
 bool Window::update_dpi_scale() {
     int draw_w = 0;
     SDL_GetRendererOutputSize(renderer_, &draw_w, nullptr);
@@ -1,6 +1,11 @@
 #include <sprawn/frontend/application.h>
 
+#include <string_view>
+
 int main(int argc, char** argv) {
+    if (argc >= 3 && std::string_view(argv[1]) == "--memory-report")
+        return sprawn::print_memory_report(argv[2]) ? 0 : 1;
+
     const char* filepath = argc >= 2 ? argv[1] : "";
     return sprawn::run_application(filepath) ? 0 : 1;
 }
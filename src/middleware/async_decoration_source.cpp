@@ -0,0 +1,153 @@
+#include <sprawn/middleware/async_decoration_source.h>
+#include <sprawn/middleware/controller.h>
+#include <sprawn/worker_pool.h>
+
+#include <utility>
+
+namespace sprawn {
+
+AsyncDecorationSource::AsyncDecorationSource(Controller& ctrl, WorkerPool& pool,
+                                             std::unique_ptr<Producer> producer)
+    : ctrl_(ctrl)
+    , pool_(pool)
+    , producer_(std::move(producer))
+    , version_(ctrl.document_version())
+    , known_line_count_(ctrl.line_count())
+{}
+
+AsyncDecorationSource::~AsyncDecorationSource() {
+    // Before any member, the producer included, is destroyed.
+    std::unique_lock lock(mutex_);
+    queue_.clear();
+    queued_.clear();
+    idle_.wait(lock, [this] { return !running_; });
+}
+
+LineDecoration AsyncDecorationSource::decorate(size_t line_number) const {
+    {
+        std::lock_guard lock(mutex_);
+        uint64_t version = ctrl_.document_version();
+        if (version != version_) {
+            // Changed without on_edit (a file was opened): nothing kept
+            // can be trusted.
+            cache_.clear();
+            queue_.clear();
+            queued_.clear();
+            in_flight_valid_  = false;
+            version_          = version;
+            known_line_count_ = ctrl_.line_count();
+        }
+        auto it = cache_.find(line_number);
+        if (it != cache_.end()) return it->second;
+        if (queued_.count(line_number)) return {};
+    }
+
+    // Copied here, on the thread allowed to read the document; compute()
+    // only sees the copy.
+    std::string text = ctrl_.line(line_number);
+    bool start;
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back({line_number, std::move(text)});
+        queued_.insert(line_number);
+        if (queue_.size() > kMaxQueued) {
+            queued_.erase(queue_.front().line);
+            queue_.erase(queue_.begin());
+        }
+        start    = !running_;
+        running_ = true;
+    }
+    if (start) pool_.submit([this] { run_queue(); });
+    return {};
+}
+
+void AsyncDecorationSource::run_queue() const {
+    std::unique_lock lock(mutex_);
+    while (!queue_.empty()) {
+        Request req = std::move(queue_.back());
+        queue_.pop_back();
+        in_flight_       = req.line;
+        in_flight_valid_ = true;
+
+        lock.unlock();
+        LineDecoration deco = producer_->compute(req.line, req.text);
+        lock.lock();
+
+        // on_edit() renumbers the in-flight line, or invalidates it if the
+        // edit touched it; decorate() does when a file is opened.
+        bool   alive = in_flight_valid_;
+        size_t line  = in_flight_;
+        in_flight_valid_ = false;
+        if (!alive) continue;
+        queued_.erase(line);
+        if (cache_.size() >= kCacheCapacity) evict_far_from(line);
+        cache_[line] = std::move(deco);
+        publish_dirty({line, line + 1});
+    }
+    running_ = false;
+    idle_.notify_all();
+}
+
+void AsyncDecorationSource::evict_far_from(size_t line_number) const {
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        size_t d = it->first > line_number ? it->first - line_number : line_number - it->first;
+        if (d > kCacheCapacity / 2) it = cache_.erase(it);
+        else                        ++it;
+    }
+}
+
+void AsyncDecorationSource::on_edit(const EditRecord& edit) {
+    std::lock_guard lock(mutex_);
+    // Results for lines the edit changed are dropped; the rest follow
+    // their lines.
+    known_line_count_ = ctrl_.line_count();
+    version_          = edit.version;
+
+    std::unordered_map<size_t, LineDecoration> shifted;
+    shifted.reserve(cache_.size());
+    for (auto& [l, d] : cache_)
+        if (auto to = edit.map_line(l)) shifted.emplace(*to, std::move(d));
+    cache_.swap(shifted);
+
+    // Queued copies of untouched lines still hold their current text, so
+    // they just move with their lines.
+    queued_.clear();
+    auto kept = queue_.begin();
+    for (Request& r : queue_) {
+        auto to = edit.map_line(r.line);
+        if (!to) continue;
+        r.line = *to;
+        queued_.insert(*to);
+        *kept++ = std::move(r);
+    }
+    queue_.erase(kept, queue_.end());
+
+    if (in_flight_valid_) {
+        auto to = edit.map_line(in_flight_);
+        in_flight_valid_ = to.has_value();
+        if (in_flight_valid_) {
+            in_flight_ = *to;
+            queued_.insert(*to);
+        }
+    }
+}
+
+bool AsyncDecorationSource::on_idle(std::chrono::steady_clock::time_point /*deadline*/) {
+    std::lock_guard lock(mutex_);
+    return running_ || !queue_.empty();
+}
+
+size_t AsyncDecorationSource::memory_usage() const {
+    std::lock_guard lock(mutex_);
+    size_t bytes = cache_.bucket_count() * sizeof(void*)
+                 + queue_.capacity() * sizeof(Request)
+                 + queued_.bucket_count() * sizeof(void*)
+                 + queued_.size() * (sizeof(size_t) + 2 * sizeof(void*));
+    for (const auto& [l, d] : cache_)
+        bytes += sizeof(l) + sizeof(LineDecoration) + 2 * sizeof(void*)
+               + d.spans.capacity() * sizeof(StyledSpan);
+    for (const Request& r : queue_) bytes += r.text.capacity();
+    return bytes;
+}
+
+} // namespace sprawn
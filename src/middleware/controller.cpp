@@ -1,45 +1,118 @@
 #include <sprawn/middleware/controller.h>
 #include <sprawn/document.h>
+#include <sprawn/worker_pool.h>
 
 #include <algorithm>
+#include <limits>
 
 namespace sprawn {
 
-Controller::Controller(Document& doc) : doc_(doc) {}
+Controller::Controller(Document& doc) : doc_(doc), versions_(doc.line_count()) {}
 
 void Controller::open_file(const std::filesystem::path& path) {
     doc_.open_file(path);
+    journal_.reset(doc_.version());
+    generations_.bump_all();
+    versions_.reset(doc_.line_count());
 }
 
 std::string Controller::line(size_t line_number) const {
     return doc_.line(line_number);
 }
 
+void Controller::line(size_t line_number, std::string& out) const {
+    doc_.line(line_number, out);
+}
+
 size_t Controller::line_count() const {
     return doc_.line_count();
 }
 
 void Controller::insert(size_t line, size_t col, std::string_view text) {
+    EditRecord rec;
+    rec.offset       = doc_.offset_of(line, col);
+    rec.line         = rec.old_end_line = line;
+    rec.col          = rec.old_end_col  = col;
+    rec.new_length   = text.size();
+    rec.lines_added  = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+    rec.new_end_line = line + rec.lines_added;
+    size_t last_nl   = text.rfind('\n');
+    rec.new_end_col  = last_nl == std::string_view::npos ? col + text.size()
+                                                         : text.size() - last_nl - 1;
     doc_.insert(line, col, text);
-    for (auto& src : sources_)
-        src->on_edit(line, col, text, true);
+    publish_edit(std::move(rec));
 }
 
 void Controller::erase(size_t line, size_t col, size_t count) {
+    EditRecord rec;
+    rec.offset     = doc_.offset_of(line, col);
+    // Also rejects a range past the end before anything changes.
+    auto [end_line, end_col] = doc_.position_of(rec.offset + count);
+    rec.line         = rec.new_end_line = line;
+    rec.col          = rec.new_end_col  = col;
+    rec.old_end_line = end_line;
+    rec.old_end_col  = end_col;
+    rec.old_length   = count;
+    rec.lines_removed = end_line - line;
+    if (count <= EditJournal::kMaxErasedText)
+        rec.erased_text = doc_.text(rec.offset, count);
     doc_.erase(line, col, count);
+    publish_edit(std::move(rec));
+}
+
+void Controller::publish_edit(EditRecord rec) {
+    rec.version = doc_.version();
+    if (batch_depth_ == 0) ++batch_;
+    rec.batch = batch_;
+
+    // Just the edited line, or everything after it once line numbers shift.
+    if (rec.line_delta() == 0)
+        generations_.bump({rec.line, rec.line + 1});
+    else
+        generations_.bump({rec.line, std::numeric_limits<size_t>::max()});
+    versions_.apply(rec);
+    for (auto& b : source_buffers_) b.reset(0, 0);
     for (auto& src : sources_)
-        src->on_edit(line, col, std::string_view{}, false);
+        src->on_edit(rec);
+    journal_.push(std::move(rec));
+}
+
+void Controller::begin_batch() {
+    if (batch_depth_++ == 0) ++batch_;
+}
+
+void Controller::end_batch() {
+    if (batch_depth_ > 0) --batch_depth_;
+}
+
+uint64_t Controller::document_version() const {
+    return doc_.version();
 }
 
 void Controller::add_decoration_source(std::shared_ptr<DecorationSource> source) {
+    stats_.push_back({});
+    stats_.back().name = std::string(source->name());
+    backoff_.push_back({});
     sources_.push_back(std::move(source));
+    source_buffers_.resize(sources_.size());
+    generations_.bump_all();
 }
 
 void Controller::remove_decoration_source(std::string_view name) {
-    sources_.erase(
-        std::remove_if(sources_.begin(), sources_.end(),
-                        [&](const auto& s) { return s->name() == name; }),
-        sources_.end());
+    size_t kept = 0;
+    for (size_t i = 0; i < sources_.size(); ++i) {
+        if (sources_[i]->name() == name) continue;
+        sources_[kept]        = std::move(sources_[i]);
+        source_buffers_[kept] = std::move(source_buffers_[i]);
+        stats_[kept]          = std::move(stats_[i]);
+        backoff_[kept]        = backoff_[i];
+        ++kept;
+    }
+    sources_.resize(kept);
+    source_buffers_.resize(kept);
+    stats_.resize(kept);
+    backoff_.resize(kept);
+    generations_.bump_all();
 }
 
 LineDecoration Controller::decorations(size_t line_number) const {
@@ -55,4 +128,99 @@ LineDecoration Controller::decorations(size_t line_number) const {
     return result;
 }
 
+void Controller::decorations(size_t first, size_t last, DecorationBuffer& out) const {
+    out.reset(first, last);
+    last = out.last_line();
+
+    auto fill = [&](size_t i) {
+        Backoff& b = backoff_[i];
+        DecorationSourceStats& st = stats_[i];
+        if (b.frames > 0) {
+            ++st.skipped;
+            b.served_stale.merge({first, last});
+            return;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        source_buffers_[i].reset(first, last);
+        sources_[i]->decorate_range(first, last, source_buffers_[i]);
+        auto took = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - t0);
+        ++st.calls;
+        st.last = took;
+        st.latency.record(took);
+        if (budget_.count() > 0 && took > budget_) {
+            b.length = std::min(std::max(b.length * 2, 1u), kMaxBudgetBackoff);
+            b.frames = b.length;
+        } else {
+            b.length = 0;
+        }
+    };
+    if (pool_ && pool_->concurrency() > 1 && sources_.size() > 1 &&
+        last - first >= kParallelDecorationLines)
+    {
+        pool_->parallel_for(sources_.size(), fill);
+    } else {
+        for (size_t i = 0; i < sources_.size(); ++i) fill(i);
+    }
+
+    for (size_t line = first; line < last; ++line) {
+        for (size_t i = 0; i < sources_.size(); ++i) {
+            // A skipped source's buffer may not cover the line.
+            const DecorationBuffer& buf = source_buffers_[i];
+            if (line < buf.first_line() || line - buf.first_line() >= buf.filled_lines())
+                continue;
+            int bp = sources_[i]->base_priority();
+            for (StyledSpan span : buf.line(line)) {
+                span.priority += bp;
+                out.push(span);
+            }
+        }
+        out.end_line();
+    }
+}
+
+LineRange Controller::poll_decoration_changes() {
+    LineRange changed;
+    for (size_t i = 0; i < sources_.size(); ++i) {
+        LineRange r = sources_[i]->take_dirty();
+        Backoff& b = backoff_[i];
+        if (b.frames > 0 && --b.frames == 0) {
+            r.merge(b.served_stale);
+            b.served_stale = {};
+        }
+        generations_.bump(r);
+        changed.merge(r);
+    }
+    return changed;
+}
+
+bool Controller::on_idle(std::chrono::microseconds budget) {
+    auto deadline = std::chrono::steady_clock::now() + budget;
+    bool pending = false;
+    for (auto& src : sources_) {
+        if (std::chrono::steady_clock::now() >= deadline) return true;
+        pending |= src->on_idle(deadline);
+    }
+    // A source in backoff still owes a refresh of the lines it served
+    // stale; keep the caller polling until poll_decoration_changes() has
+    // counted the backoff down.
+    for (const Backoff& b : backoff_)
+        pending |= b.frames > 0;
+    return pending;
+}
+
+MemoryReport Controller::memory_report() const {
+    MemoryReport report;
+    doc_.memory_report(report);
+    for (const auto& src : sources_)
+        report.add("middleware." + std::string(src->name()), src->memory_usage());
+    size_t buffers = source_buffers_.capacity() * sizeof(DecorationBuffer);
+    for (const auto& b : source_buffers_) buffers += b.memory_usage();
+    report.add("middleware.decoration_buffers", buffers);
+    report.add("middleware.line_generations", generations_.memory_usage());
+    report.add("middleware.line_versions", versions_.memory_usage());
+    report.add("middleware.edit_journal", journal_.memory_usage());
+    return report;
+}
+
 } // namespace sprawn
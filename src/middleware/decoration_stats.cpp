@@ -0,0 +1,42 @@
+#include <sprawn/middleware/decoration_stats.h>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace sprawn {
+
+size_t LatencyHistogram::bucket_of(uint32_t us) {
+    return std::min<size_t>(std::bit_width(us), kBuckets - 1);
+}
+
+void LatencyHistogram::record(std::chrono::microseconds latency) {
+    auto us = static_cast<uint32_t>(std::clamp<long long>(
+        latency.count(), 0, std::numeric_limits<uint32_t>::max()));
+    if (count_ == kWindow)
+        --buckets_[bucket_of(ring_[next_])];
+    else
+        ++count_;
+    ring_[next_] = us;
+    ++buckets_[bucket_of(us)];
+    next_ = (next_ + 1) % kWindow;
+}
+
+std::chrono::microseconds LatencyHistogram::percentile(double p) const {
+    if (count_ == 0) return std::chrono::microseconds(0);
+    auto rank = static_cast<size_t>(std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(count_ - 1));
+    size_t seen = 0;
+    for (size_t b = 0; b < kBuckets; ++b) {
+        seen += buckets_[b];
+        if (seen > rank) return std::chrono::microseconds(uint64_t{1} << b);
+    }
+    return std::chrono::microseconds(uint64_t{1} << (kBuckets - 1));
+}
+
+std::chrono::microseconds LatencyHistogram::max() const {
+    uint32_t m = 0;
+    for (size_t i = 0; i < count_; ++i) m = std::max(m, ring_[i]);
+    return std::chrono::microseconds(m);
+}
+
+} // namespace sprawn
@@ -0,0 +1,43 @@
+#include <sprawn/middleware/edit_journal.h>
+
+#include <algorithm>
+
+namespace sprawn {
+
+void EditJournal::push(EditRecord record) {
+    std::lock_guard lock(mutex_);
+    if (records_.size() >= capacity_) {
+        dropped_through_ = records_.front().version;
+        records_.pop_front();
+    }
+    records_.push_back(std::move(record));
+}
+
+void EditJournal::reset(uint64_t version) {
+    std::lock_guard lock(mutex_);
+    records_.clear();
+    dropped_through_ = version;
+}
+
+bool EditJournal::since(uint64_t version, std::vector<EditRecord>& out) const {
+    std::lock_guard lock(mutex_);
+    if (version < dropped_through_) return false;
+    auto it = std::upper_bound(records_.begin(), records_.end(), version,
+                               [](uint64_t v, const EditRecord& r) { return v < r.version; });
+    out.insert(out.end(), it, records_.end());
+    return true;
+}
+
+size_t EditJournal::size() const {
+    std::lock_guard lock(mutex_);
+    return records_.size();
+}
+
+size_t EditJournal::memory_usage() const {
+    std::lock_guard lock(mutex_);
+    size_t bytes = records_.size() * sizeof(EditRecord);
+    for (const auto& r : records_) bytes += r.erased_text.capacity();
+    return bytes;
+}
+
+} // namespace sprawn
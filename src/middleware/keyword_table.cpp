@@ -0,0 +1,61 @@
+#include <sprawn/middleware/keyword_table.h>
+
+#include <stdexcept>
+#include <unordered_set>
+
+namespace sprawn {
+
+struct KeywordTable::Storage {
+    std::vector<std::string>  strings;   // owns the bytes the entries view
+    std::vector<KeywordEntry> words;
+    std::vector<uint16_t>     slots;
+    std::vector<uint32_t>     disp;
+};
+
+KeywordTable::KeywordTable(const std::vector<std::string>& keywords,
+                           const std::vector<std::string>& types) {
+    auto storage = std::make_shared<Storage>();
+    std::unordered_set<std::string_view> seen;
+    storage->strings.reserve(keywords.size() + types.size());
+    for (const auto* list : {&keywords, &types}) {
+        WordClass cls = list == &keywords ? WordClass::Keyword : WordClass::Type;
+        for (const auto& w : *list) {
+            if (w.empty() || seen.count(w)) continue;
+            seen.insert(w);
+            storage->strings.push_back(w);
+            storage->words.push_back({{}, cls});
+        }
+    }
+    if (storage->words.empty()) return;
+    if (storage->words.size() >= keyword_detail::kEmptySlot)
+        throw std::length_error("KeywordTable: too many words");
+    // Views are taken after the strings vector stops growing.
+    for (size_t i = 0; i < storage->words.size(); ++i)
+        storage->words[i].word = storage->strings[i];
+
+    size_t n = storage->words.size();
+    storage->disp.resize(keyword_detail::bucket_count(n));
+    size_t slots = keyword_detail::slot_count(n);
+    for (;; slots *= 2) {
+        storage->slots.resize(slots);
+        if (keyword_detail::build(storage->words, storage->slots, storage->disp)) break;
+    }
+
+    words_   = storage->words;
+    slots_   = storage->slots;
+    disp_    = storage->disp;
+    storage_ = std::move(storage);
+}
+
+size_t KeywordTable::memory_usage() const {
+    if (!storage_) return 0;
+    size_t bytes = sizeof(Storage)
+                 + storage_->words.capacity() * sizeof(KeywordEntry)
+                 + storage_->slots.capacity() * sizeof(uint16_t)
+                 + storage_->disp.capacity() * sizeof(uint32_t);
+    for (const auto& s : storage_->strings)
+        bytes += sizeof(std::string) + s.capacity();
+    return bytes;
+}
+
+} // namespace sprawn
@@ -0,0 +1,401 @@
+#include <sprawn/middleware/language.h>
+
+#include <algorithm>
+#include <cctype>
+
+namespace sprawn {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Rule shorthands
+// ---------------------------------------------------------------------------
+
+DelimitedRule line_comment(std::string open, RuleAnchor anchor = RuleAnchor::Anywhere) {
+    DelimitedRule r;
+    r.type   = TokenType::Comment;
+    r.open   = std::move(open);
+    r.anchor = anchor;
+    return r;
+}
+
+DelimitedRule block_comment(std::string open, std::string close, bool nestable = false) {
+    DelimitedRule r;
+    r.type      = TokenType::Comment;
+    r.open      = std::move(open);
+    r.close     = std::move(close);
+    r.multiline = true;
+    r.nestable  = nestable;
+    return r;
+}
+
+DelimitedRule quoted(TokenType type, std::string quote, char escape, bool multiline = false) {
+    DelimitedRule r;
+    r.type      = type;
+    r.open      = quote;
+    r.close     = std::move(quote);
+    r.escape    = escape;
+    r.multiline = multiline;
+    return r;
+}
+
+DelimitedRule dynamic(TokenType type, std::string open, DelimiterKind kind) {
+    DelimitedRule r;
+    r.type      = type;
+    r.open      = std::move(open);
+    r.kind      = kind;
+    r.multiline = true;
+    return r;
+}
+
+// ---------------------------------------------------------------------------
+// C++ keywords, hashed at compile time
+// ---------------------------------------------------------------------------
+
+constexpr auto kCppKeywords = std::to_array<std::string_view>({
+    "alignas", "alignof", "and", "and_eq", "asm", "auto",
+    "bitand", "bitor", "break",
+    "case", "catch", "class", "co_await", "co_return", "co_yield",
+    "compl", "concept", "const", "const_cast", "consteval",
+    "constexpr", "constinit", "continue",
+    "decltype", "default", "delete", "do", "dynamic_cast",
+    "else", "enum", "explicit", "export", "extern",
+    "false", "for", "friend",
+    "goto",
+    "if", "inline",
+    "module", "mutable",
+    "namespace", "new", "noexcept", "not", "not_eq", "nullptr",
+    "operator", "or", "or_eq",
+    "private", "protected", "public",
+    "register", "reinterpret_cast", "requires", "return",
+    "sizeof", "static", "static_assert", "static_cast",
+    "struct", "switch",
+    "template", "this", "throw", "true", "try", "typedef",
+    "typeid", "typename",
+    "union", "using",
+    "virtual", "volatile",
+    "while",
+    "xor", "xor_eq",
+});
+
+constexpr auto kCppTypes = std::to_array<std::string_view>({
+    "bool", "char", "char8_t", "char16_t", "char32_t",
+    "double", "float",
+    "int", "int8_t", "int16_t", "int32_t", "int64_t",
+    "long",
+    "short", "signed",
+    "size_t", "ssize_t",
+    "uint8_t", "uint16_t", "uint32_t", "uint64_t",
+    "unsigned",
+    "void", "wchar_t",
+    "string", "string_view", "vector", "map", "set",
+    "unordered_map", "unordered_set", "array", "pair", "tuple",
+    "shared_ptr", "unique_ptr", "weak_ptr",
+    "optional", "variant", "any",
+    "FILE",
+});
+
+template <size_t K, size_t T>
+constexpr std::array<KeywordEntry, K + T>
+classify(const std::array<std::string_view, K>& keywords,
+         const std::array<std::string_view, T>& types) {
+    std::array<KeywordEntry, K + T> out{};
+    for (size_t i = 0; i < K; ++i) out[i] = {keywords[i], WordClass::Keyword};
+    for (size_t i = 0; i < T; ++i) out[K + i] = {types[i], WordClass::Type};
+    return out;
+}
+
+constexpr auto kCppWordTable = make_keyword_table(classify(kCppKeywords, kCppTypes));
+
+std::string lowercase(std::string_view s) {
+    std::string out(s);
+    for (char& c : out) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return out;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Built-in languages
+// ---------------------------------------------------------------------------
+
+LanguageDef LanguageDef::cpp() {
+    LanguageDef d;
+    d.name  = "cpp";
+    d.rules = {
+        block_comment("/*", "*/"),  // first rule: LineState::InBlockComment
+        line_comment("//"),
+        line_comment("#", RuleAnchor::LineStart),
+        dynamic(TokenType::StringLiteral, "R\"",   DelimiterKind::RawString),
+        dynamic(TokenType::StringLiteral, "u8R\"", DelimiterKind::RawString),
+        dynamic(TokenType::StringLiteral, "uR\"",  DelimiterKind::RawString),
+        dynamic(TokenType::StringLiteral, "UR\"",  DelimiterKind::RawString),
+        dynamic(TokenType::StringLiteral, "LR\"",  DelimiterKind::RawString),
+        quoted(TokenType::StringLiteral, "\"", '\\'),
+        quoted(TokenType::CharLiteral,   "'",  '\\'),
+    };
+    d.rules[2].type = TokenType::Preprocessor;
+    d.numbers.separator = '\'';
+    d.numbers.suffixes  = "uUlLfF";
+    d.keywords.assign(kCppKeywords.begin(), kCppKeywords.end());
+    d.types.assign(kCppTypes.begin(), kCppTypes.end());
+    d.keyword_table = KeywordTable(kCppWordTable);
+    d.extensions = {".cpp", ".cxx", ".cc", ".c", ".h", ".hpp", ".hxx", ".inl"};
+    return d;
+}
+
+LanguageDef LanguageDef::python() {
+    LanguageDef d;
+    d.name  = "python";
+    d.rules = {
+        line_comment("#"),
+        quoted(TokenType::StringLiteral, "\"\"\"", '\\', true),
+        quoted(TokenType::StringLiteral, "'''",    '\\', true),
+        quoted(TokenType::StringLiteral, "\"",     '\\'),
+        quoted(TokenType::StringLiteral, "'",      '\\'),
+    };
+    d.numbers.separator = '_';
+    d.numbers.octal     = true;
+    d.numbers.suffixes  = "jJ";
+    d.keywords = {
+        "False", "None", "True", "and", "as", "assert", "async", "await",
+        "break", "case", "class", "continue", "def", "del", "elif", "else",
+        "except", "finally", "for", "from", "global", "if", "import", "in",
+        "is", "lambda", "match", "nonlocal", "not", "or", "pass", "raise",
+        "return", "self", "try", "while", "with", "yield",
+    };
+    d.types = {
+        "bool", "bytearray", "bytes", "complex", "dict", "float", "frozenset",
+        "int", "list", "object", "set", "str", "tuple", "type",
+    };
+    d.extensions = {".py", ".pyw", ".pyi"};
+    d.shebangs   = {"python", "python2", "python3"};
+    return d;
+}
+
+LanguageDef LanguageDef::json() {
+    LanguageDef d;
+    d.name  = "json";
+    d.rules = {quoted(TokenType::StringLiteral, "\"", '\\')};
+    d.numbers.hex    = false;
+    d.numbers.binary = false;
+    d.keywords   = {"false", "null", "true"};
+    d.extensions = {".json", ".jsonl", ".geojson"};
+    return d;
+}
+
+LanguageDef LanguageDef::yaml() {
+    LanguageDef d;
+    d.name  = "yaml";
+    d.rules = {
+        line_comment("#", RuleAnchor::AfterBlank),
+        quoted(TokenType::StringLiteral, "\"", '\\'),
+        quoted(TokenType::StringLiteral, "'",  0),
+    };
+    d.numbers.binary = false;
+    d.numbers.octal  = true;
+    d.keywords = {
+        "false", "False", "FALSE", "null", "Null", "NULL", "true", "True", "TRUE",
+        "no", "No", "off", "Off", "on", "On", "yes", "Yes",
+    };
+    d.extensions = {".yaml", ".yml"};
+    return d;
+}
+
+LanguageDef LanguageDef::rust() {
+    LanguageDef d;
+    d.name  = "rust";
+    d.rules = {
+        block_comment("/*", "*/", true),
+        line_comment("//"),
+        dynamic(TokenType::StringLiteral, "r",  DelimiterKind::HashRaw),
+        dynamic(TokenType::StringLiteral, "br", DelimiterKind::HashRaw),
+        quoted(TokenType::StringLiteral, "\"", '\\', true),
+        quoted(TokenType::CharLiteral,   "'\\", '\\'),
+        quoted(TokenType::CharLiteral,   "'",   0),
+    };
+    // Bounded so lifetimes ('a, 'static) are not taken for char literals:
+    // escapes up to '\u{10FFFF}' (the escaped character first, so '\''
+    // closes at the last quote), otherwise one character.
+    d.rules[5].close           = "'";
+    d.rules[5].max_length      = 12;
+    d.rules[6].max_code_points = 1;
+    d.numbers.separator = '_';
+    d.numbers.octal     = true;
+    d.numbers.suffixes  = "iuf0123456789sze";  // i32, u8, f64, usize, isize
+    d.keywords = {
+        "as", "async", "await", "break", "const", "continue", "crate", "dyn",
+        "else", "enum", "extern", "false", "fn", "for", "if", "impl", "in",
+        "let", "loop", "match", "mod", "move", "mut", "pub", "ref", "return",
+        "self", "Self", "static", "struct", "super", "trait", "true", "type",
+        "unsafe", "use", "where", "while",
+    };
+    d.types = {
+        "bool", "char", "str", "f32", "f64",
+        "i8", "i16", "i32", "i64", "i128", "isize",
+        "u8", "u16", "u32", "u64", "u128", "usize",
+        "Box", "Option", "Rc", "Arc", "Result", "String", "Vec",
+    };
+    d.extensions = {".rs"};
+    return d;
+}
+
+LanguageDef LanguageDef::go() {
+    LanguageDef d;
+    d.name  = "go";
+    d.rules = {
+        block_comment("/*", "*/"),
+        line_comment("//"),
+        quoted(TokenType::StringLiteral, "\"", '\\'),
+        quoted(TokenType::StringLiteral, "`",  0, true),
+        quoted(TokenType::CharLiteral,   "'",  '\\'),
+    };
+    d.numbers.separator = '_';
+    d.numbers.octal     = true;
+    d.numbers.suffixes  = "i";
+    d.keywords = {
+        "break", "case", "chan", "const", "continue", "default", "defer",
+        "else", "fallthrough", "false", "for", "func", "go", "goto", "if",
+        "import", "interface", "iota", "map", "nil", "package", "range",
+        "return", "select", "struct", "switch", "true", "type", "var",
+    };
+    d.types = {
+        "any", "bool", "byte", "complex64", "complex128", "error",
+        "float32", "float64", "int", "int8", "int16", "int32", "int64",
+        "rune", "string", "uint", "uint8", "uint16", "uint32", "uint64", "uintptr",
+    };
+    d.extensions = {".go"};
+    return d;
+}
+
+LanguageDef LanguageDef::shell() {
+    LanguageDef d;
+    d.name  = "shell";
+    d.rules = {
+        dynamic(TokenType::StringLiteral, "<<", DelimiterKind::Heredoc),
+        line_comment("#", RuleAnchor::AfterBlank),
+        quoted(TokenType::StringLiteral, "\"", '\\', true),
+        quoted(TokenType::StringLiteral, "'",  0, true),
+    };
+    d.numbers.hex    = false;
+    d.numbers.binary = false;
+    d.keywords = {
+        "case", "do", "done", "elif", "else", "esac", "export", "fi", "for",
+        "function", "if", "in", "local", "readonly", "return", "select",
+        "then", "until", "while",
+    };
+    d.extensions = {".sh", ".bash", ".zsh", ".ksh"};
+    d.shebangs   = {"sh", "bash", "zsh", "ksh", "dash"};
+    return d;
+}
+
+LanguageDef LanguageDef::log() {
+    LanguageDef d;
+    d.name  = "log";
+    d.rules = {quoted(TokenType::StringLiteral, "\"", '\\')};
+    d.numbers.binary = false;
+    for (std::string_view w : {"FATAL", "CRITICAL", "ERROR", "ERR", "WARNING", "WARN"}) {
+        d.keywords.emplace_back(w);
+        d.keywords.push_back(lowercase(w));
+    }
+    for (std::string_view w : {"NOTICE", "INFO", "DEBUG", "TRACE"}) {
+        d.types.emplace_back(w);
+        d.types.push_back(lowercase(w));
+    }
+    d.extensions = {".log"};
+    return d;
+}
+
+// ---------------------------------------------------------------------------
+// LanguageRegistry
+// ---------------------------------------------------------------------------
+
+const LanguageRegistry& LanguageRegistry::builtin() {
+    static const LanguageRegistry registry = [] {
+        LanguageRegistry r;
+        r.add(LanguageDef::cpp());
+        r.add(LanguageDef::python());
+        r.add(LanguageDef::json());
+        r.add(LanguageDef::yaml());
+        r.add(LanguageDef::rust());
+        r.add(LanguageDef::go());
+        r.add(LanguageDef::shell());
+        r.add(LanguageDef::log());
+        return r;
+    }();
+    return registry;
+}
+
+void LanguageRegistry::add(LanguageDef def) {
+    if (def.keyword_table.empty())
+        def.keyword_table = KeywordTable(def.keywords, def.types);
+    langs_.push_back(std::make_unique<LanguageDef>(std::move(def)));
+    const LanguageDef* lang = langs_.back().get();
+    names_[lang->name] = lang;
+    for (const auto& e : lang->extensions) extensions_[lowercase(e)] = lang;
+    for (const auto& i : lang->shebangs)   interpreters_[i] = lang;
+}
+
+const LanguageDef* LanguageRegistry::by_name(std::string_view name) const {
+    auto it = names_.find(std::string(name));
+    return it != names_.end() ? it->second : nullptr;
+}
+
+const LanguageDef* LanguageRegistry::by_extension(std::string_view ext) const {
+    auto it = extensions_.find(lowercase(ext));
+    return it != extensions_.end() ? it->second : nullptr;
+}
+
+const LanguageDef* LanguageRegistry::by_shebang(std::string_view line) const {
+    if (line.substr(0, 2) != "#!") return nullptr;
+    line.remove_prefix(2);
+
+    // Words of the interpreter line; "/usr/bin/env -S python3 -u" names
+    // python3.
+    std::vector<std::string_view> words;
+    size_t at = 0;
+    while (at < line.size()) {
+        size_t start = line.find_first_not_of(" \t\r", at);
+        if (start == std::string_view::npos) break;
+        size_t end = line.find_first_of(" \t\r", start);
+        if (end == std::string_view::npos) end = line.size();
+        words.push_back(line.substr(start, end - start));
+        at = end;
+    }
+    auto basename = [](std::string_view w) {
+        size_t slash = w.rfind('/');
+        return slash == std::string_view::npos ? w : w.substr(slash + 1);
+    };
+    std::string_view interp;
+    for (size_t i = 0; i < words.size(); ++i) {
+        std::string_view w = basename(words[i]);
+        if (i == 0 && w == "env") continue;
+        if (i > 0 && !w.empty() && w[0] == '-') continue;
+        interp = w;
+        break;
+    }
+    if (interp.empty()) return nullptr;
+
+    auto it = interpreters_.find(std::string(interp));
+    if (it != interpreters_.end()) return it->second;
+    // python3.12 -> python3 -> python
+    while (!interp.empty() && (std::isdigit(static_cast<unsigned char>(interp.back())) ||
+                               interp.back() == '.'))
+    {
+        interp.remove_suffix(1);
+        it = interpreters_.find(std::string(interp));
+        if (it != interpreters_.end()) return it->second;
+    }
+    return nullptr;
+}
+
+const LanguageDef* LanguageRegistry::detect(const std::filesystem::path& path,
+                                            std::string_view first_line) const {
+    std::string ext = path.extension().string();
+    if (!ext.empty()) {
+        if (const LanguageDef* lang = by_extension(ext)) return lang;
+    }
+    return by_shebang(first_line);
+}
+
+} // namespace sprawn
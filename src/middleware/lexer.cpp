@@ -0,0 +1,486 @@
+#include "lexer.h"
+#include "scan_simd.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace sprawn {
+
+namespace {
+
+enum : uint8_t {
+    kBlank       = 1 << 0,
+    kIdentStart  = 1 << 1,
+    kDigit       = 1 << 2,
+    kRuleStart   = 1 << 3,
+    kSuffix      = 1 << 4,
+    kHexDigit    = 1 << 5,
+    kNumberStart = 1 << 6,  // digit or '.', if the language has numbers
+};
+
+// Up to four bytes at p, little end first, zero-padded.
+inline uint32_t load_prefix(const char* p, int avail) {
+    uint32_t w = 0;
+    if (avail >= 4) {
+        const auto* u = reinterpret_cast<const uint8_t*>(p);
+        return static_cast<uint32_t>(u[0]) | static_cast<uint32_t>(u[1]) << 8 |
+               static_cast<uint32_t>(u[2]) << 16 | static_cast<uint32_t>(u[3]) << 24;
+    }
+    int n = avail < 4 ? avail : 4;
+    for (int i = 0; i < n; ++i)
+        w |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+    return w;
+}
+
+inline bool starts_with_at(std::string_view text, int pos, std::string_view s) {
+    if (text.size() - static_cast<size_t>(pos) < s.size()) return false;
+    const char* p = text.data() + pos;
+    for (size_t i = 0; i < s.size(); ++i)
+        if (p[i] != s[i]) return false;
+    return true;
+}
+
+// C++ limits raw string tags to 16 characters.
+constexpr size_t kMaxRawTag = 16;
+
+// Closing tags are carried between lines as a hash, keeping LineState small;
+// a body line colliding with the tag would end the construct early.
+uint32_t delim_hash(std::string_view tag) {
+    uint32_t h = 2166136261u;
+    for (char c : tag) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+} // namespace
+
+// Body of a fixed-delimiter rule from `at`: end of the closing delimiter,
+// or -1 if the line ends first.
+inline int Lexer::fixed_end(const Rule& r, const char* p, int at, int len) {
+    const char close0 = r.close[0];
+    const size_t close_len = r.close.size();
+    while (at < len) {
+        at += static_cast<int>(scan::find_any(p + at, static_cast<size_t>(len - at),
+                                              r.stops[0], r.stops[1], r.stops[2]));
+        if (at >= len) break;
+        if (r.escape && p[at] == r.escape) {
+            at += 2;
+            continue;
+        }
+        if (p[at] == close0 && static_cast<size_t>(len - at) >= close_len &&
+            (close_len == 1 || std::equal(r.close.begin() + 1, r.close.end(), p + at + 1)))
+            return at + static_cast<int>(close_len);
+        ++at;
+    }
+    return -1;
+}
+
+Lexer::Lexer(const LanguageDef& def)
+    : numbers_(def.numbers)
+    , keywords_(def.keyword_table.empty() ? KeywordTable(def.keywords, def.types)
+                                          : def.keyword_table)
+{
+    if (def.rules.size() >= 0xFFFF)
+        throw std::invalid_argument("Lexer: too many rules");
+
+    for (int c = 0; c < 256; ++c) {
+        uint8_t k = 0;
+        if (c == ' ' || c == '\t') k |= kBlank;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') k |= kIdentStart;
+        if (c >= '0' && c <= '9') k |= kDigit | kHexDigit;
+        if (def.numbers.enabled && ((c >= '0' && c <= '9') || c == '.')) k |= kNumberStart;
+        if ((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) k |= kHexDigit;
+        cls_[static_cast<size_t>(c)] = k;
+    }
+    for (char c : numbers_.suffixes)
+        cls_[static_cast<unsigned char>(c)] |= kSuffix;
+
+    rules_.reserve(def.rules.size());
+    for (size_t i = 0; i < def.rules.size(); ++i) {
+        const DelimitedRule& d = def.rules[i];
+        if (d.open.empty())
+            throw std::invalid_argument("Lexer: rule with an empty opener in " + def.name);
+        Rule r{d.type, d.open, d.close, d.escape, d.multiline, d.nestable,
+               d.kind, d.anchor, d.max_length, d.max_code_points, static_cast<uint16_t>(i + 1),
+               {}, 0, 0, Op::General};
+        int head = static_cast<int>(std::min<size_t>(d.open.size(), 4));
+        r.open_word = load_prefix(d.open.data(), head);
+        r.open_mask = head == 4 ? ~uint32_t{0} : (uint32_t{1} << (8 * head)) - 1;
+        bool plain = d.kind == DelimiterKind::Fixed && d.anchor == RuleAnchor::Anywhere &&
+                     !d.nestable && d.max_length == 0 && d.max_code_points == 0;
+        r.op = !plain ? Op::General : d.close.empty() ? Op::ToEol : Op::Fixed;
+        switch (d.kind) {
+            case DelimiterKind::RawString: r.close = ")"; break;   // + tag + '"'
+            case DelimiterKind::HashRaw:   r.close = "\""; break;  // + hashes
+            default: break;
+        }
+        char first = r.close.empty() ? '\0' : r.close[0];
+        r.stops = {first, r.escape ? r.escape : first, r.nestable ? r.open[0] : first};
+        unsigned char first_open = static_cast<unsigned char>(d.open[0]);
+        second_[first_open] |= d.open.size() > 1 ? uint64_t{1} << (d.open[1] & 63) : ~uint64_t{0};
+        rules_.push_back(std::move(r));
+        cls_[first_open] |= kRuleStart;
+    }
+
+    // Candidate lists per first byte, longest opener first so '"""' wins
+    // over '"'.
+    std::vector<uint16_t> order(rules_.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<uint16_t>(i);
+    std::stable_sort(order.begin(), order.end(), [&](uint16_t a, uint16_t b) {
+        unsigned char fa = static_cast<unsigned char>(rules_[a].open[0]);
+        unsigned char fb = static_cast<unsigned char>(rules_[b].open[0]);
+        if (fa != fb) return fa < fb;
+        return rules_[a].open.size() > rules_[b].open.size();
+    });
+    candidates_ = order;
+    size_t at = 0;
+    for (size_t c = 0; c < 256; ++c) {
+        cand_begin_[c] = static_cast<uint16_t>(at);
+        while (at < order.size() &&
+               static_cast<unsigned char>(rules_[order[at]].open[0]) == c)
+            ++at;
+    }
+    cand_begin_[256] = static_cast<uint16_t>(at);
+
+    simple_states_.push_back(LineState::Normal);
+    for (const Rule& r : rules_)
+        if (r.multiline && r.kind == DelimiterKind::Fixed)
+            simple_states_.push_back({r.region, static_cast<uint16_t>(r.nestable ? 1 : 0), 0});
+
+    single_.fill(kNoRule);
+    for (size_t c = 0; c < 256; ++c) {
+        if (cand_begin_[c + 1] - cand_begin_[c] != 1) continue;
+        uint16_t ri = candidates_[cand_begin_[c]];
+        if (rules_[ri].open.size() == 1 && rules_[ri].op != Op::General) single_[c] = ri;
+    }
+}
+
+size_t Lexer::memory_usage() const {
+    size_t bytes = rules_.capacity() * sizeof(Rule)
+                 + candidates_.capacity() * sizeof(uint16_t)
+                 + simple_states_.capacity() * sizeof(LineState)
+                 + keywords_.memory_usage();
+    for (const auto& r : rules_)
+        bytes += r.open.capacity() + r.close.capacity();
+    return bytes;
+}
+
+inline int Lexer::scan_number(std::string_view text, int pos, std::vector<Token>& tokens) const {
+    const int len = static_cast<int>(text.size());
+    const char sep = numbers_.separator;
+    auto at = [&](int i) { return text[static_cast<size_t>(i)]; };
+    auto is = [&](int i, uint8_t k) {
+        return i < len && (cls_[static_cast<unsigned char>(at(i))] & k);
+    };
+    auto is_sep = [&](int i) { return sep && i < len && at(i) == sep; };
+
+    int start = pos;
+    char c    = at(pos);
+    char x    = pos + 1 < len ? at(pos + 1) : '\0';
+    if (c == '0' && numbers_.hex && (x == 'x' || x == 'X')) {
+        pos += 2;
+        while (is(pos, kHexDigit) || is_sep(pos)) ++pos;
+    } else if (c == '0' && numbers_.binary && (x == 'b' || x == 'B')) {
+        pos += 2;
+        while (pos < len && (at(pos) == '0' || at(pos) == '1' || is_sep(pos))) ++pos;
+    } else if (c == '0' && numbers_.octal && (x == 'o' || x == 'O')) {
+        pos += 2;
+        while (pos < len && ((at(pos) >= '0' && at(pos) <= '7') || is_sep(pos))) ++pos;
+    } else {
+        // Decimal / float
+        while (is(pos, kDigit) || is_sep(pos)) ++pos;
+        if (pos < len && at(pos) == '.') {
+            ++pos;
+            while (is(pos, kDigit) || is_sep(pos)) ++pos;
+        }
+        if (numbers_.exponent && pos < len && (at(pos) == 'e' || at(pos) == 'E')) {
+            ++pos;
+            if (pos < len && (at(pos) == '+' || at(pos) == '-')) ++pos;
+            while (is(pos, kDigit)) ++pos;
+        }
+    }
+    // Suffixes: u, l, ll, f, u32, ...
+    while (is(pos, kSuffix)) ++pos;
+    tokens.push_back({start, pos, TokenType::Number});
+    return pos;
+}
+
+LineState Lexer::scan(std::string_view text, LineState entry,
+                      std::vector<Token>& tokens) const {
+    tokens.clear();
+    const char* p = text.data();
+    const int len = static_cast<int>(text.size());
+    int pos = 0;
+
+    // 1. Continue the construct left open by the previous line
+    if (entry.region != 0 && entry.region <= rules_.size()) {
+        const Rule& r = rules_[entry.region - 1];
+        if (r.kind == DelimiterKind::Heredoc) {
+            std::string_view body = text;
+            if (entry.depth) body.remove_prefix(std::min(body.find_first_not_of('\t'), body.size()));
+            tokens.push_back({0, len, r.type});
+            return delim_hash(body) == entry.delim ? LineState::Normal : entry;
+        }
+        LineState st = entry;
+        int end = body_end(r, text, 0, st);
+        if (end < 0) {
+            tokens.push_back({0, len, r.type});
+            return st;
+        }
+        tokens.push_back({0, end, r.type});
+        pos = end;
+    }
+
+    LineState exit    = LineState::Normal;
+    LineState pending = LineState::Normal;  // heredoc opened on this line
+    while (pos < len) {
+        unsigned char c = static_cast<unsigned char>(p[pos]);
+        uint8_t k = cls_[c];
+
+        // Runs of blanks between tokens
+        if (k & kBlank) {
+            pos += static_cast<int>(scan::blank_run(p + pos, static_cast<size_t>(len - pos)));
+            continue;
+        }
+
+        // 2. Comments, strings and other delimited rules
+        if (k & kRuleStart) {
+            // One-byte opener with nothing else to try: quotes, '#' comments
+            if (uint16_t ri = single_[c]; ri != kNoRule) {
+                const Rule& r = rules_[ri];
+                int end = len;
+                if (r.op == Op::Fixed) {
+                    end = fixed_end(r, p, pos + 1, len);
+                    if (end < 0) {
+                        if (r.multiline) exit = {r.region, 0, 0};
+                        end = len;
+                    }
+                }
+                tokens.push_back({pos, end, r.type});
+                pos = end;
+                continue;
+            }
+            if (second_[c] >> ((pos + 1 < len ? p[pos + 1] : 0) & 63) & 1) {
+                if (int end = match_rules(text, pos, tokens, exit, pending); end >= 0) {
+                    pos = end;
+                    continue;
+                }
+            }
+        }
+
+        // 3. Number
+        if ((k & kNumberStart) &&
+            (c != '.' || (pos + 1 < len && (cls_[static_cast<unsigned char>(p[pos + 1])] & kDigit))))
+        {
+            pos = scan_number(text, pos, tokens);
+            continue;
+        }
+
+        // 4. Identifier / keyword / type
+        if (k & kIdentStart) {
+            int start = pos;
+            pos += 1 + static_cast<int>(scan::ident_run(p + pos + 1, static_cast<size_t>(len - pos - 1)));
+            switch (keywords_.lookup(text.substr(static_cast<size_t>(start),
+                                                 static_cast<size_t>(pos - start)))) {
+                case WordClass::Keyword: tokens.push_back({start, pos, TokenType::Keyword}); break;
+                case WordClass::Type:    tokens.push_back({start, pos, TokenType::Type});    break;
+                case WordClass::None:    break;  // plain: gaps get default style
+            }
+            continue;
+        }
+
+        // 5. Skip anything else
+        ++pos;
+    }
+
+    if (pending.region != 0) return pending;
+    return exit;
+}
+
+int Lexer::match_rules(std::string_view text, int pos, std::vector<Token>& tokens,
+                       LineState& exit, LineState& pending) const {
+    const char* p = text.data();
+    const int len = static_cast<int>(text.size());
+    unsigned char c = static_cast<unsigned char>(p[pos]);
+    uint32_t head = load_prefix(p + pos, len - pos);
+    bool matched = false;
+    for (uint16_t ci = cand_begin_[c]; ci < cand_begin_[c + 1] && !matched; ++ci) {
+        const Rule& r = rules_[candidates_[ci]];
+        if ((head & r.open_mask) != r.open_word ||
+            static_cast<size_t>(len - pos) < r.open.size() ||
+            (r.open.size() > 4 && !starts_with_at(text, pos, r.open)))
+            continue;
+        switch (r.op) {
+            case Op::ToEol:
+                tokens.push_back({pos, len, r.type});
+                pos     = len;
+                matched = true;
+                break;
+            case Op::Fixed: {
+                int end = fixed_end(r, p, pos + static_cast<int>(r.open.size()), len);
+                if (end < 0 && r.multiline) exit = {r.region, 0, 0};
+                end = end < 0 ? len : end;
+                tokens.push_back({pos, end, r.type});
+                pos     = end;
+                matched = true;
+                break;
+            }
+            case Op::General:
+                matched = apply_rule(r, text, pos, tokens, exit, pending);
+                break;
+        }
+    }
+    return matched ? pos : -1;
+}
+
+bool Lexer::apply_rule(const Rule& r, std::string_view text, int& pos,
+                       std::vector<Token>& tokens, LineState& exit, LineState& pending) const {
+    const int len = static_cast<int>(text.size());
+    if (r.anchor == RuleAnchor::LineStart &&
+        scan::blank_run(text.data(), static_cast<size_t>(pos)) != static_cast<size_t>(pos))
+        return false;
+    if (r.anchor == RuleAnchor::AfterBlank && pos > 0 && !scan::is_blank(text[static_cast<size_t>(pos) - 1]))
+        return false;
+
+    LineState st;
+    st.region = r.region;
+    int body = pos + static_cast<int>(r.open.size());
+
+    switch (r.kind) {
+        case DelimiterKind::Fixed:
+            if (r.close.empty()) {
+                tokens.push_back({pos, len, r.type});
+                pos = len;
+                return true;
+            }
+            break;
+        case DelimiterKind::RawString: {
+            // R"tag( ... )tag": the tag is up to 16 bytes before '('
+            size_t paren = text.find('(', static_cast<size_t>(body));
+            if (paren == std::string_view::npos) return false;
+            std::string_view tag = text.substr(static_cast<size_t>(body), paren - static_cast<size_t>(body));
+            if (tag.size() > kMaxRawTag || tag.find_first_of(" )\\\t\"") != std::string_view::npos)
+                return false;
+            st.delim = delim_hash(tag);
+            body = static_cast<int>(paren) + 1;
+            break;
+        }
+        case DelimiterKind::HashRaw: {
+            int hashes = body;
+            while (hashes < len && text[static_cast<size_t>(hashes)] == '#') ++hashes;
+            if (hashes >= len || text[static_cast<size_t>(hashes)] != '"') return false;
+            st.delim = static_cast<uint32_t>(hashes - body);
+            body = hashes + 1;
+            break;
+        }
+        case DelimiterKind::Heredoc: {
+            // <<WORD, <<-WORD, << "WORD": only the opener is on this line
+            int at = body;
+            if (at < len && text[static_cast<size_t>(at)] == '-') {
+                st.depth = 1;
+                ++at;
+            }
+            while (at < len && scan::is_blank(text[static_cast<size_t>(at)])) ++at;
+            char quote = at < len ? text[static_cast<size_t>(at)] : '\0';
+            if (quote == '\'' || quote == '"') ++at;
+            else quote = '\0';
+            if (at >= len || !(cls_[static_cast<unsigned char>(text[static_cast<size_t>(at)])] & kIdentStart))
+                return false;
+            int word = at;
+            at += static_cast<int>(scan::ident_run(text.data() + at, static_cast<size_t>(len - at)));
+            st.delim = delim_hash(text.substr(static_cast<size_t>(word), static_cast<size_t>(at - word)));
+            if (quote && at < len && text[static_cast<size_t>(at)] == quote) ++at;
+            tokens.push_back({pos, at, r.type});
+            pos = at;
+            pending = st;
+            return true;
+        }
+    }
+
+    st.depth = r.nestable ? 1 : 0;
+    // '\'' in Rust: the escaped byte cannot close the rule.
+    int from = r.escape && r.open.back() == r.escape ? std::min(body + 1, len) : body;
+    int end = body_end(r, text, from, st);
+    if (r.max_length && (end < 0 || end - pos > r.max_length)) return false;
+    if (r.max_code_points) {
+        if (end < 0) return false;
+        int points = 0;
+        for (int i = body; i < end - static_cast<int>(r.close.size()); ++i)
+            points += (static_cast<uint8_t>(text[static_cast<size_t>(i)]) & 0xC0) != 0x80;
+        if (points > r.max_code_points) return false;
+    }
+    if (end < 0) {
+        tokens.push_back({pos, len, r.type});
+        if (r.multiline) exit = st;
+        pos = len;
+        return true;
+    }
+    tokens.push_back({pos, end, r.type});
+    pos = end;
+    return true;
+}
+
+int Lexer::body_end(const Rule& r, std::string_view text, int from, LineState& state) const {
+    const char* p = text.data();
+    const int len = static_cast<int>(text.size());
+    if (r.kind == DelimiterKind::Fixed && !r.nestable) {
+        int end = fixed_end(r, p, from, len);
+        if (end >= 0) state = LineState::Normal;
+        return end;
+    }
+    int at = from;
+    while (at < len) {
+        at += static_cast<int>(scan::find_any(p + at, static_cast<size_t>(len - at),
+                                              r.stops[0], r.stops[1], r.stops[2]));
+        if (at >= len) break;
+        char b = p[at];
+        if (r.escape && b == r.escape) {
+            at += 2;
+            continue;
+        }
+        if (r.nestable && starts_with_at(text, at, r.open)) {
+            ++state.depth;
+            at += static_cast<int>(r.open.size());
+            continue;
+        }
+        int end = close_end(r, text, at, state);
+        if (end >= 0) {
+            if (r.nestable && --state.depth > 0) {
+                at = end;
+                continue;
+            }
+            state = LineState::Normal;
+            return end;
+        }
+        ++at;
+    }
+    return -1;
+}
+
+int Lexer::close_end(const Rule& r, std::string_view text, int at, const LineState& state) const {
+    const int len = static_cast<int>(text.size());
+    switch (r.kind) {
+        case DelimiterKind::RawString: {
+            // )tag"
+            size_t quote = text.find('"', static_cast<size_t>(at) + 1);
+            if (quote == std::string_view::npos || quote - static_cast<size_t>(at) - 1 > kMaxRawTag)
+                return -1;
+            std::string_view tag = text.substr(static_cast<size_t>(at) + 1, quote - static_cast<size_t>(at) - 1);
+            return delim_hash(tag) == state.delim ? static_cast<int>(quote) + 1 : -1;
+        }
+        case DelimiterKind::HashRaw: {
+            // "###: the first quote followed by enough hashes closes
+            int n = 0;
+            while (static_cast<uint32_t>(n) < state.delim && at + 1 + n < len &&
+                   text[static_cast<size_t>(at + 1 + n)] == '#')
+                ++n;
+            return static_cast<uint32_t>(n) == state.delim ? at + 1 + n : -1;
+        }
+        default:
+            return starts_with_at(text, at, r.close) ? at + static_cast<int>(r.close.size()) : -1;
+    }
+}
+
+} // namespace sprawn
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <sprawn/middleware/language.h>
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace sprawn {
+
+// A LanguageDef compiled for scanning: a 256-entry byte class table for
+// code, the rules that can start at each byte (longest opener first), and
+// per-rule stop bytes so comment and string bodies are skipped with SIMD.
+class Lexer {
+public:
+    // Throws std::invalid_argument on a rule with an empty opener.
+    explicit Lexer(const LanguageDef& def);
+
+    // Tokens of one line into `tokens` (cleared first); returns the exit state.
+    LineState scan(std::string_view text, LineState entry,
+                   std::vector<Token>& tokens) const;
+
+    // Entry states that carry no captured delimiter: Normal first, then one
+    // per multi-line fixed-delimiter rule. Any line can be scanned from
+    // each of them without knowing what came before.
+    const std::vector<LineState>& simple_states() const { return simple_states_; }
+
+    size_t memory_usage() const;
+
+private:
+    // How the scan loop handles a rule once its opener matched.
+    enum class Op : uint8_t {
+        ToEol,    // token to end of line
+        Fixed,    // fixed close, no anchor, nesting or length bound
+        General,  // apply_rule()
+    };
+
+    struct Rule {
+        TokenType     type;
+        std::string   open;
+        std::string   close;
+        char          escape;
+        bool          multiline;
+        bool          nestable;
+        DelimiterKind kind;
+        RuleAnchor    anchor;
+        uint16_t      max_length;
+        uint8_t       max_code_points;
+        uint16_t      region;
+        std::array<char, 3> stops;  // bytes that may end a run of body text
+        uint32_t      open_word;    // first four opener bytes, compared masked
+        uint32_t      open_mask;
+        Op            op;
+    };
+
+    // Tries the rules whose opener starts with the byte at `pos`; returns
+    // the end of the token, or -1 if none applies.
+    int  match_rules(std::string_view text, int pos, std::vector<Token>& tokens,
+                     LineState& exit, LineState& pending) const;
+    static int fixed_end(const Rule& r, const char* p, int at, int len);
+    // Applies `r`, whose opener matches at `pos`; false if the rest of the
+    // rule (anchor, dynamic tag, length bound) does not.
+    bool apply_rule(const Rule& r, std::string_view text, int& pos, std::vector<Token>& tokens,
+                    LineState& exit, LineState& pending) const;
+    // End of the body starting at `from`, or -1 if it runs past the line.
+    // Updates the nesting depth in `state`.
+    int  body_end(const Rule& r, std::string_view text, int from, LineState& state) const;
+    // End of the closing delimiter if one starts at `at`, else -1.
+    int  close_end(const Rule& r, std::string_view text, int at, const LineState& state) const;
+    // Pushes the number starting at `pos`; returns its end.
+    int  scan_number(std::string_view text, int pos, std::vector<Token>& tokens) const;
+
+    std::vector<Rule>        rules_;
+    std::vector<uint16_t>    candidates_;   // rule indices grouped by first byte
+    std::array<uint16_t, 257> cand_begin_{};
+    // Per first byte, bit (next & 63) is set if some opener may continue
+    // with that byte: lets identifiers such as "uint" skip the rule search.
+    std::array<uint64_t, 256> second_{};
+    std::array<uint8_t, 256> cls_{};
+    // Per first byte, the rule to apply without a search: set when it is
+    // the only candidate, has a one-byte opener and is not Op::General.
+    static constexpr uint16_t kNoRule = 0xFFFF;
+    std::array<uint16_t, 256> single_{};
+    std::vector<LineState>   simple_states_;
+    NumberRule               numbers_;
+    KeywordTable             keywords_;
+};
+
+} // namespace sprawn
@@ -0,0 +1,127 @@
+#include <sprawn/middleware/line_filter.h>
+#include <sprawn/middleware/controller.h>
+#include <sprawn/worker_pool.h>
+
+#include <algorithm>
+
+namespace sprawn {
+
+LineFilter::LineFilter(const Controller& ctrl, std::string pattern, WorkerPool* pool)
+    : ctrl_(ctrl)
+    , pattern_(std::move(pattern))
+    , pool_(pool)
+{
+    rescan_all();
+}
+
+size_t LineFilter::view_line(size_t doc_line) const {
+    if (matches_.empty()) return 0;
+    auto it = std::lower_bound(matches_.begin(), matches_.end(), doc_line);
+    if (it == matches_.end()) --it;
+    return static_cast<size_t>(it - matches_.begin());
+}
+
+bool LineFilter::contains(size_t doc_line) const {
+    return std::binary_search(matches_.begin(), matches_.end(), doc_line);
+}
+
+void LineFilter::scan(size_t first, size_t last, std::vector<size_t>& out) const {
+    std::string text;
+    for (size_t line = first; line < last; ++line) {
+        ctrl_.line(line, text);
+        if (std::string_view(text).find(pattern_) != std::string_view::npos)
+            out.push_back(line);
+    }
+}
+
+void LineFilter::rescan_all() {
+    version_ = ctrl_.document_version();
+    dirty_.clear();
+    matches_.clear();
+    size_t lc     = ctrl_.line_count();
+    size_t chunks = (lc + kChunkLines - 1) / kChunkLines;
+    if (!pool_ || pool_->concurrency() < 2 || chunks < 2) {
+        scan(0, lc, matches_);
+        return;
+    }
+    // Chunks in order, so concatenating their results keeps them sorted.
+    std::vector<std::vector<size_t>> found(chunks);
+    pool_->parallel_for(chunks, [&](size_t c) {
+        scan(c * kChunkLines, std::min((c + 1) * kChunkLines, lc), found[c]);
+    });
+    size_t total = 0;
+    for (const auto& f : found) total += f.size();
+    matches_.reserve(total);
+    for (const auto& f : found) matches_.insert(matches_.end(), f.begin(), f.end());
+}
+
+void LineFilter::apply(const EditRecord& edit) {
+    // Matches on lines the edit changed are dropped (they are rescanned
+    // with the inserted lines); the rest follow their lines, in order.
+    size_t line = edit.line;
+    auto out = matches_.begin();
+    for (size_t l : matches_)
+        if (auto to = edit.map_line(l)) *out++ = *to;
+    matches_.erase(out, matches_.end());
+
+    // Ranges still waiting for a rescan follow the edit too; an end inside
+    // the changed lines moves to the edited line.
+    for (LineRange& r : dirty_) {
+        if (r.empty()) continue;
+        r.first = edit.map_line(r.first).value_or(line);
+        r.last  = edit.map_line(r.last - 1).value_or(line) + 1;
+    }
+    dirty_.push_back({line, line + edit.lines_added + 1});
+}
+
+bool LineFilter::sync() {
+    uint64_t version = ctrl_.document_version();
+    if (version == version_) return false;
+
+    replay_.clear();
+    if (!ctrl_.edit_journal().since(version_, replay_) ||
+        replay_.empty() || replay_.back().version != version)
+    {
+        // Fell behind the journal, or the document changed without an
+        // edit (a file was opened).
+        rescan_all();
+        return true;
+    }
+    for (const EditRecord& e : replay_) apply(e);
+    version_ = version;
+
+    std::sort(dirty_.begin(), dirty_.end(),
+              [](const LineRange& a, const LineRange& b) { return a.first < b.first; });
+    size_t lc = ctrl_.line_count();
+    std::vector<size_t> found;
+    LineRange run;
+    auto rescan = [&](LineRange r) {
+        r.last = std::min(r.last, lc);
+        if (r.empty()) return;
+        found.clear();
+        scan(r.first, r.last, found);
+        auto lo = std::lower_bound(matches_.begin(), matches_.end(), r.first);
+        auto hi = std::lower_bound(lo, matches_.end(), r.last);
+        lo = matches_.erase(lo, hi);
+        matches_.insert(lo, found.begin(), found.end());
+    };
+    for (const LineRange& r : dirty_) {
+        if (!run.empty() && r.first <= run.last) {
+            run.merge(r);
+            continue;
+        }
+        rescan(run);
+        run = r;
+    }
+    rescan(run);
+    dirty_.clear();
+    return true;
+}
+
+size_t LineFilter::memory_usage() const {
+    return matches_.capacity() * sizeof(size_t) + pattern_.capacity()
+         + dirty_.capacity() * sizeof(LineRange)
+         + replay_.capacity() * sizeof(EditRecord);
+}
+
+} // namespace sprawn
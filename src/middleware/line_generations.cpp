@@ -0,0 +1,33 @@
+#include <sprawn/middleware/line_generations.h>
+
+namespace sprawn {
+
+uint64_t LineGenerations::bump(LineRange lines) {
+    if (lines.empty()) return next_ - 1;
+    if (runs_.size() >= kMaxRuns) return bump_all();
+
+    uint64_t gen   = next_++;
+    uint64_t after = at(lines.last);
+    runs_.erase(runs_.lower_bound(lines.first), runs_.lower_bound(lines.last));
+    runs_[lines.first] = gen;
+    runs_.emplace(lines.last, after);  // no-op if a run already starts there
+    return gen;
+}
+
+uint64_t LineGenerations::bump_all() {
+    uint64_t gen = next_++;
+    runs_.clear();
+    runs_.emplace(0, gen);
+    return gen;
+}
+
+uint64_t LineGenerations::at(size_t line) const {
+    return std::prev(runs_.upper_bound(line))->second;
+}
+
+size_t LineGenerations::memory_usage() const {
+    // Red-black tree node: three links and a color next to the pair.
+    return runs_.size() * (sizeof(std::pair<const size_t, uint64_t>) + 4 * sizeof(void*));
+}
+
+} // namespace sprawn
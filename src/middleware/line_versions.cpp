@@ -0,0 +1,52 @@
+#include <sprawn/middleware/line_versions.h>
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace sprawn {
+
+void LineVersions::reset(size_t line_count) {
+    runs_.clear();
+    runs_.emplace(0, next_);
+    // One past the last line as well: stamps of appended lines come from
+    // edits, which hand out fresh ones anyway.
+    next_ += line_count + 1;
+    line_count_ = line_count;
+}
+
+uint64_t LineVersions::at(size_t line) const {
+    auto it = std::prev(runs_.upper_bound(line));
+    return it->second + (line - it->first);
+}
+
+void LineVersions::apply(const EditRecord& edit) {
+    size_t line  = edit.line;
+    size_t added = edit.lines_added;
+    line_count_ = static_cast<size_t>(static_cast<long long>(line_count_) + edit.line_delta());
+    if (runs_.size() >= kMaxRuns) {
+        reset(line_count_);
+        return;
+    }
+
+    // `line` and the inserted lines (line, line + added] get new stamps;
+    // the first line after the edit keeps its stamp, and so do the rest
+    // through their runs, at the numbers map_line() gives them.
+    size_t   next_line = line + edit.lines_removed + 1;
+    uint64_t after     = at(next_line);
+    auto tail = runs_.upper_bound(next_line);
+    std::vector<std::pair<size_t, uint64_t>> moved(tail, runs_.end());
+    runs_.erase(runs_.lower_bound(line), runs_.end());
+
+    runs_[line] = next_;
+    next_ += added + 1;
+    runs_.emplace(*edit.map_line(next_line), after);
+    for (const auto& [first, base] : moved) runs_.emplace(*edit.map_line(first), base);
+}
+
+size_t LineVersions::memory_usage() const {
+    // Red-black tree node: three links and a color next to the pair.
+    return runs_.size() * (sizeof(std::pair<const size_t, uint64_t>) + 4 * sizeof(void*));
+}
+
+} // namespace sprawn
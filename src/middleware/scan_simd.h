@@ -0,0 +1,86 @@
+#pragma once
+
+// Byte-run helpers for the syntax scanner. Each processes 16 bytes per step
+// with SSE2 where available (all x86-64) and falls back to a scalar loop.
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPRAWN_SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace sprawn::scan {
+
+inline bool is_ident_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+inline bool is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Length of the leading run of [A-Za-z0-9_] in p[0, n).
+inline size_t ident_run(const char* p, size_t n) {
+    size_t i = 0;
+#ifdef SPRAWN_SCAN_SSE2
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i a_lo = _mm_set1_epi8('a' - 1), z_hi = _mm_set1_epi8('z' + 1);
+    const __m128i d_lo = _mm_set1_epi8('0' - 1), d_hi = _mm_set1_epi8('9' + 1);
+    const __m128i under = _mm_set1_epi8('_');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        // Folding case maps only letters into 'a'..'z'; bytes >= 0x80 are
+        // negative in the signed compares and never match.
+        __m128i lower = _mm_or_si128(v, case_bit);
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, a_lo), _mm_cmpgt_epi8(z_hi, lower));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, d_lo), _mm_cmpgt_epi8(d_hi, v));
+        __m128i ident = _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(v, under));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(ident));
+        if (mask != 0xFFFF)
+            return i + static_cast<size_t>(std::countr_one(mask));
+    }
+#endif
+    while (i < n && is_ident_char(p[i])) ++i;
+    return i;
+}
+
+// Length of the leading run of spaces and tabs in p[0, n).
+inline size_t blank_run(const char* p, size_t n) {
+    size_t i = 0;
+#ifdef SPRAWN_SCAN_SSE2
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(blank));
+        if (mask != 0xFFFF)
+            return i + static_cast<size_t>(std::countr_one(mask));
+    }
+#endif
+    while (i < n && is_blank(p[i])) ++i;
+    return i;
+}
+
+// Index of the first byte equal to a, b or c in p[0, n), or n.
+inline size_t find_any(const char* p, size_t n, char a, char b, char c) {
+    size_t i = 0;
+#ifdef SPRAWN_SCAN_SSE2
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vc = _mm_set1_epi8(c);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+                                   _mm_cmpeq_epi8(v, vc));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (mask != 0)
+            return i + static_cast<size_t>(std::countr_zero(mask));
+    }
+#endif
+    while (i < n && p[i] != a && p[i] != b && p[i] != c) ++i;
+    return i;
+}
+
+} // namespace sprawn::scan
@@ -1,8 +1,11 @@
 #include <sprawn/middleware/syntax_highlighter.h>
 #include <sprawn/middleware/controller.h>
 
+#include <sprawn/worker_pool.h>
+
+#include "lexer.h"
+
 #include <algorithm>
-#include <cctype>
 
 namespace sprawn {
 
@@ -36,62 +39,6 @@ SyntaxTheme SyntaxTheme::dark_default() {
     return t;
 }
 
-// ---------------------------------------------------------------------------
-// LanguageDef
-// ---------------------------------------------------------------------------
-
-LanguageDef LanguageDef::cpp() {
-    LanguageDef d;
-    d.keywords = {
-        "alignas", "alignof", "and", "and_eq", "asm", "auto",
-        "bitand", "bitor", "break",
-        "case", "catch", "class", "co_await", "co_return", "co_yield",
-        "compl", "concept", "const", "const_cast", "consteval",
-        "constexpr", "constinit", "continue",
-        "decltype", "default", "delete", "do", "dynamic_cast",
-        "else", "enum", "explicit", "export", "extern",
-        "false", "for", "friend",
-        "goto",
-        "if", "inline",
-        "module", "mutable",
-        "namespace", "new", "noexcept", "not", "not_eq", "nullptr",
-        "operator", "or", "or_eq",
-        "private", "protected", "public",
-        "register", "reinterpret_cast", "requires", "return",
-        "sizeof", "static", "static_assert", "static_cast",
-        "struct", "switch",
-        "template", "this", "throw", "true", "try", "typedef",
-        "typeid", "typename",
-        "union", "using",
-        "virtual", "volatile",
-        "while",
-        "xor", "xor_eq",
-    };
-    d.types = {
-        "bool", "char", "char8_t", "char16_t", "char32_t",
-        "double", "float",
-        "int", "int8_t", "int16_t", "int32_t", "int64_t",
-        "long",
-        "short", "signed",
-        "size_t", "ssize_t",
-        "uint8_t", "uint16_t", "uint32_t", "uint64_t",
-        "unsigned",
-        "void", "wchar_t",
-        "string", "string_view", "vector", "map", "set",
-        "unordered_map", "unordered_set", "array", "pair", "tuple",
-        "shared_ptr", "unique_ptr", "weak_ptr",
-        "optional", "variant", "any",
-        "FILE",
-    };
-    std::sort(d.keywords.begin(), d.keywords.end());
-    std::sort(d.types.begin(), d.types.end());
-    d.line_comment = "//";
-    d.block_open   = "/*";
-    d.block_close  = "*/";
-    d.extensions   = {".cpp", ".cxx", ".cc", ".c", ".h", ".hpp", ".hxx", ".inl"};
-    return d;
-}
-
 // ---------------------------------------------------------------------------
 // SyntaxHighlighter
 // ---------------------------------------------------------------------------
@@ -99,31 +46,45 @@ LanguageDef LanguageDef::cpp() {
 SyntaxHighlighter::SyntaxHighlighter(Controller& ctrl)
     : ctrl_(ctrl)
     , theme_(SyntaxTheme::dark_default())
-{}
+{
+    reset_states();
+}
 
 void SyntaxHighlighter::set_language(const LanguageDef& lang) {
     lang_   = lang;
     active_ = true;
-    entry_state_.clear();
-    states_valid_up_to_ = 0;
+    if (lang_.keyword_table.empty())
+        lang_.keyword_table = KeywordTable(lang_.keywords, lang_.types);
+    lexer_  = std::make_shared<const Lexer>(lang_);
+    reset_states();
+    publish_dirty({0, known_line_count_});
+}
+
+void SyntaxHighlighter::reset_states() {
+    checkpoints_.assign(1, Checkpoint{0, LineState::Normal});
+    frontier_       = 0;
+    frontier_state_ = LineState::Normal;
+    window_.clear();
+    speculative_ = {};
+    token_cache_.clear();
+    spare_nodes_.clear();
+    known_line_count_ = ctrl_.line_count();
 }
 
-void SyntaxHighlighter::detect_language(const std::filesystem::path& filepath) {
-    std::string ext = filepath.extension().string();
-    if (ext.empty()) {
-        active_ = false;
+void SyntaxHighlighter::detect_language(const std::filesystem::path& filepath,
+                                        const LanguageRegistry& registry) {
+    std::string first_line = ctrl_.line_count() > 0 ? ctrl_.line(0) : std::string();
+    if (const LanguageDef* lang = registry.detect(filepath, first_line)) {
+        set_language(*lang);
         return;
     }
-    auto cpp_lang = LanguageDef::cpp();
-    for (const auto& e : cpp_lang.extensions) {
-        if (e == ext) {
-            set_language(cpp_lang);
-            return;
-        }
-    }
     active_ = false;
 }
 
+std::string_view SyntaxHighlighter::language_name() const {
+    return active_ ? std::string_view(lang_.name) : std::string_view();
+}
+
 std::string_view SyntaxHighlighter::name() const {
     return "syntax";
 }
@@ -132,250 +93,417 @@ int SyntaxHighlighter::base_priority() const {
     return 0;
 }
 
-void SyntaxHighlighter::on_edit(size_t line, size_t /*col*/,
-                                 std::string_view /*text*/, bool /*is_insert*/) {
+size_t SyntaxHighlighter::memory_usage() const {
+    size_t bytes = checkpoints_.capacity() * sizeof(Checkpoint)
+                 + window_.capacity() * sizeof(LineState)
+                 + token_cache_.bucket_count() * sizeof(void*);
+    for (const auto& [line, c] : token_cache_)
+        bytes += sizeof(line) + sizeof(CachedLine) + 2 * sizeof(void*)
+               + c.tokens.capacity() * sizeof(Token);
+    for (const auto& n : spare_nodes_)
+        bytes += sizeof(size_t) + sizeof(CachedLine) + 2 * sizeof(void*)
+               + n.mapped().tokens.capacity() * sizeof(Token);
+    bytes += spare_nodes_.capacity() * sizeof(spare_nodes_[0])
+           + line_buf_.capacity() + scratch_tokens_.capacity() * sizeof(Token)
+           + (lexer_ ? lexer_->memory_usage() : 0);
+    for (const auto& k : lang_.keywords) bytes += sizeof(std::string) + k.capacity();
+    for (const auto& t : lang_.types)    bytes += sizeof(std::string) + t.capacity();
+    return bytes;
+}
+
+TokenCacheStats SyntaxHighlighter::token_cache_stats() const {
+    TokenCacheStats s = cache_stats_;
+    s.entries  = token_cache_.size();
+    s.capacity = kTokenCacheCapacity;
+    return s;
+}
+
+void SyntaxHighlighter::on_edit(const EditRecord& edit) {
     if (!active_) return;
-    if (line < states_valid_up_to_) {
-        states_valid_up_to_ = line;
+    window_.clear();
+
+    // New lines (line, line + added] appeared; everything stored for the
+    // lines past the edit moves to where map_line() puts it.
+    size_t line  = edit.line;
+    size_t added = edit.lines_added;
+    size_t lc    = ctrl_.line_count();
+    known_line_count_ = lc;
+
+    // Cached tokens of the touched lines are dropped.
+    std::unordered_map<size_t, CachedLine> shifted;
+    shifted.reserve(token_cache_.size());
+    for (auto& [l, c] : token_cache_)
+        if (auto to = edit.map_line(l)) shifted.emplace(*to, std::move(c));
+    token_cache_.swap(shifted);
+
+    // Ends inside the changed lines move to the edited line, which is
+    // published dirty below anyway.
+    if (!speculative_.empty()) {
+        speculative_.first = edit.map_line(speculative_.first).value_or(line);
+        speculative_.last  = std::min(edit.map_line(speculative_.last - 1).value_or(line) + 1, lc);
+    }
+
+    size_t touched_end = line + added;
+    publish_dirty({line, std::min(touched_end + 1, lc)});
+    if (line >= frontier_) return;
+
+    std::optional<size_t> frontier = edit.map_line(frontier_);
+    if (!frontier) {
+        // The frontier itself was erased: fall back to the last checkpoint
+        // at or before the edit, whose entry state the edit cannot change.
+        auto it = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), line,
+                                   [](size_t l, const Checkpoint& c) { return l < c.line; });
+        checkpoints_.erase(it, checkpoints_.end());
+        frontier_       = checkpoints_.back().line;
+        frontier_state_ = checkpoints_.back().state;
+        return;
+    }
+
+    // Checkpoints past the edit keep their states at their new line numbers
+    // until the rescan shows otherwise.
+    auto out = checkpoints_.begin();
+    // One at `line` stays: it is the state the line is entered in.
+    for (const Checkpoint& c : checkpoints_) {
+        if (c.line == line)
+            *out++ = c;
+        else if (auto to = edit.map_line(c.line))
+            *out++ = {*to, c.state};
+    }
+    checkpoints_.erase(out, checkpoints_.end());
+    frontier_ = *frontier;
+
+    rescan_until_converged(line, touched_end);
+}
+
+void SyntaxHighlighter::rescan_until_converged(size_t line, size_t touched_end) {
+    // Cached lines and the first touched lines (about to be drawn) are
+    // rescanned into the cache; others go through the scratch buffers so a
+    // long rescan does not evict the viewport. Lines without cached tokens
+    // have not been drawn recently and are not reported.
+    size_t dirty_end = 0;
+    auto exit_of = [&](size_t i, LineState entry) {
+        auto it = token_cache_.find(i);
+        bool fresh = i >= line && i <= touched_end && i - line < kTokenCacheCapacity / 4;
+        if (it != token_cache_.end() || fresh) {
+            if (it != token_cache_.end() && it->second.entry != entry) dirty_end = i + 1;
+            return scan_cached(i, entry).exit;
+        }
+        ctrl_.line(i, line_buf_);
+        return scan_line(line_buf_, entry, scratch_tokens_);
+    };
+
+    auto cp = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), line,
+                               [](size_t l, const Checkpoint& c) { return l < c.line; }) - 1;
+    size_t    next_cp = static_cast<size_t>(cp - checkpoints_.begin()) + 1;
+    size_t    last_cp = cp->line;
+    LineState state   = cp->state;
+    for (size_t i = cp->line; i < line; ++i) state = exit_of(i, state);
+
+    size_t scanned = 0;
+    for (size_t i = line; i < frontier_;) {
+        state = exit_of(i, state);
+        ++i;
+        if (next_cp < checkpoints_.size() && checkpoints_[next_cp].line == i) {
+            if (checkpoints_[next_cp].state == state) break;  // converged
+            checkpoints_[next_cp].state = state;
+            last_cp = i;
+            ++next_cp;
+        }
+        if (i == frontier_) {
+            // Lines past the frontier were decorated from the old state.
+            if (frontier_state_ != state) dirty_end = known_line_count_;
+            frontier_state_ = state;
+            break;
+        }
+        if (i - last_cp >= kCheckpointInterval) {
+            checkpoints_.insert(checkpoints_.begin() + static_cast<ptrdiff_t>(next_cp), {i, state});
+            last_cp = i;
+            ++next_cp;
+        }
+        if (++scanned >= kMaxSyncLines) {
+            // Still diverging: the background pass takes it from here and
+            // every later line may change.
+            checkpoints_.erase(checkpoints_.begin() + static_cast<ptrdiff_t>(next_cp),
+                               checkpoints_.end());
+            frontier_       = i;
+            frontier_state_ = state;
+            dirty_end       = known_line_count_;
+            break;
+        }
     }
-    // Resize to match document — the vector will be grown lazily in ensure_states
+    publish_dirty({line, dirty_end});
+}
+
+bool SyntaxHighlighter::on_idle(std::chrono::steady_clock::time_point deadline) {
+    if (!active_) return false;
+    using clock = std::chrono::steady_clock;
+    constexpr size_t kSlice = 1024;
     size_t lc = ctrl_.line_count();
-    if (entry_state_.size() > lc + 1) {
-        entry_state_.resize(lc + 1);
+    bool parallel = pool_ && pool_->concurrency() > 1;
+    // Steps sized to what is left of the budget at the rate measured so
+    // far, the deadline checked between them; the estimates follow the
+    // measured times.
+    auto now = clock::now();
+    do {
+        if (frontier_ >= lc) break;
+        double left   = std::max(std::chrono::duration<double, std::nano>(deadline - now).count(), 0.0);
+        size_t before = frontier_;
+        size_t chunk  = parallel ? static_cast<size_t>(left / parallel_ns_per_line_) : 0;
+        chunk = std::min(chunk / kCheckpointInterval * kCheckpointInterval, kParallelChunkLines);
+        bool   round = chunk > 0 && lc - frontier_ > chunk;
+        if (round) {
+            advance_frontier_parallel(*pool_, chunk);
+        } else {
+            size_t fit = static_cast<size_t>(left / serial_ns_per_line_);
+            advance_frontier(frontier_ + std::clamp(fit, kMinIdleLines, kSlice));
+        }
+        auto   after = clock::now();
+        double ns    = std::chrono::duration<double, std::nano>(after - now).count();
+        double units = static_cast<double>(round ? chunk : frontier_ - before);
+        double& rate = round ? parallel_ns_per_line_ : serial_ns_per_line_;
+        if (units > 0) rate = (rate + std::max(ns / units, 1.0)) / 2;
+        now = after;
+    } while (now < deadline);
+    // A speculative window is dropped once the real state has caught up
+    // with it, and the guessed lines now behind the frontier are published
+    // so frontends recomposite them.
+    if (window_speculative_ && !window_.empty() && window_first_ <= frontier_)
+        window_.clear();
+    if (!speculative_.empty() && speculative_.first <= frontier_) {
+        publish_dirty({speculative_.first, std::min(speculative_.last, frontier_ + 1)});
+        speculative_.first = frontier_ + 1;
+        if (speculative_.empty()) speculative_ = {};
     }
+    return frontier_ < lc;
+}
+
+bool SyntaxHighlighter::is_speculative(size_t line) const {
+    return active_ && line > frontier_ && !window_.empty() && window_speculative_ &&
+           line >= window_first_ && line < window_first_ + window_.size();
 }
 
 LineDecoration SyntaxHighlighter::decorate(size_t line_number) const {
     LineDecoration result;
     if (!active_) return result;
 
-    ensure_states(line_number);
-
-    LineState entry = (line_number < entry_state_.size())
-                          ? entry_state_[line_number]
-                          : LineState::Normal;
+    LineState entry = entry_state(line_number);
+    const CachedLine& cached = scan_cached(line_number, entry);
 
-    std::string text = ctrl_.line(line_number);
-    auto [tokens, _] = scan_line(text, entry);
-
-    result.spans.reserve(tokens.size());
-    for (const auto& tok : tokens) {
+    result.spans.reserve(cached.tokens.size());
+    for (const auto& tok : cached.tokens) {
         const TextStyle& s = theme_.style_for(tok.type);
         result.spans.push_back({tok.byte_start, tok.byte_end, s, 0});
     }
     return result;
 }
 
-// ---------------------------------------------------------------------------
-// Lazy multi-line state
-// ---------------------------------------------------------------------------
-
-void SyntaxHighlighter::ensure_states(size_t line_number) const {
-    size_t lc = ctrl_.line_count();
-    if (entry_state_.empty()) {
-        entry_state_.resize(lc + 1, LineState::Normal);
-        states_valid_up_to_ = 0;
-    }
-    if (entry_state_.size() < lc + 1) {
-        entry_state_.resize(lc + 1, LineState::Normal);
-    }
-
-    // Scan forward from states_valid_up_to_ up to and including line_number
-    for (size_t i = states_valid_up_to_; i <= line_number && i < lc; ++i) {
-        std::string text = ctrl_.line(i);
-        auto [tokens, exit_state] = scan_line(text, entry_state_[i]);
-        LineState next = exit_state;
-        if (i + 1 < entry_state_.size()) {
-            if (entry_state_[i + 1] == next && i >= states_valid_up_to_) {
-                // State matches — everything beyond is still valid
-                states_valid_up_to_ = i + 1;
-                if (i >= line_number) break;
-                continue;
-            }
-            entry_state_[i + 1] = next;
+void SyntaxHighlighter::decorate_range(size_t first, size_t last, DecorationBuffer& out) const {
+    for (size_t line = first; line < last; ++line) {
+        if (active_) {
+            const CachedLine& cached = scan_cached(line, entry_state(line));
+            for (const auto& tok : cached.tokens)
+                out.push({tok.byte_start, tok.byte_end, theme_.style_for(tok.type), 0});
         }
-        states_valid_up_to_ = i + 1;
+        out.end_line();
     }
 }
 
 // ---------------------------------------------------------------------------
-// Hand-written scanner
+// Checkpointed multi-line state
 // ---------------------------------------------------------------------------
 
-static bool is_ident_start(char c) {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
-}
-
-static bool is_ident_char(char c) {
-    return is_ident_start(c) || (c >= '0' && c <= '9');
-}
-
-static bool is_digit(char c) {
-    return c >= '0' && c <= '9';
-}
-
-static bool is_hex_digit(char c) {
-    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+void SyntaxHighlighter::advance_frontier(size_t target_line) const {
+    size_t lc = ctrl_.line_count();
+    if (target_line > lc) target_line = lc;
+    while (frontier_ < target_line) {
+        ctrl_.line(frontier_, line_buf_);
+        frontier_state_ = scan_line(line_buf_, frontier_state_, scratch_tokens_);
+        ++frontier_;
+        if (frontier_ - checkpoints_.back().line >= kCheckpointInterval)
+            checkpoints_.push_back({frontier_, frontier_state_});
+    }
 }
 
-ScanResult SyntaxHighlighter::scan_line(std::string_view text, LineState entry) const {
-    std::vector<Token> tokens;
-    int pos = 0;
-    int len = static_cast<int>(text.size());
-
-    // 1. Continue block comment from previous line
-    if (entry == LineState::InBlockComment) {
-        int close = -1;
-        for (int i = 0; i + 1 < len; ++i) {
-            if (text[i] == '*' && text[i + 1] == '/') {
-                close = i + 2;
-                break;
+// Each chunk's effect on the lexer state is a function from its entry state
+// to its exit state. Workers evaluate that function for every simple entry
+// state (Normal, inside a block comment, ...) without knowing the real one;
+// a sequential pass over the chunks then picks the run matching the actual
+// entry, which is the previous chunk's exit. A run from a non-Normal state
+// usually rejoins the Normal run within a few lines and stops there.
+void SyntaxHighlighter::advance_frontier_parallel(WorkerPool& pool, size_t chunk_lines) const {
+    // Start chunks on a checkpoint so their checkpoints fall on the grid.
+    if (frontier_ != checkpoints_.back().line)
+        advance_frontier(checkpoints_.back().line + kCheckpointInterval);
+
+    size_t lc     = ctrl_.line_count();
+    size_t first  = frontier_;
+    size_t chunks = std::min(pool.concurrency(), (lc - first + chunk_lines - 1) / chunk_lines);
+    if (chunks == 0) return;
+
+    // exits[r][i]: exit state of line begin + i when the chunk is entered in
+    // the r-th state. Chunk 0 is entered in the known frontier state only.
+    const std::vector<LineState>& simple = lexer_->simple_states();
+    std::vector<std::vector<std::vector<LineState>>> exits(chunks);
+    auto scan_chunk = [&](size_t begin, size_t end, LineState entry,
+                          const std::vector<LineState>* rejoin, std::vector<LineState>& out,
+                          std::string& buf, std::vector<Token>& tokens) {
+        out.resize(end - begin);
+        LineState state = entry;
+        for (size_t i = begin; i < end; ++i) {
+            ctrl_.line(i, buf);
+            state = lexer_->scan(buf, state, tokens);
+            out[i - begin] = state;
+            if (rejoin && (*rejoin)[i - begin] == state) {
+                std::copy(rejoin->begin() + static_cast<ptrdiff_t>(i - begin) + 1, rejoin->end(),
+                          out.begin() + static_cast<ptrdiff_t>(i - begin) + 1);
+                return;
             }
         }
-        if (close < 0) {
-            tokens.push_back({0, len, TokenType::Comment});
-            return {std::move(tokens), LineState::InBlockComment};
+    };
+    pool.parallel_for(chunks, [&](size_t c) {
+        size_t begin = first + c * chunk_lines;
+        size_t end   = std::min(begin + chunk_lines, lc);
+        std::string        buf;
+        std::vector<Token> tokens;
+        auto& runs = exits[c];
+        runs.resize(c == 0 ? 1 : simple.size());
+        scan_chunk(begin, end, c == 0 ? frontier_state_ : simple[0], nullptr, runs[0], buf, tokens);
+        for (size_t r = 1; r < runs.size(); ++r)
+            scan_chunk(begin, end, simple[r], &runs[0], runs[r], buf, tokens);
+    });
+
+    // Prefix pass: chain the chunks through their actual entry states.
+    std::vector<LineState> fallback;
+    for (size_t c = 0; c < chunks; ++c) {
+        size_t begin = frontier_;
+        size_t end   = std::min(begin + chunk_lines, lc);
+        const std::vector<LineState>* run = &exits[c][0];
+        if (c > 0) {
+            auto it = std::find(simple.begin(), simple.end(), frontier_state_);
+            if (it != simple.end()) {
+                run = &exits[c][static_cast<size_t>(it - simple.begin())];
+            } else {
+                // Entered with a captured delimiter (raw string, heredoc).
+                scan_chunk(begin, end, frontier_state_, nullptr, fallback,
+                           line_buf_, scratch_tokens_);
+                run = &fallback;
+            }
         }
-        tokens.push_back({0, close, TokenType::Comment});
-        pos = close;
+        for (size_t i = 0; i < run->size(); ++i) {
+            if ((begin + i + 1 - checkpoints_.back().line) >= kCheckpointInterval)
+                checkpoints_.push_back({begin + i + 1, (*run)[i]});
+        }
+        frontier_       = end;
+        frontier_state_ = run->back();
     }
+}
 
-    while (pos < len) {
-        char c = text[pos];
-
-        // 2. Line comment
-        if (c == '/' && pos + 1 < len && text[pos + 1] == '/') {
-            tokens.push_back({pos, len, TokenType::Comment});
-            return {std::move(tokens), LineState::Normal};
-        }
+LineState SyntaxHighlighter::entry_state(size_t line_number) const {
+    if (window_.empty() || line_number < window_first_ ||
+        line_number >= window_first_ + window_.size())
+    {
+        fill_window(line_number);
+    }
+    return window_[line_number - window_first_];
+}
 
-        // 3. Block comment start
-        if (c == '/' && pos + 1 < len && text[pos + 1] == '*') {
-            int start = pos;
-            pos += 2;
-            while (pos + 1 < len) {
-                if (text[pos] == '*' && text[pos + 1] == '/') {
-                    pos += 2;
-                    tokens.push_back({start, pos, TokenType::Comment});
-                    goto next;
-                }
-                ++pos;
-            }
-            // Check last char pair
-            if (pos < len) ++pos;
-            tokens.push_back({start, len, TokenType::Comment});
-            return {std::move(tokens), LineState::InBlockComment};
-        next:
-            continue;
-        }
+void SyntaxHighlighter::fill_window(size_t line_number) const {
+    if (line_number > frontier_ && line_number - frontier_ <= kMaxSyncLines)
+        advance_frontier(line_number);
+
+    size_t    first;
+    LineState state;
+    if (line_number <= frontier_) {
+        auto it = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), line_number,
+                                   [](size_t l, const Checkpoint& c) { return l < c.line; });
+        --it;
+        first = it->line;
+        state = it->state;
+        window_speculative_ = false;
+    } else {
+        // Too far ahead of the frontier: guess Normal at the block start.
+        first = line_number - line_number % kCheckpointInterval;
+        state = LineState::Normal;
+        window_speculative_ = true;
+    }
 
-        // 4. Preprocessor directive: # at first non-whitespace
-        if (c == '#') {
-            // Check that everything before pos is whitespace
-            bool leading_ws = true;
-            for (int i = 0; i < pos; ++i) {
-                if (text[i] != ' ' && text[i] != '\t') {
-                    leading_ws = false;
-                    break;
-                }
-            }
-            if (leading_ws) {
-                tokens.push_back({pos, len, TokenType::Preprocessor});
-                return {std::move(tokens), LineState::Normal};
-            }
-        }
+    size_t lc   = ctrl_.line_count();
+    size_t last = std::max(std::min(first + kCheckpointInterval, lc), line_number + 1);
+    known_line_count_ = lc;
+
+    // Lines scanned here land in the token cache, so decorating the rest of
+    // the block is a lookup rather than a second scan.
+    window_first_ = first;
+    window_.clear();
+    window_.reserve(last - first);
+    if (window_speculative_) speculative_.merge({first, last});
+    for (size_t i = first; i < last; ++i) {
+        window_.push_back(state);
+        if (i + 1 < last && i < lc)
+            state = scan_cached(i, state).exit;
+    }
+}
 
-        // 5. String literal
-        if (c == '"') {
-            int start = pos;
-            ++pos;
-            while (pos < len) {
-                if (text[pos] == '\\') {
-                    pos += 2;
-                    continue;
-                }
-                if (text[pos] == '"') {
-                    ++pos;
-                    break;
-                }
-                ++pos;
-            }
-            tokens.push_back({start, pos, TokenType::StringLiteral});
-            continue;
+const SyntaxHighlighter::CachedLine&
+SyntaxHighlighter::scan_cached(size_t line_number, LineState entry) const {
+    auto it = token_cache_.find(line_number);
+    if (it != token_cache_.end() && it->second.entry == entry) {
+        ++cache_stats_.hits;
+        return it->second;
+    }
+    ++cache_stats_.misses;
+
+    if (it == token_cache_.end()) {
+        if (token_cache_.size() >= kTokenCacheCapacity)
+            evict_far_from(line_number);
+        if (spare_nodes_.empty()) {
+            it = token_cache_.emplace(line_number, CachedLine{}).first;
+        } else {
+            auto node = std::move(spare_nodes_.back());
+            spare_nodes_.pop_back();
+            node.key() = line_number;
+            it = token_cache_.insert(std::move(node)).position;
         }
+    }
+    ctrl_.line(line_number, line_buf_);
+    it->second.entry = entry;
+    it->second.exit  = scan_line(line_buf_, entry, it->second.tokens);
+    return it->second;
+}
 
-        // 6. Char literal
-        if (c == '\'') {
-            int start = pos;
-            ++pos;
-            while (pos < len) {
-                if (text[pos] == '\\') {
-                    pos += 2;
-                    continue;
-                }
-                if (text[pos] == '\'') {
-                    ++pos;
-                    break;
-                }
-                ++pos;
-            }
-            tokens.push_back({start, pos, TokenType::CharLiteral});
-            continue;
-        }
+void SyntaxHighlighter::evict_far_from(size_t line_number) const {
+    // Keep the three quarters of the cache closest to the line being
+    // decorated; the viewport moves far less often than it redraws.
+    std::vector<std::pair<size_t, size_t>> by_distance;  // {distance, line}
+    by_distance.reserve(token_cache_.size());
+    for (const auto& [l, _] : token_cache_)
+        by_distance.emplace_back(l > line_number ? l - line_number : line_number - l, l);
+    size_t keep = kTokenCacheCapacity * 3 / 4;
+    std::nth_element(by_distance.begin(), by_distance.begin() + static_cast<ptrdiff_t>(keep),
+                     by_distance.end());
+    for (size_t i = keep; i < by_distance.size(); ++i) {
+        spare_nodes_.push_back(token_cache_.extract(by_distance[i].second));
+        ++cache_stats_.evictions;
+    }
+}
 
-        // 7. Number
-        if (is_digit(c) || (c == '.' && pos + 1 < len && is_digit(text[pos + 1]))) {
-            int start = pos;
-            if (c == '0' && pos + 1 < len && (text[pos + 1] == 'x' || text[pos + 1] == 'X')) {
-                // Hex
-                pos += 2;
-                while (pos < len && (is_hex_digit(text[pos]) || text[pos] == '\'')) ++pos;
-            } else if (c == '0' && pos + 1 < len && (text[pos + 1] == 'b' || text[pos + 1] == 'B')) {
-                // Binary
-                pos += 2;
-                while (pos < len && (text[pos] == '0' || text[pos] == '1' || text[pos] == '\'')) ++pos;
-            } else {
-                // Decimal / float
-                while (pos < len && (is_digit(text[pos]) || text[pos] == '\'')) ++pos;
-                if (pos < len && text[pos] == '.') {
-                    ++pos;
-                    while (pos < len && (is_digit(text[pos]) || text[pos] == '\'')) ++pos;
-                }
-                if (pos < len && (text[pos] == 'e' || text[pos] == 'E')) {
-                    ++pos;
-                    if (pos < len && (text[pos] == '+' || text[pos] == '-')) ++pos;
-                    while (pos < len && is_digit(text[pos])) ++pos;
-                }
-            }
-            // Integer/float suffixes: u, l, ll, f, etc.
-            while (pos < len && (text[pos] == 'u' || text[pos] == 'U' ||
-                                 text[pos] == 'l' || text[pos] == 'L' ||
-                                 text[pos] == 'f' || text[pos] == 'F')) ++pos;
-            tokens.push_back({start, pos, TokenType::Number});
-            continue;
-        }
+// ---------------------------------------------------------------------------
+// Scanner
+// ---------------------------------------------------------------------------
 
-        // 8. Identifier / keyword / type
-        if (is_ident_start(c)) {
-            int start = pos;
-            while (pos < len && is_ident_char(text[pos])) ++pos;
-            std::string_view word = text.substr(start, pos - start);
-            std::string word_str(word);
-
-            if (std::binary_search(lang_.keywords.begin(), lang_.keywords.end(), word_str)) {
-                tokens.push_back({start, pos, TokenType::Keyword});
-            } else if (std::binary_search(lang_.types.begin(), lang_.types.end(), word_str)) {
-                tokens.push_back({start, pos, TokenType::Type});
-            }
-            // Plain identifiers → no token (gaps get default style)
-            continue;
-        }
+ScanResult SyntaxHighlighter::scan_line(std::string_view text, LineState entry) const {
+    ScanResult r;
+    r.exit_state = scan_line(text, entry, r.tokens);
+    return r;
+}
 
-        // 9. Skip anything else
-        ++pos;
+LineState SyntaxHighlighter::scan_line(std::string_view text, LineState entry,
+                                       std::vector<Token>& tokens) const {
+    if (!lexer_) {
+        tokens.clear();
+        return LineState::Normal;
     }
-
-    return {std::move(tokens), LineState::Normal};
+    return lexer_->scan(text, entry, tokens);
 }
 
 } // namespace sprawn
@@ -1,13 +1,20 @@
 #include <doctest/doctest.h>
 
 #include <sprawn/document.h>
+#include <sprawn/middleware/async_decoration_source.h>
 #include <sprawn/middleware/controller.h>
+#include <sprawn/middleware/line_filter.h>
+#include <sprawn/worker_pool.h>
 
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <unistd.h>
 
@@ -90,3 +97,627 @@ TEST_CASE("Controller: non-copyable and non-movable") {
     static_assert(!std::is_move_constructible_v<Controller>);
     static_assert(!std::is_move_assignable_v<Controller>);
 }
+
+TEST_CASE("Controller: memory report includes decoration sources and JSON") {
+    struct Fixed : DecorationSource {
+        LineDecoration decorate(size_t) const override { return {}; }
+        std::string_view name() const override { return "fixed"; }
+        size_t memory_usage() const override { return 1234; }
+    };
+
+    TempFile file("Hello\nWorld\n");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    ctrl.add_decoration_source(std::make_shared<Fixed>());
+
+    MemoryReport report = ctrl.memory_report();
+    bool found = false;
+    for (const auto& e : report.entries)
+        if (e.name == "middleware.fixed" && e.bytes == 1234) found = true;
+    CHECK(found);
+    CHECK(report.heap_total() >= 1234);
+
+    std::string json = report.to_json();
+    CHECK(json.front() == '{');
+    CHECK(json.back() == '}');
+    CHECK(json.find("\"middleware.fixed\":1234") != std::string::npos);
+    CHECK(json.find("\"mapped_bytes\":12") != std::string::npos);
+}
+
+TEST_CASE("Controller: range decorations match per-line queries") {
+    // Marks every line with one span whose end encodes the line number.
+    struct PerLine : DecorationSource {
+        int prio;
+        explicit PerLine(int p) : prio(p) {}
+        LineDecoration decorate(size_t line) const override {
+            LineDecoration d;
+            d.spans.push_back({0, static_cast<int>(line) + 1, TextStyle{}, 1});
+            return d;
+        }
+        std::string_view name() const override { return prio == 10 ? "a" : "b"; }
+        int base_priority() const override { return prio; }
+    };
+
+    std::string content;
+    for (int i = 0; i < 200; ++i) content += "line\n";
+    TempFile file(content);
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    ctrl.add_decoration_source(std::make_shared<PerLine>(10));
+    ctrl.add_decoration_source(std::make_shared<PerLine>(20));
+
+    auto check_range = [&](size_t first, size_t last) {
+        DecorationBuffer buf;
+        ctrl.decorations(first, last, buf);
+        REQUIRE(buf.filled_lines() == last - first);
+        size_t mismatches = 0;
+        for (size_t l = first; l < last; ++l) {
+            auto expected = ctrl.decorations(l).spans;
+            auto got      = buf.line(l);
+            if (got.size() != expected.size()) { ++mismatches; continue; }
+            for (size_t k = 0; k < got.size(); ++k)
+                if (got[k].byte_end != expected[k].byte_end ||
+                    got[k].priority != expected[k].priority) ++mismatches;
+        }
+        CHECK(mismatches == 0);
+        return buf;
+    };
+
+    auto small = check_range(5, 10);
+    CHECK(small.line(5)[0].priority == 11);
+    CHECK(small.line(5)[1].priority == 21);
+
+    WorkerPool pool(3);
+    ctrl.set_worker_pool(&pool);
+    check_range(0, 150);  // parallel across the two sources
+    check_range(7, 7);
+}
+
+TEST_CASE("Controller: decoration buffer keeps its capacity across frames") {
+    DecorationBuffer buf;
+    buf.reset(0, 2);
+    for (int i = 0; i < 100; ++i) buf.push({i, i + 1, TextStyle{}, 0});
+    buf.end_line();
+    buf.end_line();
+    CHECK(buf.line(0).size() == 100);
+    CHECK(buf.line(1).empty());
+    size_t bytes = buf.memory_usage();
+
+    buf.reset(10, 12);
+    CHECK(buf.filled_lines() == 0);
+    CHECK(buf.memory_usage() == bytes);
+    buf.push({0, 1, TextStyle{}, 0});
+    buf.end_line();
+    CHECK(buf.line(10).size() == 1);
+}
+
+TEST_CASE("Controller: line generations move only for bumped runs") {
+    LineGenerations gens;
+    CHECK(gens.at(0) == gens.at(1'000'000));
+    uint64_t g0 = gens.at(5);
+
+    uint64_t g1 = gens.bump({10, 20});
+    CHECK(g1 != g0);
+    CHECK(gens.at(9) == g0);
+    CHECK(gens.at(10) == g1);
+    CHECK(gens.at(19) == g1);
+    CHECK(gens.at(20) == g0);
+
+    uint64_t g2 = gens.bump({15, 30});
+    CHECK(gens.at(14) == g1);
+    CHECK(gens.at(15) == g2);
+    CHECK(gens.at(29) == g2);
+    CHECK(gens.at(30) == g0);
+    CHECK(gens.runs() == 4);
+
+    CHECK(gens.bump({}) == g2);  // empty range: nothing moves
+    CHECK(gens.runs() == 4);
+
+    // Past kMaxRuns the next bump renumbers everything at once.
+    for (size_t i = 0; i < LineGenerations::kMaxRuns; ++i) gens.bump({100 + 2 * i, 101 + 2 * i});
+    CHECK(gens.runs() <= LineGenerations::kMaxRuns);
+    uint64_t before = gens.at(0);
+    gens.bump({0, 1});
+    CHECK(gens.at(0) != before);
+}
+
+TEST_CASE("Controller: edits and published ranges bump decoration generations") {
+    // Publishes whatever range the test asks for.
+    struct Publisher : DecorationSource {
+        LineDecoration decorate(size_t) const override { return {}; }
+        std::string_view name() const override { return "pub"; }
+        void publish(LineRange r) { publish_dirty(r); }
+    };
+
+    std::string content;
+    for (int i = 0; i < 50; ++i) content += "line\n";
+    TempFile file(content);
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    auto pub = std::make_shared<Publisher>();
+    ctrl.add_decoration_source(pub);
+
+    auto snapshot = [&] {
+        std::vector<uint64_t> g;
+        for (size_t l = 0; l < ctrl.line_count(); ++l) g.push_back(ctrl.decoration_generation(l));
+        return g;
+    };
+    auto changed = [](const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+        std::vector<size_t> lines;
+        for (size_t l = 0; l < std::min(a.size(), b.size()); ++l)
+            if (a[l] != b[l]) lines.push_back(l);
+        return lines;
+    };
+
+    auto g0 = snapshot();
+    CHECK(ctrl.poll_decoration_changes().empty());
+    CHECK(changed(g0, snapshot()).empty());
+
+    // Same line count: only the edited line moves.
+    ctrl.insert(7, 0, "x");
+    auto g1 = snapshot();
+    CHECK(changed(g0, g1) == std::vector<size_t>{7});
+
+    // A new line shifts everything after the edit.
+    ctrl.insert(20, 0, "\n");
+    auto g2 = snapshot();
+    auto moved = changed(g1, g2);
+    REQUIRE(!moved.empty());
+    CHECK(moved.front() == 20);
+    CHECK(moved.back() == g1.size() - 1);
+
+    // Published ranges are drained once.
+    pub->publish({3, 5});
+    pub->publish({30, 31});
+    LineRange r = ctrl.poll_decoration_changes();
+    CHECK(r.first == 3);
+    CHECK(r.last == 31);
+    auto g3 = snapshot();
+    CHECK(g3[3] != g2[3]);
+    CHECK(g3[30] != g2[30]);
+    CHECK(g3[2] == g2[2]);
+    CHECK(ctrl.poll_decoration_changes().empty());
+    CHECK(changed(g3, snapshot()).empty());
+}
+
+TEST_CASE("Controller: line versions follow lines across edits") {
+    std::string content;
+    for (int i = 0; i < 20; ++i) content += "line " + std::to_string(i) + "\n";
+    TempFile file(content);
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    std::set<uint64_t> seen;
+    auto snapshot = [&] {
+        std::vector<uint64_t> v;
+        for (size_t l = 0; l < ctrl.line_count(); ++l) v.push_back(ctrl.line_version(l));
+        seen.insert(v.begin(), v.end());
+        return v;
+    };
+    auto v0 = snapshot();
+    CHECK(seen.size() == v0.size());
+
+    // Typing restamps only the edited line.
+    ctrl.insert(5, 0, "x");
+    auto v1 = snapshot();
+    REQUIRE(v1.size() == v0.size());
+    for (size_t l = 0; l < v0.size(); ++l) CHECK((v1[l] != v0[l]) == (l == 5));
+    CHECK(seen.size() == v0.size() + 1);
+
+    // Splitting line 8 moves every later line along with its stamp.
+    ctrl.insert(8, 2, "\n");
+    auto v2 = snapshot();
+    REQUIRE(v2.size() == v1.size() + 1);
+    for (size_t l = 0; l < 8; ++l) CHECK(v2[l] == v1[l]);
+    CHECK(v2[8] != v1[8]);
+    CHECK(v2[9] != v1[8]);
+    CHECK(v2[8] != v2[9]);
+    for (size_t l = 9; l < v1.size(); ++l) CHECK(v2[l + 1] == v1[l]);
+
+    // Joining lines 2 and 3 moves the rest back.
+    ctrl.erase(2, ctrl.line(2).size(), 1);
+    auto v3 = snapshot();
+    REQUIRE(v3.size() == v2.size() - 1);
+    CHECK(v3[1] == v2[1]);
+    CHECK(v3[2] != v2[2]);
+    CHECK(v3[2] != v2[3]);
+    for (size_t l = 3; l < v3.size(); ++l) CHECK(v3[l] == v2[l + 1]);
+
+    // Stamps are never reused, also not by a reopened file.
+    size_t before = seen.size();
+    ctrl.open_file(file.path());
+    auto v4 = snapshot();
+    CHECK(seen.size() == before + v4.size());
+}
+
+TEST_CASE("Controller: line versions restamp everything past kMaxRuns") {
+    LineVersions versions(100'000);
+    uint64_t first = versions.at(0);
+    EditRecord e;
+    for (size_t i = 0; i < LineVersions::kMaxRuns; ++i) {
+        e.line = 10 + 3 * i;
+        versions.apply(e);
+    }
+    CHECK(versions.runs() <= LineVersions::kMaxRuns);
+    CHECK(versions.at(0) != first);
+}
+
+namespace {
+
+// Marks the whole line; compute() can be held until the test releases it.
+class SlowProducer : public AsyncDecorationSource::Producer {
+public:
+    std::string_view name() const override { return "slow"; }
+
+    void hold() { std::lock_guard l(m_); held_ = true; }
+    void release() { { std::lock_guard l(m_); held_ = false; } cv_.notify_all(); }
+    // Blocks until compute() has been entered `n` times in total.
+    void wait_started(int n) {
+        std::unique_lock l(m_);
+        cv_.wait(l, [&] { return started_ >= n; });
+    }
+
+    LineDecoration compute(size_t, std::string_view text) const override {
+        std::unique_lock l(m_);
+        ++started_;
+        cv_.notify_all();
+        cv_.wait(l, [&] { return !held_; });
+        LineDecoration d;
+        d.spans.push_back({0, static_cast<int>(text.size()), TextStyle{}, 0});
+        return d;
+    }
+
+private:
+    mutable std::mutex              m_;
+    mutable std::condition_variable cv_;
+    mutable int                     started_{0};
+    bool                            held_{false};
+};
+
+void wait_until_idle(Controller& ctrl) {
+    while (ctrl.on_idle(std::chrono::microseconds(1000))) std::this_thread::yield();
+}
+
+} // namespace
+
+TEST_CASE("Controller: async source returns cached results and publishes arrivals") {
+    TempFile file("alpha\nbeta\ngamma\n");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    WorkerPool pool(2);
+    auto producer = std::make_unique<SlowProducer>();
+    SlowProducer* src = producer.get();
+    ctrl.add_decoration_source(std::make_shared<AsyncDecorationSource>(ctrl, pool, std::move(producer)));
+    ctrl.poll_decoration_changes();
+
+    // Nothing cached yet: an immediate empty answer, then the result lands.
+    src->hold();
+    CHECK(ctrl.decorations(1).spans.empty());
+    CHECK(ctrl.decorations(1).spans.empty());  // already queued
+    src->wait_started(1);
+    CHECK(ctrl.on_idle(std::chrono::microseconds(100)));
+    src->release();
+    wait_until_idle(ctrl);
+
+    LineRange r = ctrl.poll_decoration_changes();
+    CHECK(r.first == 1);
+    CHECK(r.last == 2);
+    auto d = ctrl.decorations(1);
+    REQUIRE(d.spans.size() == 1);
+    CHECK(d.spans[0].byte_end == 4);
+
+    // Inserting a line above moves the cached result with its text.
+    ctrl.insert(0, 0, "zero\n");
+    d = ctrl.decorations(2);
+    REQUIRE(d.spans.size() == 1);
+    CHECK(d.spans[0].byte_end == 4);
+}
+
+TEST_CASE("Controller: async results survive edits to other lines") {
+    TempFile file("alpha\nbeta\ngamma\n");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    WorkerPool pool(2);
+    auto producer = std::make_unique<SlowProducer>();
+    SlowProducer* src = producer.get();
+    ctrl.add_decoration_source(std::make_shared<AsyncDecorationSource>(ctrl, pool, std::move(producer)));
+    ctrl.poll_decoration_changes();
+
+    src->hold();
+    ctrl.decorations(2);
+    src->wait_started(1);
+    ctrl.insert(0, 0, "zero\n");  // moves the in-flight line to 3
+    src->release();
+    wait_until_idle(ctrl);
+
+    CHECK(ctrl.poll_decoration_changes().contains(3));
+    auto d = ctrl.decorations(3);
+    REQUIRE(d.spans.size() == 1);
+    CHECK(d.spans[0].byte_end == 5);
+}
+
+TEST_CASE("Controller: async results computed before an edit are dropped") {
+    TempFile file("alpha\nbeta\ngamma\n");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    WorkerPool pool(2);
+    auto producer = std::make_unique<SlowProducer>();
+    SlowProducer* src = producer.get();
+    ctrl.add_decoration_source(std::make_shared<AsyncDecorationSource>(ctrl, pool, std::move(producer)));
+    ctrl.poll_decoration_changes();
+
+    src->hold();
+    ctrl.decorations(2);
+    src->wait_started(1);
+    ctrl.insert(2, 0, "x");  // same line count, the in-flight line changed
+    src->release();
+    wait_until_idle(ctrl);
+
+    // The stale result is not cached; the frontend recomposites the edited
+    // line and its request gets a fresh computation.
+    CHECK(ctrl.decorations(2).spans.empty());
+    wait_until_idle(ctrl);
+    auto d = ctrl.decorations(2);
+    REQUIRE(d.spans.size() == 1);
+    CHECK(d.spans[0].byte_end == 6);
+}
+
+TEST_CASE("Controller: latency histogram percentiles over a rolling window") {
+    LatencyHistogram h;
+    CHECK(h.percentile(50).count() == 0);
+    for (int i = 0; i < 90; ++i) h.record(std::chrono::microseconds(10));
+    for (int i = 0; i < 10; ++i) h.record(std::chrono::microseconds(1000));
+    CHECK(h.samples() == 100);
+    CHECK(h.percentile(50).count() == 16);    // bucket [8, 16)
+    CHECK(h.percentile(99).count() == 1024);  // bucket [512, 1024)
+    CHECK(h.max().count() == 1000);
+
+    // Old samples leave the window.
+    for (size_t i = 0; i < LatencyHistogram::kWindow; ++i) h.record(std::chrono::microseconds(0));
+    CHECK(h.samples() == LatencyHistogram::kWindow);
+    CHECK(h.percentile(99).count() == 1);
+    CHECK(h.max().count() == 0);
+}
+
+TEST_CASE("Controller: a source over budget is skipped and served its last spans") {
+    struct Slow : DecorationSource {
+        mutable int calls{0};
+        LineDecoration decorate(size_t line) const override {
+            ++calls;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            LineDecoration d;
+            d.spans.push_back({0, static_cast<int>(line) + 1, TextStyle{}, 0});
+            return d;
+        }
+        std::string_view name() const override { return "slow"; }
+    };
+
+    std::string content;
+    for (int i = 0; i < 10; ++i) content += "line\n";
+    TempFile file(content);
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    auto slow = std::make_shared<Slow>();
+    ctrl.add_decoration_source(slow);
+    ctrl.set_decoration_budget(std::chrono::microseconds(500));
+    ctrl.poll_decoration_changes();
+
+    DecorationBuffer buf;
+    ctrl.decorations(0, 2, buf);
+    CHECK(slow->calls == 2);
+    REQUIRE(buf.line(1).size() == 1);
+
+    // Next frame: skipped, the previous spans stand in where they cover.
+    ctrl.decorations(1, 3, buf);
+    CHECK(slow->calls == 2);
+    REQUIRE(buf.line(1).size() == 1);
+    CHECK(buf.line(1)[0].byte_end == 2);
+    CHECK(buf.line(2).empty());
+
+    const auto& st = ctrl.decoration_stats();
+    REQUIRE(st.size() == 1);
+    CHECK(st[0].name == "slow");
+    CHECK(st[0].calls == 1);
+    CHECK(st[0].skipped == 1);
+    CHECK(st[0].last.count() >= 500);
+
+    // The backoff keeps an idle loop polling until it has run out.
+    CHECK(ctrl.on_idle(std::chrono::milliseconds(1)));
+
+    // Once the backoff ends, the lines served stale are bumped so the
+    // frontend asks again.
+    uint64_t gen = ctrl.decoration_generation(2);
+    LineRange r = ctrl.poll_decoration_changes();
+    CHECK(r.contains(1));
+    CHECK(r.contains(2));
+    CHECK(ctrl.decoration_generation(2) != gen);
+    ctrl.decorations(1, 3, buf);
+    CHECK(slow->calls == 4);
+    CHECK(buf.line(2).size() == 1);
+}
+
+TEST_CASE("Controller: edits publish records with offsets, lines and erased text") {
+    // Keeps every record it is handed.
+    struct Recorder : DecorationSource {
+        std::vector<EditRecord> edits;
+        LineDecoration decorate(size_t) const override { return {}; }
+        std::string_view name() const override { return "rec"; }
+        void on_edit(const EditRecord& e) override { edits.push_back(e); }
+    };
+
+    TempFile file("alpha\nbeta\ngamma\n");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    auto rec = std::make_shared<Recorder>();
+    ctrl.add_decoration_source(rec);
+    uint64_t opened = ctrl.document_version();
+
+    ctrl.insert(1, 2, "XY\nZ");
+    REQUIRE(rec->edits.size() == 1);
+    EditRecord ins = rec->edits[0];
+    CHECK(ins.version == ctrl.document_version());
+    CHECK(ins.offset == 8);
+    CHECK(ins.old_length == 0);
+    CHECK(ins.new_length == 4);
+    CHECK(ins.line == 1);
+    CHECK(ins.col == 2);
+    CHECK(ins.old_end_line == 1);
+    CHECK(ins.old_end_col == 2);
+    CHECK(ins.new_end_line == 2);
+    CHECK(ins.new_end_col == 1);
+    CHECK(ins.lines_added == 1);
+    CHECK(ins.lines_removed == 0);
+    CHECK(ctrl.line(1) == "beXY");
+    CHECK(ctrl.line(2) == "Zta");
+
+    // Erase "XY\nZt": across a line break.
+    ctrl.erase(1, 2, 5);
+    REQUIRE(rec->edits.size() == 2);
+    EditRecord era = rec->edits[1];
+    CHECK(era.offset == 8);
+    CHECK(era.old_length == 5);
+    CHECK(era.new_length == 0);
+    CHECK(era.old_end_line == 2);
+    CHECK(era.old_end_col == 2);
+    CHECK(era.new_end_line == 1);
+    CHECK(era.new_end_col == 2);
+    CHECK(era.lines_removed == 1);
+    CHECK(era.line_delta() == -1);
+    // Line 1 was edited and line 2 erased; line 3 moved up.
+    CHECK(era.map_line(0) == 0);
+    CHECK_FALSE(era.map_line(1).has_value());
+    CHECK_FALSE(era.map_line(2).has_value());
+    CHECK(era.map_line(3) == 2);
+    CHECK(ins.map_line(2) == 3);
+    CHECK(era.erased_text == "XY\nZt");
+    CHECK(ctrl.line(1) == "bea");
+    CHECK(era.batch != ins.batch);
+
+    // Out-of-range erases throw before anything is published.
+    CHECK_THROWS_AS(ctrl.erase(3, 0, 10), std::out_of_range);
+    CHECK(rec->edits.size() == 2);
+
+    // Edits in one batch share its id.
+    ctrl.begin_batch();
+    ctrl.erase(0, 0, 1);
+    ctrl.insert(0, 0, "A");
+    ctrl.end_batch();
+    REQUIRE(rec->edits.size() == 4);
+    CHECK(rec->edits[2].batch == rec->edits[3].batch);
+    CHECK(rec->edits[2].batch != era.batch);
+
+    // The journal replays everything since a version.
+    std::vector<EditRecord> replay;
+    CHECK(ctrl.edit_journal().since(opened, replay));
+    CHECK(replay.size() == 4);
+    replay.clear();
+    CHECK(ctrl.edit_journal().since(era.version, replay));
+    REQUIRE(replay.size() == 2);
+    CHECK(replay[0].erased_text == "a");
+    CHECK(replay[1].new_length == 1);
+}
+
+TEST_CASE("Controller: edit journal drops its oldest records") {
+    EditJournal journal(3);
+    for (uint64_t v = 1; v <= 5; ++v) {
+        EditRecord r;
+        r.version = v;
+        journal.push(r);
+    }
+    CHECK(journal.size() == 3);
+    std::vector<EditRecord> out;
+    CHECK(!journal.since(1, out));  // version 2 was dropped
+    CHECK(journal.since(2, out));
+    REQUIRE(out.size() == 3);
+    CHECK(out.front().version == 3);
+    out.clear();
+    CHECK(journal.since(5, out));
+    CHECK(out.empty());
+
+    journal.reset(9);
+    CHECK(!journal.since(5, out));
+    CHECK(journal.since(9, out));
+    CHECK(out.empty());
+}
+
+namespace {
+
+std::vector<size_t> brute_force_matches(const Controller& ctrl, std::string_view pattern) {
+    std::vector<size_t> out;
+    for (size_t l = 0; l < ctrl.line_count(); ++l)
+        if (ctrl.line(l).find(pattern) != std::string::npos) out.push_back(l);
+    return out;
+}
+
+std::vector<size_t> filter_lines(const LineFilter& f) {
+    std::vector<size_t> out;
+    for (size_t v = 0; v < f.size(); ++v) out.push_back(f.doc_line(v));
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("Controller: line filter maps view lines to matching document lines") {
+    std::string content;
+    for (int i = 0; i < 40000; ++i) content += (i % 7 == 0 ? "ERROR disk\n" : "INFO ok\n");
+    TempFile file(content);
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    LineFilter seq(ctrl, "ERROR");
+    WorkerPool pool(3);
+    LineFilter par(ctrl, "ERROR", &pool);  // several chunks
+    CHECK(filter_lines(seq) == brute_force_matches(ctrl, "ERROR"));
+    CHECK(filter_lines(par) == filter_lines(seq));
+
+    CHECK(seq.size() == 40000 / 7 + 1);
+    CHECK(seq.doc_line(3) == 21);
+    CHECK(seq.view_line(21) == 3);
+    CHECK(seq.view_line(22) == 4);  // next match after a hidden line
+    CHECK(seq.view_line(1'000'000) == seq.size() - 1);
+    CHECK(seq.contains(14));
+    CHECK(!seq.contains(15));
+}
+
+TEST_CASE("Controller: line filter follows edits and appends incrementally") {
+    std::string content;
+    for (int i = 0; i < 100; ++i) content += (i % 10 == 0 ? "hit\n" : "miss\n");
+    TempFile file(content);
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    LineFilter f(ctrl, "hit");
+    CHECK(!f.sync());
+
+    // Several edits replayed in one sync: a new match, a removed line that
+    // shifts later matches, a split line, and lines appended at the end.
+    ctrl.insert(5, 0, "hit ");
+    ctrl.erase(20, 0, 4);               // "hit\n" of line 20
+    ctrl.insert(30, 1, "\nhit\n");
+    size_t end = ctrl.line_count() - 1;
+    ctrl.insert(end, 0, "tail hit\nmore\nhit again\n");
+    CHECK(f.sync());
+    CHECK(filter_lines(f) == brute_force_matches(ctrl, "hit"));
+
+    // Edits on a match's own line drop or keep it.
+    ctrl.erase(0, 0, 1);                // "it"
+    CHECK(f.sync());
+    CHECK(!f.contains(0));
+    CHECK(filter_lines(f) == brute_force_matches(ctrl, "hit"));
+
+    // Falling behind the journal rebuilds from scratch.
+    for (size_t i = 0; i < EditJournal::kDefaultCapacity + 1; ++i) ctrl.insert(1, 0, "h");
+    ctrl.insert(2, 0, "hit");
+    CHECK(f.sync());
+    CHECK(filter_lines(f) == brute_force_matches(ctrl, "hit"));
+}
@@ -200,3 +200,25 @@ TEST_CASE("flatten: custom default_style applied to gaps") {
     CHECK(result[2].style.fg.r == 128);
     CHECK(result[2].style.bg.r == 10);
 }
+
+TEST_CASE("flatten: span overload reuses the output vector") {
+    std::vector<StyledSpan> spans;
+    TextStyle style;
+    style.fg = {255, 0, 0, 255};
+    spans.push_back({2, 5, style, 1});
+
+    std::vector<StyledSpan> out(7);  // stale contents are replaced
+    DecorationCompositor::flatten(spans, 8, out);
+    REQUIRE(out.size() == 3);
+    CHECK(out[1].byte_start == 2);
+    CHECK(out[1].byte_end == 5);
+    CHECK(out[1].style.fg.r == 255);
+
+    auto same = DecorationCompositor::flatten(LineDecoration{spans}, 8);
+    REQUIRE(same.size() == out.size());
+    for (size_t i = 0; i < out.size(); ++i)
+        CHECK(same[i].byte_end == out[i].byte_end);
+
+    DecorationCompositor::flatten(spans, 0, out);
+    CHECK(out.empty());
+}
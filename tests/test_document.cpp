@@ -195,3 +195,42 @@ TEST_CASE("Document: open second file replaces first") {
     CHECK(doc.line(1) == "file");
     CHECK(doc.line_count() == 2);
 }
+
+TEST_CASE("Document: memory report covers index, pieces and mapping") {
+    TempFile file("alpha\nbeta\ngamma\n");
+    Document doc;
+    doc.open_file(file.path());
+    doc.insert(0, 0, "xyz");
+
+    MemoryReport report;
+    doc.memory_report(report);
+
+    auto bytes_of = [&](std::string_view name) -> size_t {
+        for (const auto& e : report.entries)
+            if (e.name == name) return e.bytes;
+        return 0;
+    };
+    CHECK(bytes_of("backend.line_index") >= 4 * sizeof(size_t));
+    CHECK(bytes_of("backend.piece_table.add_buffer") >= 3);
+    CHECK(bytes_of("backend.piece_table.pieces") > 0);
+    CHECK(report.mapped_bytes == 17);
+    CHECK(report.mapped_resident_bytes <= report.mapped_bytes);
+}
+
+TEST_CASE("Document: byte offsets, ranges and version") {
+    TempFile file("alpha\nbeta\ngamma\n");
+    Document doc;
+    uint64_t v0 = doc.version();
+    doc.open_file(file.path());
+    CHECK(doc.version() > v0);
+
+    CHECK(doc.offset_of(1, 2) == 8);
+    CHECK(doc.position_of(8) == std::pair<size_t, size_t>{1, 2});
+    CHECK(doc.text(4, 4) == "a\nbe");
+
+    uint64_t v1 = doc.version();
+    doc.insert(0, 0, "x");
+    CHECK(doc.version() == v1 + 1);
+    doc.erase(0, 0, 1);
+    CHECK(doc.version() == v1 + 2);
+}
@@ -0,0 +1,77 @@
+#include <doctest/doctest.h>
+#include <sprawn/frontend/line_cache.h>
+
+#include <cstdint>
+
+using namespace sprawn;
+
+namespace {
+
+GlyphRun run_of(uint64_t version) {
+    GlyphRun run;
+    run.total_width = static_cast<int>(version);
+    run.glyphs.resize(version % 5);
+    return run;
+}
+
+} // namespace
+
+TEST_CASE("LineCache: get returns what was put under the same version") {
+    LineCache cache(8);
+    CHECK(cache.get(1) == nullptr);
+    cache.put(1, run_of(1));
+    cache.put(2, run_of(2));
+    REQUIRE(cache.get(1));
+    CHECK(cache.get(1)->total_width == 1);
+    REQUIRE(cache.get(2));
+    CHECK(cache.get(2)->glyphs.size() == 2);
+    CHECK(cache.get(3) == nullptr);
+
+    cache.put(1, run_of(11));
+    CHECK(cache.size() == 2);
+    CHECK(cache.get(1)->total_width == 11);
+
+    cache.clear();
+    CHECK(cache.size() == 0);
+    CHECK(cache.get(1) == nullptr);
+}
+
+TEST_CASE("LineCache: eviction skips recently used entries") {
+    LineCache cache(4);
+    for (uint64_t v = 1; v <= 4; ++v) cache.put(v, run_of(v));
+    // Every reference bit is set: one sweep clears them, then one goes.
+    cache.put(5, run_of(5));
+    CHECK(cache.size() == 4);
+
+    // Hit one survivor; the next eviction takes one of the others.
+    uint64_t kept = 0;
+    for (uint64_t v = 1; v <= 4 && !kept; ++v)
+        if (cache.get(v)) kept = v;
+    REQUIRE(kept != 0);
+    cache.put(6, run_of(6));
+    CHECK(cache.size() == 4);
+    CHECK(cache.get(kept) != nullptr);
+    CHECK(cache.get(5) != nullptr);
+    CHECK(cache.get(6) != nullptr);
+}
+
+TEST_CASE("LineCache: entries stay reachable through evictions") {
+    LineCache cache(64);
+    for (uint64_t v = 1; v <= 10'000; ++v) {
+        cache.put(v, run_of(v));
+        if (v % 3 == 0) cache.get(v / 2);
+        REQUIRE(cache.size() <= cache.capacity());
+        const GlyphRun* last = cache.get(v);
+        REQUIRE(last);
+        CHECK(last->total_width == static_cast<int>(v));
+    }
+    CHECK(cache.size() == 64);
+    size_t found = 0;
+    for (uint64_t v = 1; v <= 10'000; ++v) {
+        if (const GlyphRun* r = cache.get(v)) {
+            CHECK(r->total_width == static_cast<int>(v));
+            ++found;
+        }
+    }
+    CHECK(found == 64);
+}
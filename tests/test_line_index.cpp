@@ -79,6 +79,26 @@ TEST_CASE("LineIndex: to_offset") {
     CHECK(idx.to_offset(2, 0) == 8);
 }
 
+TEST_CASE("LineIndex: to_position") {
+    auto pt = make_table("abc\ndef\nghi");
+    LineIndex idx;
+    idx.rebuild(pt);
+
+    auto p = idx.to_position(0);
+    CHECK(p.line == 0);
+    CHECK(p.col == 0);
+    p = idx.to_position(3);  // the '\n' ends line 0
+    CHECK(p.line == 0);
+    CHECK(p.col == 3);
+    p = idx.to_position(5);
+    CHECK(p.line == 1);
+    CHECK(p.col == 1);
+    p = idx.to_position(11);  // end of text
+    CHECK(p.line == 2);
+    CHECK(p.col == 3);
+    CHECK_THROWS_AS(idx.to_position(12), std::out_of_range);
+}
+
 TEST_CASE("LineIndex: out of range throws") {
     auto pt = make_table("abc");
     LineIndex idx;
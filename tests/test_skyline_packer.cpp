@@ -0,0 +1,89 @@
+#include <doctest/doctest.h>
+#include <sprawn/frontend/skyline_packer.h>
+
+#include <vector>
+
+using namespace sprawn;
+
+namespace {
+
+struct Placed { int x, y, w, h; };
+
+bool overlap(const Placed& a, const Placed& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+} // namespace
+
+TEST_CASE("SkylinePacker: placed rectangles stay inside and never overlap") {
+    SkylinePacker packer(128, 128);
+    std::vector<Placed> placed;
+    size_t area = 0;
+    // Mixed glyph-like sizes until nothing fits any more.
+    for (int i = 0; i < 1000; ++i) {
+        int w = 3 + (i * 7) % 17;
+        int h = 4 + (i * 11) % 23;
+        int x = 0, y = 0;
+        if (!packer.insert(w, h, x, y)) continue;
+        placed.push_back({x, y, w, h});
+        area += static_cast<size_t>(w) * h;
+    }
+    REQUIRE(placed.size() > 20);
+    for (size_t i = 0; i < placed.size(); ++i) {
+        const Placed& p = placed[i];
+        CHECK(p.x >= 0);
+        CHECK(p.y >= 0);
+        CHECK(p.x + p.w <= 128);
+        CHECK(p.y + p.h <= 128);
+        for (size_t j = i + 1; j < placed.size(); ++j)
+            CHECK_FALSE(overlap(p, placed[j]));
+    }
+    CHECK(packer.occupancy() == area / (128.0 * 128.0));
+}
+
+TEST_CASE("SkylinePacker: covered segments are trimmed and equal heights merged") {
+    SkylinePacker packer(100, 100);
+    int x = 0, y = 0;
+    REQUIRE(packer.insert(30, 10, x, y));
+    CHECK(packer.segments() == 2);
+    REQUIRE(packer.insert(70, 10, x, y));
+    CHECK(x == 30);
+    CHECK(y == 0);
+    CHECK(packer.segments() == 1);  // both at height 10
+
+    REQUIRE(packer.insert(50, 20, x, y));
+    CHECK(x == 0);
+    CHECK(y == 10);
+    CHECK(packer.segments() == 2);  // [0, 50) at 30, [50, 100) at 10
+
+    // Too wide for the low segment alone: sits on the high one and covers
+    // the first 30 pixels of the low one.
+    REQUIRE(packer.insert(80, 5, x, y));
+    CHECK(x == 0);
+    CHECK(y == 30);
+    CHECK(packer.segments() == 2);  // [0, 80) at 35, [80, 100) at 10
+
+    // Fills the rest up to the same height.
+    REQUIRE(packer.insert(20, 25, x, y));
+    CHECK(x == 80);
+    CHECK(y == 10);
+    CHECK(packer.segments() == 1);
+}
+
+TEST_CASE("SkylinePacker: rejects what does not fit and starts over after reset") {
+    SkylinePacker packer(10, 10);
+    int x = 0, y = 0;
+    CHECK_FALSE(packer.insert(11, 1, x, y));
+    CHECK_FALSE(packer.insert(1, 11, x, y));
+    REQUIRE(packer.insert(10, 10, x, y));
+    CHECK(packer.occupancy() == 1.0);
+    CHECK_FALSE(packer.insert(1, 1, x, y));
+
+    packer.reset();
+    CHECK(packer.occupancy() == 0.0);
+    CHECK(packer.segments() == 1);
+    x = y = -1;
+    REQUIRE(packer.insert(10, 10, x, y));
+    CHECK(x == 0);
+    CHECK(y == 0);
+}
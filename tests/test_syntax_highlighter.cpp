@@ -3,9 +3,12 @@
 #include <sprawn/document.h>
 #include <sprawn/middleware/controller.h>
 #include <sprawn/middleware/syntax_highlighter.h>
+#include <sprawn/worker_pool.h>
 
+#include <chrono>
 #include <cstdio>
 #include <filesystem>
+#include <stdexcept>
 #include <string>
 #include <unistd.h>
 
@@ -36,14 +39,14 @@ private:
     std::filesystem::path path_;
 };
 
-// Helper: create a highlighter with C++ language on inline content
+// Helper: create a highlighter with a language (C++ by default) on inline content
 struct TestFixture {
     Document    doc;
     Controller  ctrl{doc};
     SyntaxHighlighter hl{ctrl};
 
-    TestFixture() {
-        hl.set_language(LanguageDef::cpp());
+    explicit TestFixture(const LanguageDef& lang = LanguageDef::cpp()) {
+        hl.set_language(lang);
     }
 };
 
@@ -280,6 +283,31 @@ TEST_CASE("Integration: controller.decorations() returns styled spans") {
     CHECK(found_number);
 }
 
+TEST_CASE("Integration: range decorations match per-line decorate()") {
+    TempFile file("int a; /* open\nstill\nclosed */ return 1;\n\"s\" x;\n", ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    SyntaxHighlighter hl(ctrl);
+    hl.set_language(LanguageDef::cpp());
+
+    DecorationBuffer buf;
+    buf.reset(0, ctrl.line_count());
+    hl.decorate_range(0, ctrl.line_count(), buf);
+    REQUIRE(buf.filled_lines() == ctrl.line_count());
+    for (size_t l = 0; l < ctrl.line_count(); ++l) {
+        auto expected = hl.decorate(l).spans;
+        auto got      = buf.line(l);
+        REQUIRE(got.size() == expected.size());
+        for (size_t k = 0; k < got.size(); ++k) {
+            CHECK(got[k].byte_start == expected[k].byte_start);
+            CHECK(got[k].byte_end == expected[k].byte_end);
+            CHECK(got[k].style.fg.r == expected[k].style.fg.r);
+        }
+    }
+}
+
 // ===================================================================
 // Language detection
 // ===================================================================
@@ -366,3 +394,514 @@ TEST_CASE("Edge: multiple block comments on one line") {
     CHECK(comment_count == 2);
     CHECK(exit == LineState::Normal);
 }
+
+TEST_CASE("Edge: trailing backslash in string stays within the line") {
+    TestFixture f;
+    auto [tokens, exit] = scan(f.hl, R"(s = "abc\)");
+    CHECK(has_token(tokens, TokenType::StringLiteral, 4, 9));
+}
+
+TEST_CASE("Edge: runs crossing 16-byte blocks") {
+    TestFixture f;
+    for (int n : {1, 14, 15, 16, 17, 31, 32, 33}) {
+        CAPTURE(n);
+        std::string id(static_cast<size_t>(n), 'x');
+        std::string pad(static_cast<size_t>(n), ' ');
+        auto [tokens, exit] = scan(f.hl, id + "9_" + pad + "return /*" + id + "*/");
+        int kw = n + 2 + n;
+        CHECK(tokens.size() == 2);
+        CHECK(has_token(tokens, TokenType::Keyword, kw, kw + 6));
+        CHECK(has_token(tokens, TokenType::Comment, kw + 7, kw + 7 + 2 + n + 2));
+    }
+}
+
+TEST_CASE("Scanner: reusing the token vector matches the allocating scan") {
+    TestFixture f;
+    std::vector<Token> tokens;
+    for (std::string_view line : {"int x = 0; // c", "/* open", "\"s\" 'c' 0x1F", ""}) {
+        ScanResult expected = scan(f.hl, line);
+        LineState exit = f.hl.scan_line(line, LineState::Normal, tokens);
+        CHECK(exit == expected.exit_state);
+        REQUIRE(tokens.size() == expected.tokens.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            CHECK(tokens[i].byte_start == expected.tokens[i].byte_start);
+            CHECK(tokens[i].byte_end == expected.tokens[i].byte_end);
+            CHECK(tokens[i].type == expected.tokens[i].type);
+        }
+    }
+}
+
+// ===================================================================
+// Keyword tables
+// ===================================================================
+
+TEST_CASE("Keyword table: compile-time C++ table classifies every word") {
+    LanguageDef cpp = LanguageDef::cpp();
+    for (const auto& k : cpp.keywords)
+        CHECK(cpp.keyword_table.lookup(k) == WordClass::Keyword);
+    for (const auto& t : cpp.types)
+        CHECK(cpp.keyword_table.lookup(t) == WordClass::Type);
+    for (std::string_view miss : {"", "retur", "returns", "Return", "int9", "x", "char64_t"})
+        CHECK(cpp.keyword_table.lookup(miss) == WordClass::None);
+    CHECK(cpp.keyword_table.memory_usage() == 0);
+}
+
+TEST_CASE("Keyword table: built at load time for custom languages") {
+    KeywordTable table({"fn", "let", "fn"}, {"u8", "let"});
+    CHECK(table.size() == 3);
+    CHECK(table.lookup("fn") == WordClass::Keyword);
+    CHECK(table.lookup("let") == WordClass::Keyword);
+    CHECK(table.lookup("u8") == WordClass::Type);
+    CHECK(table.lookup("u16") == WordClass::None);
+    CHECK(table.memory_usage() > 0);
+
+    KeywordTable copy = table;
+    table = KeywordTable();
+    CHECK(table.lookup("fn") == WordClass::None);
+    CHECK(copy.lookup("fn") == WordClass::Keyword);
+
+    Document doc;
+    Controller ctrl{doc};
+    SyntaxHighlighter hl{ctrl};
+    LanguageDef lang;
+    lang.keywords = {"fn"};
+    lang.types    = {"u8"};
+    hl.set_language(lang);
+    auto [tokens, exit] = scan(hl, "fn f(x: u8) -> int");
+    CHECK(tokens.size() == 2);
+    CHECK(has_token(tokens, TokenType::Keyword, 0, 2));
+    CHECK(has_token(tokens, TokenType::Type, 8, 10));
+}
+
+// ===================================================================
+// Table-driven languages
+// ===================================================================
+
+TEST_CASE("Languages: Python triple-quoted string spans lines") {
+    TestFixture f(LanguageDef::python());
+    auto [t0, s0] = scan(f.hl, "x = \"\"\"doc");
+    CHECK(has_token(t0, TokenType::StringLiteral, 4, 10));
+    CHECK(s0 != LineState::Normal);
+
+    auto [t1, s1] = scan(f.hl, "still\"\"\"  # c", s0);
+    CHECK(has_token(t1, TokenType::StringLiteral, 0, 8));
+    CHECK(has_token(t1, TokenType::Comment, 10, 13));
+    CHECK(s1 == LineState::Normal);
+}
+
+TEST_CASE("Languages: C++ raw string closes only on its tag") {
+    TestFixture f;
+    auto [t0, s0] = scan(f.hl, "auto s = R\"x(a)\" b");
+    CHECK(has_token(t0, TokenType::StringLiteral, 9, 18));
+    CHECK(s0 != LineState::Normal);
+
+    auto [t1, s1] = scan(f.hl, ")x\"; int y;", s0);
+    CHECK(has_token(t1, TokenType::StringLiteral, 0, 3));
+    CHECK(has_token(t1, TokenType::Type, 5, 8));
+    CHECK(s1 == LineState::Normal);
+
+    // An identifier starting with R is not a raw string
+    auto [t2, s2] = scan(f.hl, "Rx = \"a\";");
+    CHECK(has_token(t2, TokenType::StringLiteral, 5, 8));
+}
+
+TEST_CASE("Languages: Rust nested comments, raw strings and lifetimes") {
+    TestFixture f(LanguageDef::rust());
+    auto [t0, s0] = scan(f.hl, "/* a /* b */ c */ x");
+    CHECK(has_token(t0, TokenType::Comment, 0, 17));
+    CHECK(s0 == LineState::Normal);
+
+    auto [t1, s1] = scan(f.hl, "/* a /* b */");
+    CHECK(s1 != LineState::Normal);
+    auto [t2, s2] = scan(f.hl, "c */ let", s1);
+    CHECK(has_token(t2, TokenType::Comment, 0, 4));
+    CHECK(has_token(t2, TokenType::Keyword, 5, 8));
+
+    auto [t3, s3] = scan(f.hl, "let s = r#\"a\"b\"#;");
+    CHECK(has_token(t3, TokenType::StringLiteral, 8, 16));
+
+    auto [t4, s4] = scan(f.hl, "fn f<'a>(x: &'a str) -> char { 'z' }");
+    CHECK(has_token(t4, TokenType::CharLiteral, 31, 34));
+    for (const auto& t : t4)
+        CHECK((t.type != TokenType::CharLiteral || t.byte_start == 31));
+
+    // An escaped quote does not close the literal early.
+    auto [t5, s5] = scan(f.hl, "let q = '\\''; let b = '\\\\';");
+    CHECK(has_token(t5, TokenType::CharLiteral, 8, 12));
+    CHECK(has_token(t5, TokenType::CharLiteral, 22, 26));
+    CHECK(s5 == LineState::Normal);
+
+    // One code point, whatever its length in bytes.
+    auto [t6, s6] = scan(f.hl, "['\xC3\xA9', '\xE4\xB8\xAD', '\xF0\x9F\x98\x80', 'ab']");
+    CHECK(has_token(t6, TokenType::CharLiteral, 1, 5));
+    CHECK(has_token(t6, TokenType::CharLiteral, 7, 12));
+    CHECK(has_token(t6, TokenType::CharLiteral, 14, 20));
+    for (const auto& t : t6)
+        CHECK((t.type != TokenType::CharLiteral || t.byte_start < 20));
+}
+
+TEST_CASE("Languages: shell heredoc runs to its terminator") {
+    TestFixture f(LanguageDef::shell());
+    auto [t0, s0] = scan(f.hl, "cat <<EOF");
+    CHECK(s0 != LineState::Normal);
+    auto [t1, s1] = scan(f.hl, "echo $x # not a comment", s0);
+    CHECK(t1.size() == 1);
+    CHECK(has_token(t1, TokenType::StringLiteral, 0, 23));
+    CHECK(s1 == s0);
+    auto [t2, s2] = scan(f.hl, "EOF", s1);
+    CHECK(s2 == LineState::Normal);
+    auto [t3, s3] = scan(f.hl, "echo a#b # c", s2);
+    CHECK(t3.size() == 1);
+    CHECK(has_token(t3, TokenType::Comment, 9, 12));
+}
+
+TEST_CASE("Languages: Go raw string spans lines") {
+    TestFixture f(LanguageDef::go());
+    auto [t0, s0] = scan(f.hl, "s := `a");
+    CHECK(has_token(t0, TokenType::StringLiteral, 5, 7));
+    CHECK(s0 != LineState::Normal);
+    auto [t1, s1] = scan(f.hl, "b` + x // c", s0);
+    CHECK(has_token(t1, TokenType::StringLiteral, 0, 2));
+    CHECK(has_token(t1, TokenType::Comment, 7, 11));
+    CHECK(s1 == LineState::Normal);
+}
+
+TEST_CASE("Languages: JSON keywords and numbers") {
+    TestFixture f(LanguageDef::json());
+    auto [tokens, exit] = scan(f.hl, "{\"a\": [true, null, -1.5e3]}");
+    CHECK(has_token(tokens, TokenType::StringLiteral, 1, 4));
+    CHECK(has_token(tokens, TokenType::Keyword, 7, 11));
+    CHECK(has_token(tokens, TokenType::Keyword, 13, 17));
+    CHECK(has_token(tokens, TokenType::Number, 20, 25));
+}
+
+TEST_CASE("Languages: registry by extension and shebang") {
+    const LanguageRegistry& reg = LanguageRegistry::builtin();
+    CHECK(reg.size() == 8);
+    REQUIRE(reg.by_extension(".PY") != nullptr);
+    CHECK(reg.by_extension(".PY")->name == "python");
+    CHECK(reg.by_extension(".txt") == nullptr);
+    CHECK(reg.by_name("rust")->name == "rust");
+
+    CHECK(reg.by_shebang("#!/usr/bin/env python3")->name == "python");
+    CHECK(reg.by_shebang("#!/usr/bin/python3.12 -u")->name == "python");
+    CHECK(reg.by_shebang("#!/usr/bin/env -S bash -e")->name == "shell");
+    CHECK(reg.by_shebang("#!/bin/sh")->name == "shell");
+    CHECK(reg.by_shebang("#!/usr/bin/perl") == nullptr);
+    CHECK(reg.by_shebang("# comment") == nullptr);
+    CHECK(reg.detect("build.sh", "#!/usr/bin/env python3")->name == "shell");
+    CHECK(reg.detect("build", "#!/usr/bin/env python3")->name == "python");
+
+    TempFile file("#!/usr/bin/env python3\nimport os\n");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+    SyntaxHighlighter hl(ctrl);
+    hl.detect_language(file.path());
+    CHECK(hl.language_name() == "python");
+    auto deco = hl.decorate(1);
+    CHECK(!deco.spans.empty());
+}
+
+TEST_CASE("Languages: rule with an empty opener is rejected") {
+    Document doc;
+    Controller ctrl{doc};
+    SyntaxHighlighter hl{ctrl};
+    LanguageDef lang;
+    lang.name = "broken";
+    lang.rules.push_back({});
+    CHECK_THROWS_AS(hl.set_language(lang), std::invalid_argument);
+}
+
+// ===================================================================
+// Checkpoints and speculative highlighting
+// ===================================================================
+
+TEST_CASE("Checkpoints: far jump is speculative until the background pass confirms") {
+    // Line 0 opens a block comment that never closes.
+    std::string content = "/* open\n";
+    for (int i = 0; i < 20000; ++i) content += "int x;\n";
+    TempFile file(content, ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    SyntaxHighlighter hl(ctrl);
+    hl.set_language(LanguageDef::cpp());
+
+    auto far = hl.decorate(19000);
+    CHECK(hl.is_speculative(19000));
+    CHECK(hl.confirmed_line() < 19000);
+    // Speculative Normal entry: "int" is highlighted as a type.
+    REQUIRE(!far.spans.empty());
+    CHECK(far.spans[0].style.fg.r == 86);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (hl.on_idle(deadline)) {}
+    CHECK(hl.confirmed_line() == ctrl.line_count());
+
+    auto confirmed = hl.decorate(19000);
+    CHECK(!hl.is_speculative(19000));
+    REQUIRE(confirmed.spans.size() == 1);
+    CHECK(confirmed.spans[0].style.fg.r == 106);  // comment gray
+}
+
+TEST_CASE("Checkpoints: on_idle past its deadline confirms only a minimal step") {
+    std::string content;
+    for (int i = 0; i < 20000; ++i) content += "int x;\n";
+    TempFile file(content, ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    SyntaxHighlighter hl(ctrl);
+    hl.set_language(LanguageDef::cpp());
+    WorkerPool pool(4);
+    hl.set_worker_pool(&pool);
+
+    size_t before = hl.confirmed_line();
+    CHECK(hl.on_idle(std::chrono::steady_clock::now()));
+    CHECK(hl.confirmed_line() > before);
+    CHECK(hl.confirmed_line() <= before + SyntaxHighlighter::kMinIdleLines);
+}
+
+TEST_CASE("Checkpoints: speculative lines are published dirty once confirmed") {
+    std::string content = "/* open\n";
+    for (int i = 0; i < 20000; ++i) content += "int x;\n";
+    TempFile file(content, ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    auto hl = std::make_shared<SyntaxHighlighter>(ctrl);
+    ctrl.add_decoration_source(hl);
+    hl->set_language(LanguageDef::cpp());
+    ctrl.poll_decoration_changes();
+
+    hl->decorate(19000);
+    hl->decorate(5000);  // a second speculative window elsewhere
+    uint64_t before = ctrl.decoration_generation(19000);
+    CHECK(ctrl.poll_decoration_changes().empty());
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (hl->on_idle(deadline)) {}
+    LineRange r = ctrl.poll_decoration_changes();
+    CHECK(r.contains(5000));
+    CHECK(r.contains(19000));
+    CHECK(ctrl.decoration_generation(19000) != before);
+}
+
+TEST_CASE("Checkpoints: nearby lines are scanned synchronously") {
+    std::string content = "/* open\n";
+    for (int i = 0; i < 1000; ++i) content += "int x;\n";
+    TempFile file(content, ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    SyntaxHighlighter hl(ctrl);
+    hl.set_language(LanguageDef::cpp());
+
+    auto d = hl.decorate(900);
+    CHECK(!hl.is_speculative(900));
+    REQUIRE(d.spans.size() == 1);
+    CHECK(d.spans[0].style.fg.r == 106);
+}
+
+TEST_CASE("Checkpoints: edit before the frontier rescans up to where states converge") {
+    std::string content;
+    for (int i = 0; i < 2000; ++i) content += "int x;\n";
+    TempFile file(content, ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    auto hl = std::make_shared<SyntaxHighlighter>(ctrl);
+    hl->set_language(LanguageDef::cpp());
+    ctrl.add_decoration_source(hl);
+
+    ctrl.decorations(1500);
+    CHECK(hl->confirmed_line() >= 1500);
+    hl->take_dirty();
+
+    // Same state after line 600: only the edited line is dirty.
+    ctrl.insert(600, 0, "int ");
+    auto same = hl->take_dirty();
+    CHECK(same.first == 600);
+    CHECK(same.last == 601);
+
+    // An unclosed comment changes every later line, including the cached
+    // ones around line 1500; the frontier stays where it was.
+    ctrl.insert(600, 0, "/*");
+    CHECK(hl->confirmed_line() >= 1500);
+    auto opened = hl->take_dirty();
+    CHECK(opened.first == 600);
+    CHECK(opened.last > 1500);
+
+    auto d = ctrl.decorations(1500);
+    REQUIRE(d.spans.size() == 1);
+    CHECK(d.spans[0].style.fg.r == 106);
+
+    ctrl.insert(600, 2, "*/");
+    auto closed = ctrl.decorations(1500);
+    REQUIRE(closed.spans.size() == 1);
+    CHECK(closed.spans[0].style.fg.r == 86);  // "int" again
+}
+
+TEST_CASE("Checkpoints: inserted and removed lines shift stored states") {
+    // Lines 1000..1005 are a block comment.
+    std::string content;
+    for (int i = 0; i < 3000; ++i) {
+        if (i == 1000)      content += "/* open\n";
+        else if (i == 1005) content += "close */ int y;\n";
+        else                content += "int x;\n";
+    }
+    TempFile file(content, ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    auto hl = std::make_shared<SyntaxHighlighter>(ctrl);
+    hl->set_language(LanguageDef::cpp());
+    ctrl.add_decoration_source(hl);
+    ctrl.decorations(1200);
+    size_t confirmed = hl->confirmed_line();
+    CHECK(confirmed >= 1200);
+    hl->take_dirty();
+
+    auto is_comment = [&](size_t line) {
+        auto d = ctrl.decorations(line);
+        return d.spans.size() == 1 && d.spans[0].style.fg.r == 106;
+    };
+
+    // Enter near the top: the comment moves down one line and nothing
+    // past the next checkpoint is rescanned.
+    size_t lines = ctrl.line_count();
+    ctrl.insert(10, 0, "\n");
+    CHECK(hl->confirmed_line() == confirmed + 1);
+    auto dirty = hl->take_dirty();
+    CHECK(dirty.first == 10);
+    CHECK(dirty.last == 12);
+    CHECK(!is_comment(1000));
+    CHECK(is_comment(1001));
+    CHECK(is_comment(1005));
+    CHECK(!is_comment(1007));
+
+    // Join three lines: everything moves up two.
+    ctrl.erase(9, 0, 9);
+    CHECK(ctrl.line_count() == lines - 1);
+    CHECK(hl->confirmed_line() == confirmed - 1);
+    CHECK(!is_comment(998));
+    CHECK(is_comment(999));
+    CHECK(is_comment(1003));
+    CHECK(!is_comment(1005));
+}
+
+TEST_CASE("Checkpoints: parallel chunked pass matches the sequential one") {
+    // A block comment and a raw string each straddle a chunk boundary; the
+    // raw string's entry state is not a simple one and takes the fallback.
+    std::string content;
+    for (size_t i = 0; i < 20000; ++i) {
+        if (i % 5000 == 4090)      content += "/* opens\n";
+        else if (i % 5000 == 4200) content += "closes */ int z;\n";
+        else if (i == 12280)       content += "auto s = R\"x(\n";
+        else if (i == 12300)       content += ")x\"; int w;\n";
+        else                       content += "int x; // c\n";
+    }
+    TempFile file(content, ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    SyntaxHighlighter sequential(ctrl);
+    sequential.set_language(LanguageDef::cpp());
+    SyntaxHighlighter parallel(ctrl);
+    parallel.set_language(LanguageDef::cpp());
+    WorkerPool pool(4);
+    parallel.set_worker_pool(&pool);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (sequential.on_idle(deadline)) {}
+    while (parallel.on_idle(deadline)) {}
+    CHECK(parallel.confirmed_line() == ctrl.line_count());
+
+    size_t mismatches = 0;
+    for (size_t line = 0; line < ctrl.line_count(); ++line) {
+        auto a = sequential.decorate(line);
+        auto b = parallel.decorate(line);
+        bool same = a.spans.size() == b.spans.size();
+        for (size_t k = 0; same && k < a.spans.size(); ++k)
+            same = a.spans[k].byte_start == b.spans[k].byte_start &&
+                   a.spans[k].byte_end == b.spans[k].byte_end &&
+                   a.spans[k].style.fg.r == b.spans[k].style.fg.r;
+        mismatches += same ? 0 : 1;
+    }
+    CHECK(mismatches == 0);
+
+    auto inside = parallel.decorate(4100);
+    REQUIRE(inside.spans.size() == 1);
+    CHECK(inside.spans[0].style.fg.r == 106);  // comment gray
+    auto raw = parallel.decorate(12290);
+    REQUIRE(raw.spans.size() == 1);
+    CHECK(raw.spans[0].style.fg.r == 152);     // string green
+}
+
+// ===================================================================
+// Token cache
+// ===================================================================
+
+TEST_CASE("Token cache: steady-state decorate is a lookup") {
+    TempFile file("int a;\nreturn b;\nint c;\n", ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    SyntaxHighlighter hl(ctrl);
+    hl.set_language(LanguageDef::cpp());
+
+    for (size_t i = 0; i < 3; ++i) hl.decorate(i);
+    auto before = hl.token_cache_stats();
+    for (int frame = 0; frame < 10; ++frame)
+        for (size_t i = 0; i < 3; ++i) hl.decorate(i);
+    auto after = hl.token_cache_stats();
+
+    CHECK(after.misses == before.misses);
+    CHECK(after.hits == before.hits + 30);
+    CHECK(after.hit_rate() > 0.5);
+    CHECK(after.entries <= after.capacity);
+}
+
+TEST_CASE("Token cache: edits drop touched lines and renumber the rest") {
+    TempFile file("int a;\nreturn b;\nint c;\n", ".cpp");
+    Document doc;
+    Controller ctrl(doc);
+    ctrl.open_file(file.path());
+
+    auto hl = std::make_shared<SyntaxHighlighter>(ctrl);
+    hl->set_language(LanguageDef::cpp());
+    ctrl.add_decoration_source(hl);
+    for (size_t i = 0; i < 3; ++i) ctrl.decorations(i);
+
+    // Insert a line at the top: "return b;" moves from line 1 to line 2.
+    // Only the two halves of the split line 0 need a fresh scan.
+    auto misses = hl->token_cache_stats().misses;
+    ctrl.insert(0, 0, "x\n");
+    auto d2 = ctrl.decorations(2);
+    CHECK(hl->token_cache_stats().misses == misses + 2);
+    REQUIRE(d2.spans.size() == 1);
+    CHECK(d2.spans[0].byte_start == 0);
+    CHECK(d2.spans[0].byte_end == 6);    // "return"
+    CHECK(d2.spans[0].style.fg.r == 198);
+
+    // Remove it again: "return b;" is back on line 1.
+    ctrl.erase(0, 0, 2);
+    auto d1 = ctrl.decorations(1);
+    REQUIRE(d1.spans.size() == 1);
+    CHECK(d1.spans[0].byte_end == 6);
+
+    // The edited line itself is rescanned.
+    ctrl.insert(1, 0, "int ");
+    auto e1 = ctrl.decorations(1);
+    REQUIRE(e1.spans.size() == 2);
+    CHECK(e1.spans[0].byte_end == 3);    // "int"
+}
@@ -0,0 +1,81 @@
+#include <doctest/doctest.h>
+#include <sprawn/frontend/renderer.h>
+#include <sprawn/frontend/text_layout.h>
+
+#include "font_chain.h"
+#include "font_face.h"
+#include "glyph_atlas.h"
+
+#include <SDL2/SDL.h>
+
+#include <string_view>
+
+using namespace sprawn;
+
+namespace {
+
+void check_same(const GlyphRun& fast, const GlyphRun& slow) {
+    CHECK(fast.total_width == slow.total_width);
+    CHECK(fast.truncated == slow.truncated);
+    REQUIRE(fast.glyphs.size() == slow.glyphs.size());
+    for (size_t i = 0; i < fast.glyphs.size(); ++i) {
+        const GlyphEntry& a = fast.glyphs[i];
+        const GlyphEntry& b = slow.glyphs[i];
+        CHECK(a.glyph_id == b.glyph_id);
+        CHECK(a.font_index == b.font_index);
+        CHECK(a.x == b.x);
+        CHECK(a.y_offset == b.y_offset);
+        CHECK(a.cluster == b.cluster);
+    }
+}
+
+} // namespace
+
+TEST_CASE("TextLayout: the ASCII path gives the runs HarfBuzz gives") {
+    auto path = find_system_mono_font();
+    if (path.empty()) {
+        MESSAGE("no monospace system font found; skipped");
+        return;
+    }
+    // Shaping never draws, but the layout needs an atlas, and the atlas a
+    // renderer: a software one on a small surface will do.
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 64, 64, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_Renderer* sdl = surface ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+    if (!sdl) {
+        MESSAGE("no SDL software renderer (" << SDL_GetError() << "); skipped");
+        if (surface) SDL_FreeSurface(surface);
+        return;
+    }
+    {
+        Renderer   renderer(sdl);
+        FontChain  fonts(path, 16);
+        GlyphAtlas atlas(renderer, fonts);
+        for (float scale : {1.0f, 2.0f}) {
+            TextLayout fast(atlas, fonts, scale);
+            TextLayout slow(atlas, fonts, scale);
+            slow.set_ascii_path(false);
+            if (fast.shape_line("x").cell_width == 0) {
+                MESSAGE("font not eligible for the ASCII path; skipped");
+                break;
+            }
+            for (std::string_view line : {
+                     std::string_view("int main() { return 0; }"),
+                     std::string_view("    x = y->z[3] + 'q'; // ~!@#$%^&*()_+-=`|\\"),
+                     std::string_view("fi ffl -> => != === <= www"),
+                 })
+            {
+                for (int limit : {0, 40, 100000}) {
+                    CAPTURE(line);
+                    CAPTURE(limit);
+                    GlyphRun a = fast.shape_line(line, limit);
+                    GlyphRun b = slow.shape_line(line, limit);
+                    CHECK(a.cell_width > 0);
+                    CHECK(b.cell_width == 0);
+                    check_same(a, b);
+                }
+            }
+        }
+    }
+    SDL_DestroyRenderer(sdl);
+    SDL_FreeSurface(surface);
+}
@@ -0,0 +1,54 @@
+#include <doctest/doctest.h>
+
+#include <sprawn/worker_pool.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace sprawn;
+
+TEST_CASE("WorkerPool: parallel_for visits every index once") {
+    WorkerPool pool(4);
+    CHECK(pool.concurrency() == 4);
+
+    std::vector<std::atomic<int>> visits(1000);
+    pool.parallel_for(visits.size(), [&](size_t i) { visits[i].fetch_add(1); });
+    bool all_once = true;
+    for (auto& v : visits) all_once &= v.load() == 1;
+    CHECK(all_once);
+
+    pool.parallel_for(0, [](size_t) { throw std::logic_error("never called"); });
+}
+
+TEST_CASE("WorkerPool: a single thread runs everything inline") {
+    WorkerPool pool(1);
+    CHECK(pool.concurrency() == 1);
+
+    auto caller = std::this_thread::get_id();
+    bool on_caller = true;
+    pool.parallel_for(10, [&](size_t) { on_caller &= std::this_thread::get_id() == caller; });
+    pool.submit([&] { on_caller &= std::this_thread::get_id() == caller; });
+    CHECK(on_caller);
+}
+
+TEST_CASE("WorkerPool: first exception is rethrown after all items ran") {
+    WorkerPool pool(3);
+    std::atomic<int> ran{0};
+    CHECK_THROWS_AS(pool.parallel_for(50, [&](size_t i) {
+        ran.fetch_add(1);
+        if (i == 7) throw std::runtime_error("item 7");
+    }), std::runtime_error);
+    CHECK(ran.load() == 50);
+}
+
+TEST_CASE("WorkerPool: submitted tasks finish before destruction") {
+    std::atomic<int> done{0};
+    {
+        WorkerPool pool(3);
+        for (int i = 0; i < 20; ++i)
+            pool.submit([&] { done.fetch_add(1); });
+    }
+    CHECK(done.load() == 20);
+}